@@ -0,0 +1,152 @@
+/*
+ * Task_Scheduler.cpp - Implementation of the TaskScheduler library
+ * 
+ * IMPLEMENTATION:
+ * - addPeriodic() / addOneShot(): Claim a free slot in the task table
+ * - run(): Repeatedly picks the best due task that hasn't run in this pass
+ *   (highest priority, then earliest deadline) until nothing is due
+ * - runTask(): Calls the task, measures it with ESP.getCycleCount() & schedules the next run
+ * - report(): Prints runs, overruns & run times for every task
+ */
+
+
+// INCLUDES
+#include "Task_Scheduler.h"
+
+// HELPER METHODS
+int TaskScheduler::addTask(const char* name, TaskCallback callback, unsigned long delayMs, unsigned long periodMs,
+                           bool periodic, Priority priority, uint32_t budgetUs) {
+  for (int i = 0; i < MAX_TASKS; i++) {
+    if (tasks[i].active) continue;
+
+    Task &task = tasks[i];
+    task = Task();
+    task.active = true;
+    task.periodic = periodic;
+    task.priority = priority;
+    task.callback = callback;
+    task.periodMs = periodMs;
+    task.nextRunMs = millis() + delayMs;
+    task.stats.name = name;
+    task.stats.budgetUs = budgetUs;
+    return i;
+  }
+
+  return -1;  // Table is full
+}
+
+int TaskScheduler::nextDueTask(unsigned long now) const {
+  int best = -1;
+
+  for (int i = 0; i < MAX_TASKS; i++) {
+    const Task &task = tasks[i];
+    if (!task.active || task.ranThisPass) continue;
+    if ((long)(now - task.nextRunMs) < 0) continue;   // Not due yet
+
+    if (best < 0 ||
+        task.priority > tasks[best].priority ||
+        (task.priority == tasks[best].priority && (long)(task.nextRunMs - tasks[best].nextRunMs) < 0)) {
+      best = i;
+    }
+  }
+
+  return best;
+}
+
+void TaskScheduler::runTask(Task &task, unsigned long now) {
+  task.ranThisPass = true;
+
+  uint32_t startCycles = ESP.getCycleCount();
+  task.callback();
+  uint32_t elapsedUs = (ESP.getCycleCount() - startCycles) / ESP.getCpuFreqMHz();
+
+  // Runtime accounting
+  TaskStats &stats = task.stats;
+  stats.runs++;
+  stats.lastUs = elapsedUs;
+  stats.totalUs += elapsedUs;
+  if (elapsedUs > stats.maxUs) stats.maxUs = elapsedUs;
+  if (stats.budgetUs > 0 && elapsedUs > stats.budgetUs) stats.overruns++;
+
+  // One-shot tasks are done, free the slot
+  if (!task.periodic) {
+    task.active = false;
+    return;
+  }
+
+  // Schedule the next run from the deadline (not from now) so periods don't drift
+  task.nextRunMs += task.periodMs;
+  if ((long)(now - task.nextRunMs) >= 0) {
+    task.nextRunMs = now + task.periodMs;   // Fell behind, skip the missed runs
+  }
+}
+
+// PUBLIC METHODS
+int TaskScheduler::addPeriodic(const char* name, TaskCallback callback, unsigned long periodMs,
+                               Priority priority, uint32_t budgetUs) {
+  return addTask(name, callback, 0, periodMs, true, priority, budgetUs);
+}
+
+int TaskScheduler::addOneShot(const char* name, TaskCallback callback, unsigned long delayMs,
+                              Priority priority, uint32_t budgetUs) {
+  return addTask(name, callback, delayMs, 0, false, priority, budgetUs);
+}
+
+bool TaskScheduler::cancel(int taskId) {
+  if (taskId < 0 || taskId >= MAX_TASKS || !tasks[taskId].active) return false;
+  tasks[taskId].active = false;
+  return true;
+}
+
+bool TaskScheduler::setPeriod(int taskId, unsigned long periodMs) {
+  if (taskId < 0 || taskId >= MAX_TASKS || !tasks[taskId].active) return false;
+  tasks[taskId].periodMs = periodMs;
+  return true;
+}
+
+void TaskScheduler::run() {
+  unsigned long now = millis();
+
+  for (int i = 0; i < MAX_TASKS; i++) {
+    tasks[i].ranThisPass = false;
+  }
+
+  // Run every due task once, best first
+  int taskId;
+  while ((taskId = nextDueTask(now)) >= 0) {
+    runTask(tasks[taskId], now);
+  }
+}
+
+const TaskScheduler::TaskStats* TaskScheduler::getStats(int taskId) const {
+  if (taskId < 0 || taskId >= MAX_TASKS || !tasks[taskId].active) return nullptr;
+  return &tasks[taskId].stats;
+}
+
+void TaskScheduler::resetStats() {
+  for (int i = 0; i < MAX_TASKS; i++) {
+    TaskStats &stats = tasks[i].stats;
+    stats.runs = 0;
+    stats.overruns = 0;
+    stats.lastUs = 0;
+    stats.maxUs = 0;
+    stats.totalUs = 0;
+  }
+}
+
+void TaskScheduler::report(Print &output) const {
+  output.println("TASK            PRIO    RUNS  OVERRUNS  BUDGET_US  AVG_US  MAX_US");
+
+  char line[80];
+  for (int i = 0; i < MAX_TASKS; i++) {
+    const Task &task = tasks[i];
+    if (!task.active) continue;
+
+    const TaskStats &stats = task.stats;
+    unsigned long avgUs = stats.runs > 0 ? (unsigned long)(stats.totalUs / stats.runs) : 0;
+    snprintf(line, sizeof(line), "%-15s %4d %7lu %9lu %10lu %7lu %7lu",
+             stats.name, (int)task.priority, stats.runs, stats.overruns,
+             (unsigned long)stats.budgetUs, avgUs, (unsigned long)stats.maxUs);
+    output.println(line);
+  }
+}
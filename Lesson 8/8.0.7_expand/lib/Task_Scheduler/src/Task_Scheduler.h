@@ -0,0 +1,89 @@
+/*
+ * Task_Scheduler.h - Custom library for running periodic & one-shot jobs from loop()
+ * 
+ * This library replaces hand-rolled millis() timers in the main sketch with a small
+ * cooperative scheduler. Jobs are plain functions that must return quickly (no delay()).
+ * 
+ * IMPLEMENTATION:
+ * - Fixed capacity task table (no heap allocation)
+ * - Periodic tasks run every periodMs (0 = every pass through loop())
+ * - One-shot tasks run once after delayMs and then free their slot
+ * - run() executes every due task once, highest priority first, then earliest deadline
+ * - Each task has an optional time budget, run time is measured in CPU cycles
+ *   and tasks that take longer than their budget are counted as overruns
+ * 
+ * NOTES:
+ * - Register MovementDriver::update() with PRIORITY_MOTION & period 0 so servo steps
+ *   are always handled before any other job in the same pass
+ * - A periodic task that falls behind skips the missed runs instead of running back-to-back
+ */
+
+
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+// INCLUDES
+#include <Arduino.h>
+
+// CLASSES
+class TaskScheduler {
+  public:
+    typedef void (*TaskCallback)();
+
+    // Priority levels - higher runs first when several tasks are due
+    enum Priority {
+      PRIORITY_LOW = 0,       // Logging, reports
+      PRIORITY_NORMAL = 1,    // General jobs
+      PRIORITY_HIGH = 2,      // Communication
+      PRIORITY_MOTION = 3     // Servo updates
+    };
+
+    static const int MAX_TASKS = 8;
+
+    // Runtime accounting for one task
+    struct TaskStats {
+      const char* name;           // Name for reports
+      unsigned long runs;         // How many times the task has run
+      unsigned long overruns;     // Runs that took longer than the budget
+      uint32_t budgetUs;          // Allowed run time (0 = no budget)
+      uint32_t lastUs;            // Run time of the last run
+      uint32_t maxUs;             // Longest run time
+      uint64_t totalUs;           // Sum of all run times
+    };
+
+    // Public methods
+    int addPeriodic(const char* name, TaskCallback callback, unsigned long periodMs,
+                    Priority priority = PRIORITY_NORMAL, uint32_t budgetUs = 0);
+    int addOneShot(const char* name, TaskCallback callback, unsigned long delayMs,
+                   Priority priority = PRIORITY_NORMAL, uint32_t budgetUs = 0);
+    bool cancel(int taskId);                        // Remove a task
+    bool setPeriod(int taskId, unsigned long periodMs);
+    void run();                                     // Call continuously in loop()
+
+    // Statistics
+    const TaskStats* getStats(int taskId) const;    // nullptr if the slot is free
+    void resetStats();
+    void report(Print &output) const;               // Print a table of all tasks
+
+  private:
+    struct Task {
+      bool active;                // Slot in use
+      bool periodic;              // Periodic or one-shot
+      bool ranThisPass;           // Already run in the current run() pass
+      Priority priority;
+      TaskCallback callback;
+      unsigned long periodMs;
+      unsigned long nextRunMs;    // Deadline for the next run
+      TaskStats stats;
+    };
+
+    Task tasks[MAX_TASKS] = {};
+
+    // Helper methods
+    int addTask(const char* name, TaskCallback callback, unsigned long delayMs, unsigned long periodMs,
+                bool periodic, Priority priority, uint32_t budgetUs);
+    int nextDueTask(unsigned long now) const;
+    void runTask(Task &task, unsigned long now);
+};
+
+#endif
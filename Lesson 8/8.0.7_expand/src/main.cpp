@@ -3,8 +3,7 @@
  * We introduce the creation & use of a custom library and handle movements via a state machine.
  * 
  * Program flow:
- *   - Start in standby()
- *   - Transition to ready()
+ *   - Start in ready() straight after the servos are attached
  *   - Then follow sequence:
        forward twice, turn left, turn right, backward twice, move left, move right, wave hello,
        perfom dance routines, lie down, fighting, push ups, sleep, loop back to forward.
@@ -19,20 +18,23 @@
  *   can access it directly.
  * - The main sketch only needs to include Movement_Driver.h and call the high-level movement methods.
  * - For the idle state we can pass the period & queue the next state.
+ * - loop() only runs a task scheduler, so extra periodic jobs are registered in setup()
+ *   instead of adding more millis() timers to loop().
+ * - setup() has no delay() calls, the robot holds its ready pose a few ms after reset.
  */
 
 
 // INCLUDES
 #include <Arduino.h>
 #include "Movement_Driver.h"
+#include "Task_Scheduler.h"
 
 // INSTANCES
-MovementDriver robot;   // create movement driver instance
+MovementDriver robot;       // create movement driver instance
+TaskScheduler scheduler;    // create task scheduler instance
 
 // GLOBAL VARIABLES
-// Timer variables for seconds counter
-unsigned long previousMillis = 0;
-const long interval = 1000;   // 1 second interval
+// Seconds counter
 int secondsCounter = 0;
 
 // Movement counters
@@ -42,27 +44,14 @@ byte backwardCount = 0;
 int idleTime = 1000;      // 1 second idle time
 
 
-// SETUP
-void setup() {
-  Serial.begin(115200);
-  delay(100);
-  Serial.println("\nSerial monitor started");
-
-  // Initialize the movement driver
-  robot.begin();
-  
-  // Start in standby mode
-  robot.standby();
-  Serial.println("\nStandy mode active");
-  Serial.println("\nSetup Complete\n");
-  delay(1000);
+// TASKS
+// Always update to handle movement sequencing
+void updateMotion() {
+  robot.update();
 }
 
-// MAIN LOOP
-void loop() {
-  // Always call update to handle movement sequencing
-  robot.update();
-  
+// Pick the next movement once the current one has finished
+void runRoutine() {
   // Check if robot is moving or idle
   if (!robot.isBusy()) {
     switch (robot.getState()) {
@@ -183,26 +172,46 @@ void loop() {
     }
   }
 
-  // Example of additional task (counter) that runs together with robot movements
-  unsigned long currentMillis = millis();
-  
-  if (currentMillis - previousMillis >= interval) {
-    // Save the last time we updated the counter
-    previousMillis = currentMillis;
-    
-    // Increment the seconds counter & print to serial monitor
-    secondsCounter++;
-    Serial.print("Seconds Counter: ");
-    Serial.println(secondsCounter);
-    
-    /* We could add other periodic tasks here that need to run every second
-     * For example:
-     * - read sensor values
-     * - check battery level
-     * - update a display */
-  }
+}
+
+// Example of additional task (counter) that runs together with robot movements
+void countSeconds() {
+  // Increment the seconds counter & print to serial monitor
+  secondsCounter++;
+  Serial.print("Seconds Counter: ");
+  Serial.println(secondsCounter);
+
+  /* We could add other periodic tasks here that need to run every second
+   * For example:
+   * - read sensor values
+   * - check battery level
+   * - update a display */
+}
 
-  /* We could add other non-blocking tasks here
+
+// SETUP
+void setup() {
+  // Initialize the movement driver & go straight to the ready pose (no waiting for the Serial Monitor)
+  robot.begin();
+  robot.ready();
+
+  Serial.begin(115200);
+  Serial.println("\nReady mode active");
+
+  // Register tasks - motion runs on every pass & before anything else
+  scheduler.addPeriodic("motion", updateMotion, 0, TaskScheduler::PRIORITY_MOTION);
+  scheduler.addPeriodic("routine", runRoutine, 0, TaskScheduler::PRIORITY_NORMAL);
+  scheduler.addPeriodic("seconds", countSeconds, 1000, TaskScheduler::PRIORITY_LOW);
+
+  Serial.println("Setup Complete");
+}
+
+// MAIN LOOP
+void loop() {
+  // Run every task that is due (motion first)
+  scheduler.run();
+
+  /* We could add other non-blocking tasks as scheduler tasks in setup()
    * For example: 
    * - Read buttons or other inputs
    * - Communicate with other devices
@@ -250,7 +259,7 @@ void loop() {
  * - The update() method is called in the main loop to process servo steps
  * - Movements are handled asynchronously, so the ESP8266 can run other tasks in parallel
  * - The state machine automatically advances:
- *   STANDBY → READY → FORWARD → TURN_LEFT → TURN_RIGHT → BACKWARD → MOVE_LEFT → MOVE_RIGHT → WAVE_HELLO →
+ *   (STANDBY →) READY → FORWARD → TURN_LEFT → TURN_RIGHT → BACKWARD → MOVE_LEFT → MOVE_RIGHT → WAVE_HELLO →
  *   DANCE ROUTINES → LIE_DOWN → FIGHTING → PUSH_UPS → SLEEP → FORWARD with IDLE periods
  * 
  * - How/Why?:
@@ -259,4 +268,14 @@ void loop() {
  *   - Because timing is non-blocking, other tasks (sensors, displays, comms) 
  *     continue to run while the robot is moving
  *   - Easy to add extra movement steps to the movement driver and main sketch
+ * 
+ * TASK SCHEDULER:
+ * - A custom Task_Scheduler library replaces the hand-rolled millis() timers in loop()
+ * - Each job is a small function registered in setup() with a period & a priority:
+ *   - motion  (every pass, highest priority) → robot.update()
+ *   - routine (every pass)                   → picks the next movement
+ *   - seconds (every 1000ms, lowest priority) → seconds counter
+ * - When several tasks are due, the highest priority & earliest deadline runs first,
+ *   so adding more jobs doesn't delay the servo steps
+ * - Each task's run time is measured & can be printed with scheduler.report(Serial)
  */
\ No newline at end of file
@@ -0,0 +1,80 @@
+/*
+ * Memory_Monitor.h - Custom library for tracking heap & stack health on a running robot
+ * 
+ * Long running robots can slowly run out of memory (leaks or heap fragmentation from
+ * growing & shrinking Strings). This library samples the memory figures of the ESP8266,
+ * keeps the worst values since boot & calls a warning callback when a threshold is crossed.
+ * 
+ * IMPLEMENTATION:
+ * - sample() reads ESP.getFreeHeap(), getHeapFragmentation(), getMaxFreeBlockSize()
+ *   & getFreeContStack() (the stack high-water mark - the least free stack seen since boot)
+ * - The worst value of each figure since boot is kept next to the latest sample
+ * - Each threshold has its own warning flag, the callback is only called when a flag
+ *   becomes set (not on every sample), and the flag clears once the value recovers
+ * - report() prints the latest & worst values, telemetry uses the getters
+ * 
+ * NOTES:
+ * - Sample from a low priority scheduler task (about once a second is plenty)
+ * - A falling max free block with a steady free heap means the heap is fragmenting
+ */
+
+
+#ifndef MEMORY_MONITOR_H
+#define MEMORY_MONITOR_H
+
+// INCLUDES
+#include <Arduino.h>
+
+// ENUMS
+enum MemoryWarning : uint8_t {
+  MEMORY_LOW_HEAP     = 0x01,   // Free heap below minFreeHeap
+  MEMORY_FRAGMENTED   = 0x02,   // Fragmentation above maxFragmentation
+  MEMORY_SMALL_BLOCK  = 0x04,   // Largest free block below minFreeBlock
+  MEMORY_LOW_STACK    = 0x08    // Stack high-water mark below minFreeStack
+};
+
+// STRUCTS
+struct MemorySample {
+  uint32_t freeHeap;        // Bytes of free heap
+  uint8_t fragmentation;    // Heap fragmentation in % (0 = one free block)
+  uint32_t maxFreeBlock;    // Largest block that can be allocated
+  uint32_t freeStack;       // Least free stack seen since boot
+};
+
+struct MemoryThresholds {
+  uint32_t minFreeHeap;
+  uint8_t maxFragmentation;
+  uint32_t minFreeBlock;
+  uint32_t minFreeStack;
+};
+
+// CLASSES
+class MemoryMonitor {
+  public:
+    typedef void (*WarningCallback)(uint8_t newWarnings, const MemorySample &sample);
+
+    MemoryMonitor();
+
+    void setThresholds(const MemoryThresholds &limits) { thresholds = limits; }
+    void onWarning(WarningCallback callback) { warningCallback = callback; }
+    void sample();                    // Take a new sample & check the thresholds
+
+    const MemorySample &getLast() const { return last; }
+    const MemorySample &getWorst() const { return worst; }   // Worst value of each figure since boot
+    uint8_t getWarnings() const { return activeWarnings; }   // MemoryWarning flags currently set
+    unsigned long getWarningCount() const { return warningCount; }
+    unsigned long getSampleCount() const { return sampleCount; }
+
+    void report(Print &output) const;
+
+  private:
+    MemorySample last;
+    MemorySample worst;
+    MemoryThresholds thresholds;
+    WarningCallback warningCallback;
+    uint8_t activeWarnings;
+    unsigned long warningCount;
+    unsigned long sampleCount;
+};
+
+#endif
@@ -6,6 +6,9 @@
  *   direct writing to the servos as this was causing movements to be incredibly slow!
  * - substituted movement arrays from the previous lessons
  * - SERVOMIN & SERVOMAX changed from 400 / 2400 -to- 500 / 2500
+ * - added the Memory_Monitor library (lib folder) to measure the heap use of 'sendBuff' over
+ *   long runs - the worst values since boot are printed when a client disconnects & warnings
+ *   are printed as soon as a threshold is crossed
  * 
  * The intention was to get it workig in PlatformIO as close to 'as-is' as possible, with QoL fixes.
  * Another version (8.1_app_control_custom) will use the methods in the reworked 'expand' lessons
@@ -18,6 +21,7 @@
 #include <ESP8266WiFi.h>
 #include <ESP8266WebServer.h>
 #include "text.h"
+#include "Memory_Monitor.h"
 
 
 // DEFINES
@@ -40,6 +44,7 @@ const char* password = "12345678";    // Wi-Fi password for the quadruped robot
 WiFiServer server(100);   // Create a Wi-Fi server object with port 100
 WiFiClient client;        // Create a Wi-Fi client object
 String sendBuff;          // Send buffer
+MemoryMonitor memory;     // Heap & stack health
 
 byte RX_package[17] = {0};                                        // array of incoming packets
 byte callback_forward_package[5] = {0xff,0x55,0x02,0x01,0x01};    // forward command packet
@@ -179,6 +184,28 @@ void parseData() {
   }
 }
 
+// Sample the memory figures once a second (called from both the idle & connected loops)
+void checkMemory() {
+  static unsigned long lastSample = 0;
+
+  if (millis() - lastSample >= 1000) {
+    lastSample = millis();
+    memory.sample();
+  }
+}
+
+// Called by the memory monitor when a threshold is crossed
+void onMemoryWarning(uint8_t newWarnings, const MemorySample &sample) {
+  Serial.print("[Memory warning 0x");
+  Serial.print(newWarnings, HEX);
+  Serial.print("] free heap: ");
+  Serial.print(sample.freeHeap);
+  Serial.print(", fragmentation: ");
+  Serial.print(sample.fragmentation);
+  Serial.print("%, max block: ");
+  Serial.println(sample.maxFreeBlock);
+}
+
 
 // SETUP
 void setup() {
@@ -201,10 +228,15 @@ void setup() {
   servo_2.attach(2, SERVOMIN, SERVOMAX);    // Connect the servo to pin 2
 
   Servo_PROGRAM_Zero();  // Reset the servo program to zero
+
+  memory.onWarning(onMemoryWarning);
+  memory.sample();
 }
 
 // MAIN LOOP
 void loop() {
+  checkMemory();
+
   client = server.accept();
   if (client) {
     WA_en = true;
@@ -214,6 +246,8 @@ void loop() {
     const unsigned long timeoutDuration = 3000;
 
     while (client.connected()) {
+      checkMemory();
+
       if ((millis() - previousMillis) > timeoutDuration && client.available() == 0 && st == true) {
         break;
       }
@@ -282,6 +316,7 @@ void loop() {
     client.stop();
     Servo_PROGRAM_Zero();
     Serial.println("[Client disconnected]");
+    memory.report(Serial);
   }
   else {
     if (ED_client == true) {
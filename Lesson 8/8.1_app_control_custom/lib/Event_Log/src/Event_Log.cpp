@@ -0,0 +1,91 @@
+/*
+ * Event_Log.cpp - Implementation of the EventLog library
+ * 
+ * IMPLEMENTATION:
+ * - write(): Copies the record into the slot at head & then publishes it by moving head
+ * - flush(): Prints records while the UART FIFO has room for a whole line
+ * - dump(): Prints every buffered record
+ * - printRecord(): Formats one record as a fixed width hex line
+ */
+
+
+// INCLUDES
+#include "Event_Log.h"
+
+// DEFINES
+#define RECORD_LINE_LENGTH 30   // "#EV " + 24 hex digits + "\r\n"
+
+// Shared log instance
+EventLog eventLog;
+
+// HELPER METHODS
+static void printHex(Print &output, uint32_t value, int digits) {
+  static const char hexDigits[] = "0123456789abcdef";
+  for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4) {
+    output.print(hexDigits[(value >> shift) & 0x0F]);
+  }
+}
+
+void EventLog::printRecord(Print &output, const EventRecord &record) {
+  output.print("#EV ");
+  printHex(output, record.timestampUs, 8);
+  printHex(output, record.id, 2);
+  printHex(output, record.level, 2);
+  printHex(output, record.a, 4);
+  printHex(output, record.b, 4);
+  printHex(output, record.c, 4);
+  output.println();
+}
+
+void EventLog::printDropped(Print &output) {
+  uint16_t dropped = droppedSinceFlush;
+  if (dropped == 0) return;
+
+  droppedSinceFlush = 0;
+  output.print("#EVDROP ");
+  output.println(dropped);
+}
+
+// PUBLIC METHODS
+void EventLog::write(uint8_t level, uint8_t id, uint16_t a, uint16_t b, uint16_t c) {
+  uint16_t slot = head;
+  if ((uint16_t)(slot - __atomic_load_n(&tail, __ATOMIC_ACQUIRE)) >= CAPACITY) {
+    droppedSinceFlush++;    // Full - drop the newest record
+    totalDropped++;
+    return;
+  }
+
+  EventRecord &record = records[slot & (CAPACITY - 1)];
+  record.timestampUs = micros();
+  record.id = id;
+  record.level = level;
+  record.a = a;
+  record.b = b;
+  record.c = c;
+  __atomic_store_n(&head, (uint16_t)(slot + 1), __ATOMIC_RELEASE);
+}
+
+void EventLog::flush(HardwareSerial &serial) {
+  if (droppedSinceFlush > 0 && serial.availableForWrite() >= RECORD_LINE_LENGTH) {
+    printDropped(serial);
+  }
+
+  uint16_t slot = tail;
+  while (slot != __atomic_load_n(&head, __ATOMIC_ACQUIRE) &&
+         serial.availableForWrite() >= RECORD_LINE_LENGTH) {
+    printRecord(serial, records[slot & (CAPACITY - 1)]);
+    slot++;
+    __atomic_store_n(&tail, slot, __ATOMIC_RELEASE);
+  }
+}
+
+void EventLog::dump(Print &output) {
+  printDropped(output);
+
+  uint16_t slot = tail;
+  while (slot != __atomic_load_n(&head, __ATOMIC_ACQUIRE)) {
+    printRecord(output, records[slot & (CAPACITY - 1)]);
+    slot++;
+    __atomic_store_n(&tail, slot, __ATOMIC_RELEASE);
+  }
+}
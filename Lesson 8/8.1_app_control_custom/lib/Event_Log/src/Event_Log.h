@@ -0,0 +1,121 @@
+/*
+ * Event_Log.h - Custom library for cheap logging from time critical code
+ * 
+ * Instead of formatting text with Serial.print() where an event happens, a small binary
+ * record (timestamp, event ID, level & 3 arguments) is copied into a RAM ring buffer.
+ * The records are sent out later, when the robot has nothing else to do, and the
+ * tools/decode_event_log.py script turns them back into readable text.
+ * 
+ * IMPLEMENTATION:
+ * - LOG_ERROR / LOG_WARN / LOG_INFO / LOG_DEBUG(eventId, a, b, c) add one 12 byte record
+ * - Levels above EVENT_LOG_LEVEL are removed at compile time
+ * - The ring buffer is a single producer / single consumer queue, so events can also
+ *   be logged from the motion Ticker while the main loop is flushing
+ * - When the buffer is full new records are dropped & counted (nothing ever blocks)
+ * - flush() prints as many records as fit in the UART transmit FIFO without waiting,
+ *   dump() prints everything that is left (for on-demand dumps over Wi-Fi)
+ * 
+ * OUTPUT FORMAT (one line per record, mixed in with normal Serial Monitor text):
+ *   #EV <timestamp us:8 hex><id:2 hex><level:2 hex><a:4 hex><b:4 hex><c:4 hex>
+ *   #EVDROP <records dropped since the last flush>
+ * 
+ * NOTES:
+ * - Set the level with build_flags, e.g. -D EVENT_LOG_LEVEL=LOG_LEVEL_WARN
+ * - Keep the event table in tools/decode_event_log.py in sync with EventId below
+ */
+
+
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+// INCLUDES
+#include <Arduino.h>
+
+// DEFINES
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef EVENT_LOG_LEVEL
+#define EVENT_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// ENUMS
+enum EventId : uint8_t {
+  EVT_BOOT = 1,               // a = reset reason
+  EVT_WIFI_READY,             // a = channel, b = access points seen, c = scan time (ms)
+  EVT_CLIENT_CONNECTED,
+  EVT_CLIENT_DISCONNECTED,    // a = 1 if the last station left the AP (or the robot left the network)
+  EVT_CLIENT_TIMEOUT,
+  EVT_CMD_MOVEMENT,           // a = action, b = device, c = movement type
+  EVT_CMD_ACTION,             // a = action, b = device
+  EVT_FRAME_OVERFLOW,         // a = buffer index
+  EVT_SEQUENCE_START,         // a = sequence ID, b = queued state
+  EVT_SEQUENCE_END,           // a = sequence ID
+  EVT_STEP_LATE,              // a = sequence ID, b = step, c = lateness ms
+  EVT_COMMAND_DROPPED,        // a = sequence ID
+  EVT_MEMORY_WARNING,         // a = new MemoryWarning flags, b = free heap, c = max free block
+  EVT_STEP_READ_FAILED,       // a = sequence ID, b = step
+  EVT_POWER_LEVEL,            // a = new PowerLevel, b = previous PowerLevel
+  EVT_WIFI_JOINED,            // a = channel, b = -RSSI (dBm), c = join time (ms)
+  EVT_WIFI_JOIN_FAILED,       // a = wl_status_t, b = time waited (ms)
+  EVT_SHOW_CLOCK_SET,         // a = master ID (low 16 bits), b = clock jump (ms), c = 1 if the clock went back
+  EVT_SHOW_START,             // a = sequence ID, b = time ahead of the start (ms), c = time late (ms)
+  EVT_TEMPO_SET,              // a = BPM, b = beat of the playing sequence it waits for (0 = at once)
+  EVT_STREAM_START,           // a = first frame's sequence number, b = state interrupted
+  EVT_STREAM_STOP,            // a = StreamStop, b = frames played (low 16 bits), c = playout delay (ms)
+  EVT_TEACH_START,            // a = tolerance (degrees)
+  EVT_TEACH_STOP,             // a = keyframes, b = duration (ms), c = 1 if the buffer filled up
+  EVT_SEQUENCE_SAVED,         // a = sequence ID (0 = not registered), b = steps, c = SequenceLoadResult
+  EVT_TASK_REJECTED           // a = TaskScheduler::MAX_TASKS (the task table is full)
+};
+
+// STRUCTS
+struct EventRecord {
+  uint32_t timestampUs;   // micros() when the event was logged
+  uint8_t id;             // EventId
+  uint8_t level;          // LOG_LEVEL_*
+  uint16_t a;             // Event arguments
+  uint16_t b;
+  uint16_t c;
+};
+
+// CLASSES
+class EventLog {
+  public:
+    static const uint16_t CAPACITY = 128;   // Records (must be a power of 2)
+
+    void write(uint8_t level, uint8_t id, uint16_t a = 0, uint16_t b = 0, uint16_t c = 0);
+    void flush(HardwareSerial &serial);     // Non-blocking, call when idle
+    void dump(Print &output);               // Print everything that is buffered
+
+    uint16_t pending() const { return (uint16_t)(head - tail); }
+    unsigned long getDropped() const { return totalDropped; }
+
+  private:
+    EventRecord records[CAPACITY];
+    volatile uint16_t head = 0;             // Written by the logging side only
+    volatile uint16_t tail = 0;             // Written by the flushing side only
+    volatile uint16_t droppedSinceFlush = 0;
+    unsigned long totalDropped = 0;
+
+    // Helper methods
+    void printRecord(Print &output, const EventRecord &record);
+    void printDropped(Print &output);
+};
+
+// Shared log instance
+extern EventLog eventLog;
+
+// Logging macros - compiled out above EVENT_LOG_LEVEL
+#define LOG_EVENT(level, id, ...) \
+  do { if ((level) <= EVENT_LOG_LEVEL) eventLog.write((level), (id), ##__VA_ARGS__); } while (0)
+
+#define LOG_ERROR(id, ...)  LOG_EVENT(LOG_LEVEL_ERROR, id, ##__VA_ARGS__)
+#define LOG_WARN(id, ...)   LOG_EVENT(LOG_LEVEL_WARN, id, ##__VA_ARGS__)
+#define LOG_INFO(id, ...)   LOG_EVENT(LOG_LEVEL_INFO, id, ##__VA_ARGS__)
+#define LOG_DEBUG(id, ...)  LOG_EVENT(LOG_LEVEL_DEBUG, id, ##__VA_ARGS__)
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * Latency_Profiler.cpp - Implementation of the LatencyProfiler library
+ * 
+ * IMPLEMENTATION:
+ * - bucketIndex(): 0-3us get a bucket each, above that the top 3 bits of the value
+ *   select one of 4 buckets in its power of two
+ * - record(): Converts cycles to microseconds using the current CPU frequency
+ * - report(): Prints a table with one row per channel
+ */
+
+
+// INCLUDES
+#include "Latency_Profiler.h"
+
+// Shared profiler instance
+LatencyProfiler profiler;
+
+#if LATENCY_PROFILER_ENABLED
+
+// Channel names for reports (same order as ProfileChannel)
+static const char* const channelNames[PROFILE_CHANNEL_COUNT] = { "loop", "wifi", "motion" };
+
+// HISTOGRAM
+int LatencyHistogram::bucketIndex(uint32_t us) {
+  if (us < SUB_BUCKETS) return us;
+
+  int octave = 31 - __builtin_clz(us);                  // Position of the highest set bit
+  int sub = (us >> (octave - 2)) & (SUB_BUCKETS - 1);   // Next 2 bits below it
+  int index = (octave - 1) * SUB_BUCKETS + sub;
+  return index < BUCKETS ? index : BUCKETS - 1;
+}
+
+uint32_t LatencyHistogram::bucketUpperEdge(int index) {
+  if (index < SUB_BUCKETS) return index;
+
+  int octave = index / SUB_BUCKETS + 1;
+  int sub = index % SUB_BUCKETS;
+  uint32_t lower = (uint32_t)(SUB_BUCKETS + sub) << (octave - 2);
+  return lower + (1UL << (octave - 2)) - 1;
+}
+
+void LatencyHistogram::record(uint32_t us) {
+  buckets[bucketIndex(us)]++;
+  count++;
+  totalUs += us;
+  if (us < minUs) minUs = us;
+  if (us > maxUs) maxUs = us;
+  if (us >= LatencyProfiler::STALL_US) stalls++;
+}
+
+void LatencyHistogram::reset() {
+  memset(buckets, 0, sizeof(buckets));
+  count = 0;
+  minUs = 0xFFFFFFFF;
+  maxUs = 0;
+  stalls = 0;
+  totalUs = 0;
+}
+
+uint32_t LatencyHistogram::percentile(float percent) const {
+  if (count == 0) return 0;
+
+  // Number of samples at or below the percentile (at least 1)
+  uint32_t target = (uint32_t)(count * percent / 100.0f + 0.5f);
+  if (target < 1) target = 1;
+
+  uint32_t seen = 0;
+  for (int i = 0; i < BUCKETS; i++) {
+    seen += buckets[i];
+    if (seen >= target) {
+      uint32_t edge = bucketUpperEdge(i);
+      return edge < maxUs ? edge : maxUs;   // Never report more than the real maximum
+    }
+  }
+
+  return maxUs;
+}
+
+// PROFILER
+void LatencyProfiler::record(ProfileChannel channel, uint32_t cycles) {
+  histograms[channel].record(cycles / ESP.getCpuFreqMHz());
+}
+
+void LatencyProfiler::reset() {
+  for (int i = 0; i < PROFILE_CHANNEL_COUNT; i++) {
+    histograms[i].reset();
+  }
+}
+
+void LatencyProfiler::report(Print &output) const {
+  output.println("CHANNEL      COUNT   MIN_US   P50_US   P90_US   P99_US   MAX_US  MEAN_US  STALLS");
+
+  char line[128];    // Name + 8 counters of up to 10 digits each
+  for (int i = 0; i < PROFILE_CHANNEL_COUNT; i++) {
+    const LatencyHistogram &h = histograms[i];
+    snprintf(line, sizeof(line), "%-8s %9lu %8lu %8lu %8lu %8lu %8lu %8lu %7lu",
+             channelNames[i], (unsigned long)h.getCount(), (unsigned long)h.getMin(),
+             (unsigned long)h.percentile(50), (unsigned long)h.percentile(90),
+             (unsigned long)h.percentile(99), (unsigned long)h.getMax(),
+             (unsigned long)h.getMean(), (unsigned long)h.getStalls());
+    output.println(line);
+  }
+}
+
+#endif
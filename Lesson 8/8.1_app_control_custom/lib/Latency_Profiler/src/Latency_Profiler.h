@@ -0,0 +1,106 @@
+/*
+ * Latency_Profiler.h - Custom library for measuring how long the main subsystems take
+ * 
+ * This library times code blocks with the CPU cycle counter and keeps a histogram
+ * per subsystem, so slow or stalled loop() iterations can be found on a running robot.
+ * 
+ * IMPLEMENTATION:
+ * - PROFILE_BEGIN(channel) / PROFILE_END(channel) wrap the code to be measured
+ * - Times are converted from CPU cycles to microseconds & added to a log-bucketed histogram
+ *   (4 buckets per power of two, so every bucket is within 25% of its value)
+ * - Each channel keeps count, min, max, mean & the number of stalls (>= STALL_US)
+ * - percentile() walks the buckets and returns the upper edge of the matching bucket
+ * - report() prints one line per channel with min, p50, p90, p99 & max
+ * 
+ * NOTES:
+ * - Add "-D LATENCY_PROFILER_ENABLED=0" to build_flags for release builds, the macros
+ *   then compile to nothing and the profiler keeps no histograms in RAM
+ * - A measurement costs two cycle counter reads & one histogram update (well under 1us)
+ */
+
+
+#ifndef LATENCY_PROFILER_H
+#define LATENCY_PROFILER_H
+
+// INCLUDES
+#include <Arduino.h>
+
+// DEFINES
+#ifndef LATENCY_PROFILER_ENABLED
+#define LATENCY_PROFILER_ENABLED 1
+#endif
+
+// ENUMS
+enum ProfileChannel {
+  PROFILE_LOOP,       // One full pass through loop()
+  PROFILE_WIFI,       // wifi.handleClient()
+  PROFILE_MOTION,     // One servo frame (robot.update() or the motion Ticker)
+  PROFILE_CHANNEL_COUNT
+};
+
+// CLASSES
+#if LATENCY_PROFILER_ENABLED
+
+class LatencyHistogram {
+  public:
+    static const int SUB_BUCKETS = 4;                 // Buckets per power of two
+    static const int BUCKETS = 21 * SUB_BUCKETS;      // Covers 0us to ~4 seconds
+
+    void record(uint32_t us);
+    void reset();
+
+    uint32_t getCount() const { return count; }
+    uint32_t getMin() const { return count ? minUs : 0; }
+    uint32_t getMax() const { return maxUs; }
+    uint32_t getMean() const { return count ? (uint32_t)(totalUs / count) : 0; }
+    uint64_t getTotal() const { return totalUs; }
+    uint32_t getStalls() const { return stalls; }
+    uint32_t percentile(float percent) const;         // e.g. percentile(99.0)
+
+  private:
+    uint32_t buckets[BUCKETS] = {};
+    uint32_t count = 0;
+    uint32_t minUs = 0xFFFFFFFF;
+    uint32_t maxUs = 0;
+    uint32_t stalls = 0;
+    uint64_t totalUs = 0;
+
+    static int bucketIndex(uint32_t us);
+    static uint32_t bucketUpperEdge(int index);
+};
+
+class LatencyProfiler {
+  public:
+    static const uint32_t STALL_US = 20000;           // Anything slower counts as a stall
+
+    void record(ProfileChannel channel, uint32_t cycles);
+    void reset();
+    const LatencyHistogram &get(ProfileChannel channel) const { return histograms[channel]; }
+    void report(Print &output) const;
+
+  private:
+    LatencyHistogram histograms[PROFILE_CHANNEL_COUNT];
+};
+
+// Time a block of code (both macros must be in the same scope)
+#define PROFILE_BEGIN(channel)  uint32_t profileStart_##channel = ESP.getCycleCount()
+#define PROFILE_END(channel)    profiler.record(channel, ESP.getCycleCount() - profileStart_##channel)
+
+#else
+
+// Profiling compiled out - same interface, no RAM & no code
+class LatencyProfiler {
+  public:
+    void reset() {}
+    void report(Print &output) const { output.println("Latency profiler disabled"); }
+};
+
+#define PROFILE_BEGIN(channel)
+#define PROFILE_END(channel)
+
+#endif
+
+// Shared profiler instance
+extern LatencyProfiler profiler;
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * Memory_Monitor.cpp - Implementation of the MemoryMonitor library
+ * 
+ * IMPLEMENTATION:
+ * - sample(): Reads the figures, updates the worst values & checks the thresholds
+ * - report(): Prints the latest & worst values and any active warnings
+ */
+
+
+// INCLUDES
+#include "Memory_Monitor.h"
+
+// CLASS IMPLEMENTATION
+MemoryMonitor::MemoryMonitor() {
+  // Default thresholds - a rough guide for the ESP8266 (about 50KB of heap after boot)
+  thresholds.minFreeHeap = 8000;
+  thresholds.maxFragmentation = 50;
+  thresholds.minFreeBlock = 4000;
+  thresholds.minFreeStack = 1024;
+
+  warningCallback = nullptr;
+  activeWarnings = 0;
+  warningCount = 0;
+  sampleCount = 0;
+
+  memset(&last, 0, sizeof(last));
+  worst.freeHeap = 0xFFFFFFFF;
+  worst.fragmentation = 0;
+  worst.maxFreeBlock = 0xFFFFFFFF;
+  worst.freeStack = 0xFFFFFFFF;
+}
+
+void MemoryMonitor::sample() {
+  last.freeHeap = ESP.getFreeHeap();
+  last.fragmentation = ESP.getHeapFragmentation();
+  last.maxFreeBlock = ESP.getMaxFreeBlockSize();
+  last.freeStack = ESP.getFreeContStack();
+  sampleCount++;
+
+  // Worst values since boot
+  if (last.freeHeap < worst.freeHeap) worst.freeHeap = last.freeHeap;
+  if (last.fragmentation > worst.fragmentation) worst.fragmentation = last.fragmentation;
+  if (last.maxFreeBlock < worst.maxFreeBlock) worst.maxFreeBlock = last.maxFreeBlock;
+  if (last.freeStack < worst.freeStack) worst.freeStack = last.freeStack;
+
+  // Check the thresholds
+  uint8_t warnings = 0;
+  if (last.freeHeap < thresholds.minFreeHeap) warnings |= MEMORY_LOW_HEAP;
+  if (last.fragmentation > thresholds.maxFragmentation) warnings |= MEMORY_FRAGMENTED;
+  if (last.maxFreeBlock < thresholds.minFreeBlock) warnings |= MEMORY_SMALL_BLOCK;
+  if (last.freeStack < thresholds.minFreeStack) warnings |= MEMORY_LOW_STACK;
+
+  // Only report warnings that weren't already active
+  uint8_t newWarnings = warnings & ~activeWarnings;
+  activeWarnings = warnings;
+
+  if (newWarnings) {
+    warningCount++;
+    if (warningCallback) {
+      warningCallback(newWarnings, last);
+    }
+  }
+}
+
+void MemoryMonitor::report(Print &output) const {
+  char line[64];
+  output.println("MEMORY          LAST     WORST");
+  snprintf(line, sizeof(line), "free_heap %10lu %9lu", (unsigned long)last.freeHeap, (unsigned long)worst.freeHeap);
+  output.println(line);
+  snprintf(line, sizeof(line), "frag_pct  %10u %9u", last.fragmentation, worst.fragmentation);
+  output.println(line);
+  snprintf(line, sizeof(line), "max_block %10lu %9lu", (unsigned long)last.maxFreeBlock, (unsigned long)worst.maxFreeBlock);
+  output.println(line);
+  snprintf(line, sizeof(line), "stack_hwm %10lu %9lu", (unsigned long)last.freeStack, (unsigned long)worst.freeStack);
+  output.println(line);
+
+  output.print("warnings: 0x");
+  output.print(activeWarnings, HEX);
+  output.print(" (");
+  output.print(warningCount);
+  output.println(" raised since boot)");
+}
@@ -0,0 +1,135 @@
+/*
+ * Metrics_Server.cpp - Implementation of the MetricsServer library
+ * 
+ * IMPLEMENTATION:
+ * - begin(): Creates the AsyncWebServer once & routes GET /metrics to handleScrape()
+ * - handleScrape(): Renders the buffer & sends it with a fill callback that copies from it
+ * - render(): Runs every collector, then adds the server's own statistics
+ * - family() / sample(): Append whole lines to the buffer with append()
+ * - append(): vsnprintf into the free part of the buffer, a line that doesn't fit is cut off
+ *   again & stops the render
+ */
+
+
+// INCLUDES
+#include "Metrics_Server.h"
+#include <stdarg.h>
+
+static_assert(METRICS_BUFFER_SIZE > METRICS_RESERVE, "METRICS_BUFFER_SIZE must leave room for the collectors");
+
+// HELPER METHODS
+void MetricsServer::append(const char* format, ...) {
+  if (full) return;
+
+  va_list args;
+  va_start(args, format);
+  size_t space = limit - length;
+  int written = vsnprintf(text + length, space, format, args);
+  va_end(args);
+
+  if (written < 0 || (size_t)written >= space) {
+    text[length] = '\0';    // Drop the partial line
+    full = true;
+    return;
+  }
+  length += written;
+}
+
+// Integer to text without printf's 64-bit support (digits holds the result)
+const char* MetricsServer::formatValue(long long value, char digits[21]) {
+  char* p = digits + 20;
+  *p = '\0';
+  unsigned long long magnitude = value < 0 ? -(unsigned long long)value : value;
+  do {
+    *--p = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude);
+  if (value < 0) *--p = '-';
+  return p;
+}
+
+void MetricsServer::handleScrape(AsyncWebServerRequest* request) {
+  if (sending) {
+    busy++;
+    request->send(503, "text/plain", "Busy\n");
+    return;
+  }
+
+  size_t size = render();
+  sending = true;
+  AsyncWebServerResponse* response = request->beginResponse("text/plain; version=0.0.4", size,
+    [this, size](uint8_t* out, size_t maxLen, size_t index) -> size_t {
+      size_t count = size - index < maxLen ? size - index : maxLen;
+      memcpy(out, text + index, count);
+      return count;
+    });
+  request->onDisconnect([this]() { sending = false; });
+  request->send(response);
+}
+
+// PUBLIC METHODS
+void MetricsServer::begin(uint16_t port) {
+  if (server) return;
+
+  server = new AsyncWebServer(port);
+  server->on("/metrics", HTTP_GET, [this](AsyncWebServerRequest* request) {
+    handleScrape(request);
+  });
+  server->onNotFound([](AsyncWebServerRequest* request) {
+    request->send(404, "text/plain", "Try /metrics\n");
+  });
+  server->begin();
+}
+
+bool MetricsServer::addCollector(Collector collector) {
+  if (collectorCount >= MAX_COLLECTORS) return false;
+
+  collectors[collectorCount++] = collector;
+  return true;
+}
+
+size_t MetricsServer::render() {
+  uint32_t start = micros();
+  scrapes++;
+  length = 0;
+  text[0] = '\0';
+  full = false;
+  limit = sizeof(text) - METRICS_RESERVE;
+  rendering = true;
+
+  for (int i = 0; i < collectorCount; i++) {
+    collectors[i](*this);
+  }
+
+  // The server's own figures go into the reserve (the render time is the previous scrape's)
+  if (full) truncated++;
+  full = false;
+  limit = sizeof(text);
+  family("metrics_scrapes_total", "counter", "Metrics scrapes served");
+  sample("metrics_scrapes_total", scrapes);
+  family("metrics_truncated_total", "counter", "Scrapes cut short by a full buffer");
+  sample("metrics_truncated_total", truncated);
+  family("metrics_render_us", "gauge", "Time the previous scrape took to render");
+  sample("metrics_render_us", renderUs);
+
+  rendering = false;
+  renderUs = micros() - start;
+  return length;
+}
+
+void MetricsServer::family(const char* name, const char* type, const char* help) {
+  if (!rendering) return;
+  append("# HELP " METRICS_PREFIX "%s %s\n# TYPE " METRICS_PREFIX "%s %s\n", name, help, name, type);
+}
+
+void MetricsServer::sample(const char* name, long long value) {
+  if (!rendering) return;
+  char digits[21];
+  append(METRICS_PREFIX "%s %s\n", name, formatValue(value, digits));
+}
+
+void MetricsServer::sample(const char* name, const char* label, const char* labelValue, long long value) {
+  if (!rendering) return;
+  char digits[21];
+  append(METRICS_PREFIX "%s{%s=\"%s\"} %s\n", name, label, labelValue, formatValue(value, digits));
+}
@@ -0,0 +1,101 @@
+/*
+ * Metrics_Server.h - Custom library for serving robot metrics to a Prometheus scraper over HTTP
+ * 
+ * The telemetry report is meant for people & host tools talking to one robot. A lab scraper
+ * polling a whole fleet wants the Prometheus text format from GET /metrics on every robot,
+ * without holding the app connection. This library runs that HTTP endpoint on the
+ * ESPAsyncWebServer (the server the ElegantOTA helper of Lesson 1 uses).
+ * 
+ * IMPLEMENTATION:
+ * - The sketch registers collector callbacks, like the telemetry sections
+ * - A scrape runs every collector, they write their metrics with family() & sample()
+ *   straight into one fixed text buffer (a member, so it lives in static RAM)
+ * - The response streams the buffer with a fill callback, so a scrape doesn't allocate the
+ *   body (the server still allocates its request & response objects, a few hundred bytes)
+ * - One scrape at a time - another one while the buffer is being sent gets a 503
+ * - Every metric name gets the "quadbot_" prefix, the server adds its own scrape count,
+ *   truncations & render time
+ * 
+ * OUTPUT FORMAT (Prometheus text exposition format 0.0.4):
+ *   # HELP quadbot_commands_total Commands received per action code
+ *   # TYPE quadbot_commands_total counter
+ *   quadbot_commands_total{action="0x01"} 12
+ *   quadbot_commands_total{action="0x03"} 2
+ * 
+ * NOTES:
+ * - ESPAsyncTCP runs the request handlers from the SDK between two passes through loop(),
+ *   never in the middle of one, so the collectors read the drivers' counters without locking
+ * - A sample that doesn't fit ends the collectors' output at the last whole line & counts a
+ *   truncation (quadbot_metrics_truncated_total), raise METRICS_BUFFER_SIZE if it goes up.
+ *   The end of the buffer is kept for the server's own metrics, so the count always gets out
+ * - Values are integers, use a unit that keeps the precision (us, ms, bytes)
+ */
+
+
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+// INCLUDES
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+// DEFINES
+#ifndef METRICS_BUFFER_SIZE
+#define METRICS_BUFFER_SIZE 5120
+#endif
+
+#define METRICS_RESERVE 512   // End of the buffer kept for the server's own metrics
+#define METRICS_PREFIX "quadbot_"
+
+// CLASSES
+class MetricsServer {
+  public:
+    // Collector callback - writes its metrics with family() & sample()
+    typedef void (*Collector)(MetricsServer &metrics);
+
+    // Public methods
+    void begin(uint16_t port = 80);                 // Serve GET /metrics
+    bool addCollector(Collector collector);         // Register a collector (false if table is full)
+    size_t render();                                // Run the collectors into the buffer (length)
+    const char* getText() const { return text; }    // Last rendered output
+
+    // Metric writers (only valid inside a collector)
+    void family(const char* name, const char* type, const char* help);   // # HELP & # TYPE lines
+    void sample(const char* name, long long value);
+    void sample(const char* name, const char* label, const char* labelValue, long long value);
+
+    // Statistics
+    unsigned long getScrapes() const { return scrapes; }
+    unsigned long getTruncated() const { return truncated; }
+    unsigned long getBusy() const { return busy; }            // Scrapes refused while sending
+    uint32_t getRenderUs() const { return renderUs; }         // Time the last render took
+    size_t getLength() const { return length; }
+
+  private:
+    static const int MAX_COLLECTORS = 8;
+
+    AsyncWebServer* server = nullptr;
+    Collector collectors[MAX_COLLECTORS];
+    int collectorCount = 0;
+
+    // Output buffer
+    char text[METRICS_BUFFER_SIZE];
+    size_t length = 0;
+    size_t limit = 0;               // Writers stop here (below the reserve while collecting)
+    bool rendering = false;         // Writers only work inside render()
+    bool full = false;              // A line didn't fit, the rest of this render is dropped
+    volatile bool sending = false;  // The buffer is being streamed to a scraper
+
+    // Statistics
+    unsigned long scrapes = 0;
+    unsigned long truncated = 0;
+    unsigned long busy = 0;
+    uint32_t renderUs = 0;
+
+    // Helper methods
+    void handleScrape(AsyncWebServerRequest* request);
+    void append(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    static const char* formatValue(long long value, char digits[21]);
+};
+
+#endif
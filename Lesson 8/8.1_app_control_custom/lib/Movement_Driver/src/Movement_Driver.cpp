@@ -28,6 +28,8 @@
  * 
  * - Each array row encodes:
  *   { URP, URA, LRA, LRP, ULP, ULA, LLA, LLP, milliseconds }
+ *   The dances are authored in beats instead, the last column is a fraction of BEAT
+ *   (BEAT / 4 = a sixteenth note) & the lookup table marks them as beat-timed
  * 
  * - startMovementSequence():
  *   - Initializes a movement, sets starting step
@@ -35,9 +37,102 @@
  * 
  * - update():
  *   - Advances to the next step once the current step’s duration expires
+ *   - Each step starts at the previous step's deadline (not at the time update() noticed it),
+ *     so a late update() delays one step instead of shifting the rest of the sequence
+ *   - When a step is more than lateThresholdMs late the LatePolicy decides whether to
+ *     catch up, skip the missed steps or restart the timing from now
+ *   - Lateness of every step is added to the statistics of the running sequence
  *   - Marks movement complete when all steps are finished
  *   - Can automatically chain to a queued nextState
  * 
+ * - Frames & timed updates:
+ *   - update() computes one servo frame: starts queued movements, advances steps &
+ *     (with interpolation on) writes the in-between pose of the current step
+ *   - interpolateNext() interpolates only the next sequence that starts, e.g. to glide out
+ *     of a pose restored after a deep sleep (begin(startPose)) instead of jumping
+ *   - beginTimedUpdates() runs the frame from a Ticker at a fixed rate (e.g. 50 Hz)
+ *     so motion no longer depends on how often loop() calls update()
+ *   - The ESP8266 hardware timer (timer1) is used by the Servo library's waveform generator,
+ *     so the Ticker (SDK software timer) is used instead. It fires whenever the core
+ *     gets control, including while Wi-Fi calls wait with delay() or yield()
+ *   - In timed mode the movement commands don't touch the state machine directly, they are
+ *     put into a single producer / single consumer queue that the next frame empties
+ *   - Only servos whose angle changed are written
+ *   - Every frame is timed on the PROFILE_MOTION channel, from update() or the Ticker callback
+ *   - A streaming source never reads flash in the Ticker callback: update() keeps reading
+ *     ahead in loop(), and a step that isn't read yet when it is due holds the frames on the
+ *     pose before it (the wait shows up as lateness of that step)
+ * 
+ * - Motion clock (setClock()):
+ *   - Step deadlines, idle times & the odometry of the running step use motionClock
+ *     (millis() by default), the servo bookkeeping (stagger, idle detach) stays on millis()
+ *   - A robot in a show sets the shared show clock, its steps then land on the same
+ *     deadlines as every other robot's
+ *   - setClock() & shiftClock() move stepStartTime by the jump, so the running step keeps
+ *     its remaining time & only later corrections of the clock move the deadlines
+ *   - playAt() interrupts whatever runs & starts a sequence at a time on the motion clock,
+ *     ahead of time it waits in IDLE, a start time in the past is caught up by the late policy
+ * 
+ * - Tempo (setTempo()):
+ *   - Beat-timed steps last ticks * 60000 / (BEAT * tempoBpm) ms, the speed factor doesn't
+ *     apply to them. At TEMPO_DEFAULT_BPM the dances keep their original millisecond timing
+ *   - Step deadlines are rounded from the beat position of the step end (stepTick) through
+ *     the tempo anchor, instead of adding rounded step lengths, so a song of any length
+ *     doesn't drift off the beat (tickTime())
+ *   - A tempo change while a beat-timed sequence plays is pending until the next whole beat
+ *     since the sequence started (pendingTick), the steps up to it keep their deadlines & the
+ *     anchor moves to that beat once it has passed. Otherwise it applies at once
+ *   - LATE_RESYNC & clock shifts move the anchor along with stepStartTime
+ * 
+ * - Staggered writes (setWriteStagger()):
+ *   - Starting all 8 servos in the same instant draws a current peak that can brown out
+ *     the ESP8266 on a sagging battery (push ups & fighting are the worst)
+ *   - With a stagger offset the joints of a new keyframe are written one after another,
+ *     load-bearing paws first (diagonal pairs), then the arms
+ *   - Only joints that change take a slot, and the offset is shortened so the last joint
+ *     still starts within the first half of the step - the step deadlines don't move
+ *   - The waiting writes are sent by the following frames, so with timed updates the
+ *     offsets are rounded up to the Ticker period
+ *   - Interpolated frames & writePose() are written at once (and replace waiting writes)
+ * 
+ * - Idle detach (setIdleDetach()):
+ *   - Lie down & sleep rest the body on the floor, the servos hold no load but still draw
+ *     current & get warm fighting small errors
+ *   - When the pose on the servos was left by a passive sequence (also while idle after it)
+ *     and nothing is moving, every joint whose angle hasn't changed for idleDetachMs is detached
+ *   - Starting any sequence attaches the detached joints again with their last angle as the
+ *     first pulse (Servo::attach() with a value), then the sequence moves them as usual
+ *   - A write to a detached joint (e.g. writePose()) attaches it first
+ * 
+ * - Step sources:
+ *   - The engine reads every sequence through a StepSource, one step at a time when the
+ *     step starts (ArrayStepSource for the built-in arrays, PackedStepSource for PackedStep
+ *     arrays in RAM, or e.g. a file source from Sequence_Library that streams from flash)
+ *   - Only the current step is kept (activeStep), steps are read in order, and after each
+ *     frame computed by update() (or from update() alone in timed mode) the source gets a
+ *     prefetch() call to read ahead
+ *   - A step that can't be read ends the sequence on the last pose that was read
+ *   - When a sequence ends, fails or is interrupted (idle(), playAt()) its source gets a
+ *     release() call, so a file source doesn't hold its file open until it plays again
+ * 
+ * - Registered sequences (registerSequence()):
+ *   - Sequences loaded at runtime are PackedStep arrays (8 angle bytes + uint16 ms) or any
+ *     other StepSource owned by the caller, the registry only stores the name & the source
+ *   - They play in the CUSTOM state with currentCustom selecting the entry
+ *   - IDs 0-15 are the built-in states, registered sequences start at CUSTOM_SEQUENCE_BASE,
+ *     play(id) & play(name) start either kind
+ *   - Registering an existing name replaces its steps (not while that sequence is playing)
+ * 
+ * - Odometry:
+ *   - Each sequence has a calibration entry with the displacement & yaw of one full cycle
+ *   - Every completed step adds its share of the cycle (step ms / cycle ms) to the estimate
+ *   - getOdometry() also includes the elapsed part of the step currently playing
+ *   - The share is taken from the authored durations, so a speed factor changes how fast
+ *     the distance accumulates but not how far one cycle goes
+ * 
+ * - Tracing:
+ *   - Frames, servo writes, sequence starts & steps are recorded by the Trace_Recorder
+ * 
  * - Main sketch remains simple:
  *   - Call update() continuously in loop()
  *   - React to getState() and isBusy() for transitions
@@ -63,6 +158,9 @@
 
 // INCLUDES
 #include "Movement_Driver.h"
+#include "Event_Log.h"
+#include "Trace_Recorder.h"
+#include "Latency_Profiler.h"
 
 // MOVEMENT ARRAYS
 const int MovementDriver::standbyArray[1][9] = {    // standby postions array
@@ -160,48 +258,48 @@ const int MovementDriver::waveHelloArray[12][9] = {   // wave hello movement pos
 };
 
 const int MovementDriver::dance1Array[9][9] = {   // dance routine 1 movement positions array
-// URP---URA---LRA---LRP---ULP---ULA---LLA---LLP---MS
-  { 60,   92,   90,   78,   90,   85,   80,   92,  400},  // step 1 - drop URP (-30)
-  { 90,   92,   90,  108,   90,   85,   80,   92,  400},  // step 2 - lift URP & drop LRP (+30)
-  { 90,   92,   90,   78,   90,   85,   80,   62,  400},  // step 3 - lift LRP & drop LLP (-30)
-  { 90,   92,   90,   78,  120,   85,   80,   92,  400},  // step 4 - drop ULP & lift LLP (+30)
-  { 60,   92,   90,   78,   90,   85,   80,   92,  400},  // step 5 - lift ULP & drop URP (-30)
-  { 90,   92,   90,  108,   90,   85,   80,   92,  400},  // step 6 - lift URP & drop LRP (+30)
-  { 90,   92,   90,   78,   90,   85,   80,   62,  400},  // step 7 - lift LRP & drop LLP (-30)
-  { 90,   92,   90,   78,  120,   85,   80,   92,  400},  // step 8 - drop ULP & lift LLP (+30)
-  { 90,   92,   90,   78,   90,   85,   80,   92,  400},  // step 9 - lift ULP (+30)
+// URP---URA---LRA---LRP---ULP---ULA---LLA---LLP---BEATS
+  { 60,   92,   90,   78,   90,   85,   80,   92,  BEAT},  // step 1 - drop URP (-30)
+  { 90,   92,   90,  108,   90,   85,   80,   92,  BEAT},  // step 2 - lift URP & drop LRP (+30)
+  { 90,   92,   90,   78,   90,   85,   80,   62,  BEAT},  // step 3 - lift LRP & drop LLP (-30)
+  { 90,   92,   90,   78,  120,   85,   80,   92,  BEAT},  // step 4 - drop ULP & lift LLP (+30)
+  { 60,   92,   90,   78,   90,   85,   80,   92,  BEAT},  // step 5 - lift ULP & drop URP (-30)
+  { 90,   92,   90,  108,   90,   85,   80,   92,  BEAT},  // step 6 - lift URP & drop LRP (+30)
+  { 90,   92,   90,   78,   90,   85,   80,   62,  BEAT},  // step 7 - lift LRP & drop LLP (-30)
+  { 90,   92,   90,   78,  120,   85,   80,   92,  BEAT},  // step 8 - drop ULP & lift LLP (+30)
+  { 90,   92,   90,   78,   90,   85,   80,   92,  BEAT},  // step 9 - lift ULP (+30)
 };
 
 const int MovementDriver::dance2Array[8][9] = {   // dance routine 2 movement positions array
-// URP---URA---LRA---LRP---ULP---ULA---LLA---LLP---MS
-  {100,   92,   90,   68,   95,   85,   80,   82,  400},  // step 1 - lift URP (+20) & LRP (-20)
-  { 80,   92,   90,   88,   75,   85,   80,  102,  400},  // step 2 - drop URP & LRP (-20)       | lift ULP (-20) & LLP (+20)
-  {100,   92,   90,   68,   95,   85,   80,   82,  400},  // step 3 - drop ULP (+20) & LLP (-20) | lift URP (+20) & LRP (-20)
-  { 80,   92,   90,   88,   75,   85,   80,  102,  400},  // step 4 - drop URP & LRP (-20)       | lift ULP (-20) & LLP (+20)
-  {100,   92,   90,   68,   95,   85,   80,   82,  400},  // step 5 - drop ULP (+20) & LLP (-20) | lift URP (+20) & LRP (-20)
-  { 80,   92,   90,   88,   75,   85,   80,  102,  400},  // step 6 - drop URP & LRP (-20)       | lift ULP (-20) & LLP (+20)
-  {100,   92,   90,   68,   95,   85,   80,   82,  400},  // step 7 - drop ULP (+20) & LLP (-20) | lift URP (+20) & LRP (-20)
-  { 80,   92,   90,   88,   95,   85,   80,   82,  400},  // step 8 - drop URP & LRP (-20)
+// URP---URA---LRA---LRP---ULP---ULA---LLA---LLP---BEATS
+  {100,   92,   90,   68,   95,   85,   80,   82,  BEAT},  // step 1 - lift URP (+20) & LRP (-20)
+  { 80,   92,   90,   88,   75,   85,   80,  102,  BEAT},  // step 2 - drop URP & LRP (-20)       | lift ULP (-20) & LLP (+20)
+  {100,   92,   90,   68,   95,   85,   80,   82,  BEAT},  // step 3 - drop ULP (+20) & LLP (-20) | lift URP (+20) & LRP (-20)
+  { 80,   92,   90,   88,   75,   85,   80,  102,  BEAT},  // step 4 - drop URP & LRP (-20)       | lift ULP (-20) & LLP (+20)
+  {100,   92,   90,   68,   95,   85,   80,   82,  BEAT},  // step 5 - drop ULP (+20) & LLP (-20) | lift URP (+20) & LRP (-20)
+  { 80,   92,   90,   88,   75,   85,   80,  102,  BEAT},  // step 6 - drop URP & LRP (-20)       | lift ULP (-20) & LLP (+20)
+  {100,   92,   90,   68,   95,   85,   80,   82,  BEAT},  // step 7 - drop ULP (+20) & LLP (-20) | lift URP (+20) & LRP (-20)
+  { 80,   92,   90,   88,   95,   85,   80,   82,  BEAT},  // step 8 - drop URP & LRP (-20)
 };
 
 const int MovementDriver::dance3Array[16][9] = {   // dance routine 3 movement positions array
-// URP---URA---LRA---LRP---ULP---ULA---LLA---LLP---MS
-  { 80,   92,   90,   80,   95,   85,   80,   82,   50},  // step 1 - lift LRP (-8)
-  { 80,   92,    2,   88,   95,   85,   80,   82,  100},  // step 2 - move LRA (-88) back | drop LRP (+8)
-  { 80,   92,    2,   88,   95,   85,   80,   76,   50},  // step 3 - lift LLP (-8)
-  { 80,   92,    2,   88,   95,   85,  170,   82,  100},  // step 4 - move LLA (+90) back | drop LLP (+8)
-  {100,   92,    2,   63,   75,   85,  170,   82,  400},  // step 5 - lift URP (+20), ULP (-20) & LRP (-25)
-  { 80,   92,    2,   88,   95,   85,  170,   82,  400},  // step 6 - drop URP (-20), ULP (+20) & LRP (+25)
-  {100,   92,    2,   88,   75,   85,  170,  107,  400},  // step 7 - lift URP (+20), ULP (-20) & LLP (+25)
-  { 80,   92,    2,   88,   95,   85,  170,   82,  400},  // step 8 - drop URP (-20), ULP (+20) & LLP (-25)
-  {100,   92,    2,   63,   75,   85,  170,   82,  400},  // step 9 - lift URP (+20), ULP (-20) & LRP (-25)
-  { 80,   92,    2,   88,   95,   85,  170,   82,  400},  // step 10 - drop URP (-20), ULP (+20) & LRP (+25)
-  {100,   92,    2,   88,   75,   85,  170,  107,  400},  // step 11 - lift URP (+20), ULP (-20) & LLP (+25)
-  { 80,   92,    2,   88,   95,   85,  170,   82,   50},  // step 12 - drop URP (-20), ULP (+20) & LLP (-25)
-  { 80,   92,    2,   80,   95,   85,  170,   82,   50},  // step 13 - lift LRP (-8)
-  { 80,   92,   90,   88,   95,   85,  170,   82,  100},  // step 14 - move LRA (+88) forward | drop LRP (+8)
-  { 80,   92,   90,   80,   95,   85,  170,   76,   50},  // step 15 - lift LLP (-8)
-  { 80,   92,   90,   88,   95,   85,   80,   82,  500},  // step 16 - move LLA (-90) forward | drop LLP (+8)
+// URP---URA---LRA---LRP---ULP---ULA---LLA---LLP---BEATS
+  { 80,   92,   90,   80,   95,   85,   80,   82,      BEAT / 8},  // step 1 - lift LRP (-8)
+  { 80,   92,    2,   88,   95,   85,   80,   82,      BEAT / 4},  // step 2 - move LRA (-88) back | drop LRP (+8)
+  { 80,   92,    2,   88,   95,   85,   80,   76,      BEAT / 8},  // step 3 - lift LLP (-8)
+  { 80,   92,    2,   88,   95,   85,  170,   82,      BEAT / 4},  // step 4 - move LLA (+90) back | drop LLP (+8)
+  {100,   92,    2,   63,   75,   85,  170,   82,          BEAT},  // step 5 - lift URP (+20), ULP (-20) & LRP (-25)
+  { 80,   92,    2,   88,   95,   85,  170,   82,          BEAT},  // step 6 - drop URP (-20), ULP (+20) & LRP (+25)
+  {100,   92,    2,   88,   75,   85,  170,  107,          BEAT},  // step 7 - lift URP (+20), ULP (-20) & LLP (+25)
+  { 80,   92,    2,   88,   95,   85,  170,   82,          BEAT},  // step 8 - drop URP (-20), ULP (+20) & LLP (-25)
+  {100,   92,    2,   63,   75,   85,  170,   82,          BEAT},  // step 9 - lift URP (+20), ULP (-20) & LRP (-25)
+  { 80,   92,    2,   88,   95,   85,  170,   82,          BEAT},  // step 10 - drop URP (-20), ULP (+20) & LRP (+25)
+  {100,   92,    2,   88,   75,   85,  170,  107,          BEAT},  // step 11 - lift URP (+20), ULP (-20) & LLP (+25)
+  { 80,   92,    2,   88,   95,   85,  170,   82,      BEAT / 8},  // step 12 - drop URP (-20), ULP (+20) & LLP (-25)
+  { 80,   92,    2,   80,   95,   85,  170,   82,      BEAT / 8},  // step 13 - lift LRP (-8)
+  { 80,   92,   90,   88,   95,   85,  170,   82,      BEAT / 4},  // step 14 - move LRA (+88) forward | drop LRP (+8)
+  { 80,   92,   90,   80,   95,   85,  170,   76,      BEAT / 8},  // step 15 - lift LLP (-8)
+  { 80,   92,   90,   88,   95,   85,   80,   82,  BEAT * 5 / 4},  // step 16 - move LLA (-90) forward | drop LLP (+8)
 };
 
 const int MovementDriver::lieDownArray[2][9] = {    // lie down movement positions array
@@ -264,25 +362,51 @@ const int MovementDriver::sleepArray[4][9] = {   // sleep movement positions arr
 
 
 
+// Servo pins in position array column order (URP, URA, LRA, LRP, ULP, ULA, LLA, LLP)
+const uint8_t MovementDriver::servoPins[8] = {D5, D6, D7, D8, D0, D1, D2, D4};
+
 // Sequeneces lookup table
 const MovementArray MovementDriver::sequences[17] = {
-  { standbyArray,   1 }, // STANDBY
-  { readyArray,     1 }, // READY
-  { forwardArray,   8 }, // FORWARD
-  { backwardArray,  8 }, // BACKWARD
-  { turnLeftArray,  9 }, // TURN_LEFT
-  { turnRightArray, 9 }, // TURN_RIGHT
-  { moveLeftArray,  5 }, // MOVE_LEFT
-  { moveRightArray, 5 }, // MOVE_RIGHT
-  { waveHelloArray, 12}, // WAVE_HELLO
-  { dance1Array,    9 }, // DANCE1
-  { dance2Array,    8 }, // DANCE2
-  { dance3Array,    16}, // DANCE3
-  { lieDownArray,   2 }, // LIE_DOWN
-  { fightingArray,  15}, // FIGHTING
-  { pushUpsArray,   21}, // PUSH_UPS
-  { sleepArray,     4 }, // SLEEP
-  { nullptr,        0 }  // IDLE
+  { standbyArray,   1,  false}, // STANDBY
+  { readyArray,     1,  false}, // READY
+  { forwardArray,   8,  false}, // FORWARD
+  { backwardArray,  8,  false}, // BACKWARD
+  { turnLeftArray,  9,  false}, // TURN_LEFT
+  { turnRightArray, 9,  false}, // TURN_RIGHT
+  { moveLeftArray,  5,  false}, // MOVE_LEFT
+  { moveRightArray, 5,  false}, // MOVE_RIGHT
+  { waveHelloArray, 12, false}, // WAVE_HELLO
+  { dance1Array,    9,  true }, // DANCE1
+  { dance2Array,    8,  true }, // DANCE2
+  { dance3Array,    16, true }, // DANCE3
+  { lieDownArray,   2,  false}, // LIE_DOWN
+  { fightingArray,  15, false}, // FIGHTING
+  { pushUpsArray,   21, false}, // PUSH_UPS
+  { sleepArray,     4,  false}, // SLEEP
+  { nullptr,        0,  false}  // IDLE
+};
+
+// Per-cycle displacement lookup table (rough defaults - measure & adjust for your build)
+const GaitCalibration MovementDriver::defaultCalibrations[18] = {
+// FWD-MM--LAT-MM--YAW-DEG
+  {   0.0,    0.0,    0.0 }, // STANDBY
+  {   0.0,    0.0,    0.0 }, // READY
+  {  40.0,    0.0,    0.0 }, // FORWARD
+  { -40.0,    0.0,    0.0 }, // BACKWARD
+  {   0.0,    0.0,   30.0 }, // TURN_LEFT
+  {   0.0,    0.0,  -30.0 }, // TURN_RIGHT
+  {   0.0,   30.0,    0.0 }, // MOVE_LEFT
+  {   0.0,  -30.0,    0.0 }, // MOVE_RIGHT
+  {   0.0,    0.0,    0.0 }, // WAVE_HELLO
+  {   0.0,    0.0,    0.0 }, // DANCE1
+  {   0.0,    0.0,    0.0 }, // DANCE2
+  {   0.0,    0.0,    0.0 }, // DANCE3
+  {   0.0,    0.0,    0.0 }, // LIE_DOWN
+  {   0.0,    0.0,    0.0 }, // FIGHTING
+  {   0.0,    0.0,    0.0 }, // PUSH_UPS
+  {   0.0,    0.0,    0.0 }, // SLEEP
+  {   0.0,    0.0,    0.0 }, // IDLE
+  {   0.0,    0.0,    0.0 }  // CUSTOM
 };
 
 // CLASS IMPLEMENTATION
@@ -293,94 +417,577 @@ MovementDriver::MovementDriver() {
   currentStep = 0;
   stepStartTime = 0;
   isMoving = false;
+  idleDuration = 0;
+  speedFactor = 1.0;
+  beatTimed = false;
+  tempoBpm = TEMPO_DEFAULT_BPM;
+  pendingBpm = 0;
+  pendingTick = 0;
+  anchorTick = 0;
+  anchorTime = 0;
+  stepTick = 0;
+  beatStepMs = 0;
+  cycleDuration = 0;
+  latePolicy = LATE_SKIP;
+  lateThresholdMs = 200;
+  resetStepTiming();
+  interpolate = false;
+  interpolateNextSequence = false;
+  interpolating = false;
+  staggerMs = 0;
+  pendingMask = 0;
+  idleDetachMs = 0;
+  passiveStates = 0;
+  poseState = IDLE;
+  detachedMask = 0;
+  detachCount = 0;
+  commandHead = 0;
+  commandTail = 0;
+  droppedCommands = 0;
+  timedUpdates = false;
+  motionClock = millis;
+  customCount = 0;
+  currentCustom = 0;
+  nextCustom = 0;
+  activeSource = &builtInSource;
+  builtInSource.set(sequences[STANDBY]);
+  memset(&activeStep, 0, sizeof(activeStep));
+  readErrors = 0;
+  memset(completed, 0, sizeof(completed));
+
+  // Servos in the same order as the position array columns
+  servos[0] = &servoD5_URP;
+  servos[1] = &servoD6_URA;
+  servos[2] = &servoD7_LRA;
+  servos[3] = &servoD8_LRP;
+  servos[4] = &servoD0_ULP;
+  servos[5] = &servoD1_ULA;
+  servos[6] = &servoD2_LLA;
+  servos[7] = &servoD4_LLP;
+  for (int i = 0; i < 8; i++) {
+    commandedPose[i] = -1;    // Nothing written yet
+    jointChangedAt[i] = 0;
+  }
+
+  // Load-bearing paws first (diagonal pairs URP+LLP, LRP+ULP), then the arms in the same pairs
+  const uint8_t defaultOrder[8] = {0, 7, 3, 4, 1, 6, 2, 5};
+  setWriteOrder(defaultOrder);
+
+  for (int i = 0; i < 18; i++) {
+    calibrations[i] = defaultCalibrations[i];
+  }
+  resetOdometry();
 }
 
 // Initialize all servos with their pulse width ranges 
 void MovementDriver::begin() {
-  servoD5_URP.attach(D5, 500, 2500);
-  servoD6_URA.attach(D6, 500, 2500);
-  servoD7_LRA.attach(D7, 500, 2500);
-  servoD8_LRP.attach(D8, 500, 2500);
-  servoD0_ULP.attach(D0, 500, 2500);
-  servoD1_ULA.attach(D1, 500, 2500);
-  servoD2_LLA.attach(D2, 500, 2500);
-  servoD4_LLP.attach(D4, 500, 2500);
+  for (int i = 0; i < 8; i++) {
+    servos[i]->attach(servoPins[i], SERVO_MIN_US, SERVO_MAX_US);
+  }
+}
+
+// Initialize the servos with startPose as their first pulse (e.g. the pose saved before a deep sleep)
+void MovementDriver::begin(const int startPose[8]) {
+  unsigned long now = millis();
+  for (int i = 0; i < 8; i++) {
+    servos[i]->attach(servoPins[i], SERVO_MIN_US, SERVO_MAX_US, startPose[i]);
+    commandedPose[i] = startPose[i];
+    jointChangedAt[i] = now;
+  }
 }
 
 // Non-blocking update method - must be called in main loop
 void MovementDriver::update() {
+  if (!timedUpdates) {        // Otherwise the Ticker computes the frames
+    PROFILE_BEGIN(PROFILE_MOTION);
+    updateFrame();
+    PROFILE_END(PROFILE_MOTION);
+  }
+
+  // Let a streaming source read ahead, outside the frame & never in the Ticker callback
+  if (isMoving) activeSource->prefetch();
+}
+
+// Compute one servo frame
+void MovementDriver::updateFrame() {
+  TRACE_POLL_SCOPE(TRACE_MOTION_FRAME);
+
+  // Send staggered servo writes that are due
+  if (pendingMask) {
+    servicePendingWrites();
+  }
+
+  // Apply commands handed over by the main loop
+  processCommands();
+
   // If in IDLE state, check if the duration has passed before moving to the next state.
   if (currentState == IDLE) {
-    if (millis() - stepStartTime >= idleDuration) {
+    if ((long)(motionClock() - stepStartTime) >= (long)idleDuration) {   // Signed, the clock may step back a little
       if (nextState != IDLE) {
-        startMovementSequence(nextState);  // Start the next movement
+        startMovementSequence(nextState, stepStartTime + idleDuration, nextCustom);  // Start the next movement on time
         nextState = IDLE;
+        return;
       }
     }
+    if (idleDetachMs && detachedMask != 0xFF) detachIdleJoints();
+    return;
+  }
+
+  // If not currently moving, only the idle detach has something to do
+  if (!isMoving) {
+    if (idleDetachMs && detachedMask != 0xFF) detachIdleJoints();
     return;
   }
 
-  // If not currently moving, nothing to do
-  if (!isMoving) return;
+  unsigned long currentTime = motionClock();
+  int size = activeSource->getSize();
 
-  unsigned long currentTime = millis();
-  const MovementArray &seq = sequences[currentState];
-  unsigned long stepDuration = seq.steps[currentStep][8];  // Get duration from array
+  // A tempo change becomes the new anchor once its beat has passed
+  if (pendingBpm && (long)(currentTime - tickTime(pendingTick)) >= 0) {
+    anchorTime = tickTime(pendingTick);
+    anchorTick = pendingTick;
+    tempoBpm = pendingBpm;
+    pendingBpm = 0;
+  }
+  unsigned long stepDuration = stepLength();  // Get duration from the step
+
+  // Check if it's time to move to the next step (and the step is there)
+  if ((long)(currentTime - stepStartTime) >= (long)stepDuration && isStepReady(currentStep + 1)) {
+    // Add the finished step to the odometry estimate
+    if (cycleDuration > 0) {
+      integrateOdometry(odometry, currentState, (float)activeStep.durationMs / cycleDuration);
+    }
+
+    // The next step starts at this step's deadline, record how late we are
+    unsigned long deadline = stepStartTime + stepDuration;
+    unsigned long lateness = currentTime - deadline;
+    StepTiming &timing = stepTiming[currentState];
+    timing.steps++;
+    if (lateness > 0) timing.lateSteps++;
+    timing.totalLateMs += lateness;
+    if (lateness > timing.maxLateMs) timing.maxLateMs = lateness;
 
-  // Check if it's time to move to the next step
-  if (currentTime - stepStartTime >= stepDuration) {
     currentStep++;
+    stepStartTime = deadline;
+    stepTick += activeStep.durationMs;
+    bool loaded = currentStep >= size || loadStep(currentStep);
+
+    // Far behind - apply the late policy
+    if (lateness > lateThresholdMs) {
+      LOG_WARN(EVT_STEP_LATE, getSequenceId(), currentStep, lateness > 0xFFFF ? 0xFFFF : lateness);
+      TRACE_INSTANT(TRACE_STEP_LATE, lateness > 0xFFFF ? 0xFFFF : lateness);
+      if (latePolicy == LATE_RESYNC) {
+        stepStartTime = currentTime;
+        anchorTime = currentTime;    // The beat restarts from now as well
+        anchorTick = stepTick;
+        if (beatTimed) timeBeatStep();
+        timing.resyncs++;
+      }
+      else if (latePolicy == LATE_SKIP) {
+        // Skip every step that should already have finished
+        while (loaded && currentStep < size) {
+          unsigned long duration = stepLength();
+          if (currentTime - stepStartTime < duration || !isStepReady(currentStep + 1)) break;
+          stepStartTime += duration;
+          stepTick += activeStep.durationMs;
+          currentStep++;
+          timing.skippedSteps++;
+          loaded = currentStep >= size || loadStep(currentStep);
+        }
+      }
+    }
 
     // If we finished all steps in this movement
-    if (currentStep >= seq.size) {
+    // (a step that can't be read ends the movement early)
+    int pose[8];
+    if (currentStep >= size || !loaded) {
+      if (!loaded) {
+        readErrors++;
+        LOG_WARN(EVT_STEP_READ_FAILED, getSequenceId(), currentStep);
+      }
+      else {
+        completed[currentState]++;
+      }
       isMoving = false; // Movement complete
+      activeSource->release();
+      LOG_DEBUG(EVT_SEQUENCE_END, getSequenceId());
+      unpackPose(activeStep, pose);
+      writeKeyframe(pose, 0);    // Land exactly on the last pose (even if skipped)
       
-      // If another movement is waiting, start it
+      // If another movement is waiting, start it where this one ended
       if (nextState != IDLE) {
-        startMovementSequence(nextState);
+        startMovementSequence(nextState, stepStartTime, nextCustom);
         nextState = IDLE;
       }
       return;
     }
 
     // Move to next step - set new servo positions
-    setServoPositions(seq.steps[currentStep]);
-    stepStartTime = currentTime;
+    TRACE_INSTANT(TRACE_STEP, currentStep);
+    stepDuration = stepLength();
+    unpackPose(activeStep, pose);
+    beginStep(pose, stepDuration);
+  }
+
+  // Smooth movement towards the current step's pose
+  if (interpolating) {
+    writeInterpolatedFrame(currentTime, stepDuration);
   }
 }
 
-// Write servo positions
+// Write servo positions (only the servos that change)
 void MovementDriver::setServoPositions(const int positions[]) {
-  servoD5_URP.write(positions[0]);
-  servoD6_URA.write(positions[1]);
-  servoD7_LRA.write(positions[2]);
-  servoD8_LRP.write(positions[3]);
-  servoD0_ULP.write(positions[4]);
-  servoD1_ULA.write(positions[5]);
-  servoD2_LLA.write(positions[6]);
-  servoD4_LLP.write(positions[7]);
+  TRACE_SCOPE(TRACE_SERVO_WRITE, currentState);
+  pendingMask = 0;    // Replaces any staggered writes still waiting
+  unsigned long now = millis();
+  for (int i = 0; i < 8; i++) {
+    if (positions[i] != commandedPose[i]) {
+      writeJoint(i, positions[i], now);
+    }
+  }
 }
 
-// Start a new movement sequence
+// Copy the last angle written to each joint
+void MovementDriver::getCommandedPose(int positions[8]) const {
+  for (int i = 0; i < 8; i++) {
+    positions[i] = commandedPose[i];
+  }
+}
+
+// Write one joint & remember when it changed (a detached joint is attached first)
+void MovementDriver::writeJoint(int joint, int angle, unsigned long now) {
+  if (detachedMask & (1 << joint)) {
+    servos[joint]->attach(servoPins[joint], SERVO_MIN_US, SERVO_MAX_US, angle);
+    detachedMask &= ~(1 << joint);
+  }
+  else {
+    servos[joint]->write(angle);
+  }
+  commandedPose[joint] = angle;
+  jointChangedAt[joint] = now;
+}
+
+// Write a keyframe, staggered over (at most) the first half of windowMs when staggering is on
+void MovementDriver::writeKeyframe(const int positions[], unsigned long windowMs) {
+  if (staggerMs == 0) {
+    setServoPositions(positions);
+    return;
+  }
+
+  // Joints that have to move (a waiting write to the same joint is replaced)
+  int changed = 0;
+  for (int i = 0; i < 8; i++) {
+    pendingMask &= ~(1 << i);
+    if (positions[i] != commandedPose[i]) changed++;
+  }
+  if (changed == 0) return;
+
+  // Shorten the offset so the last joint starts within the first half of the step
+  unsigned long offset = staggerMs;
+  if (windowMs > 0 && changed > 1 && offset * (changed - 1) > windowMs / 2) {
+    offset = windowMs / 2 / (changed - 1);
+  }
+
+  // Give every changed joint a slot in priority order
+  unsigned long due = millis();
+  for (int k = 0; k < 8; k++) {
+    int i = writeOrder[k];
+    if (positions[i] == commandedPose[i]) continue;
+    pendingPose[i] = positions[i];
+    pendingDue[i] = due;
+    pendingMask |= 1 << i;
+    due += offset;
+  }
+
+  servicePendingWrites();   // The first joint starts now
+}
+
+// Write the staggered joints whose slot has come
+void MovementDriver::servicePendingWrites() {
+  unsigned long now = millis();
+  for (int k = 0; k < 8 && pendingMask; k++) {
+    int i = writeOrder[k];
+    if (!(pendingMask & (1 << i)) || (long)(now - pendingDue[i]) < 0) continue;
+
+    writeJoint(i, pendingPose[i], now);
+    pendingMask &= ~(1 << i);
+  }
+}
+
+// Start moving towards a step's pose
+void MovementDriver::beginStep(const int positions[], unsigned long duration) {
+  if (!interpolating) {
+    writeKeyframe(positions, duration);
+    return;
+  }
+
+  // Interpolate from wherever the servos are now (the very first pose is written directly)
+  for (int i = 0; i < 8; i++) {
+    fromPose[i] = commandedPose[i] < 0 ? positions[i] : commandedPose[i];
+    targetPose[i] = positions[i];
+  }
+}
+
+// Write the pose between fromPose & targetPose for the elapsed part of the step
+void MovementDriver::writeInterpolatedFrame(unsigned long currentTime, unsigned long stepDuration) {
+  long elapsed = (long)(currentTime - stepStartTime);
+  if (elapsed < 0) elapsed = 0;
+  if (elapsed > (long)stepDuration) elapsed = stepDuration;
+
+  int frame[8];
+  interpolatePose(fromPose, targetPose, elapsed, stepDuration, frame);
+  setServoPositions(frame);
+}
+
+// Linear blend of two poses (elapsed = 0 gives from, elapsed >= duration gives to)
+void MovementDriver::interpolatePose(const int from[8], const int to[8], unsigned long elapsed,
+                                     unsigned long duration, int pose[8]) {
+  if (elapsed >= duration) {
+    for (int i = 0; i < 8; i++) pose[i] = to[i];
+    return;
+  }
+
+  for (int i = 0; i < 8; i++) {
+    long delta = (long)(to[i] - from[i]) * (long)elapsed;
+    pose[i] = from[i] + (int)(delta / (long)duration);
+  }
+}
+
+// Hand a command to the motion tick (main loop side of the queue)
+void MovementDriver::postCommand(CommandType type, MovementState state, unsigned long time, uint8_t custom) {
+  uint8_t head = commandHead;
+  uint8_t next = (head + 1) & (COMMAND_QUEUE_SIZE - 1);
+  if (next == __atomic_load_n(&commandTail, __ATOMIC_ACQUIRE)) {
+    droppedCommands++;    // Queue full
+    LOG_WARN(EVT_COMMAND_DROPPED, state == CUSTOM ? CUSTOM_SEQUENCE_BASE + custom : state);
+    return;
+  }
+
+  commandQueue[head].type = type;
+  commandQueue[head].state = state;
+  commandQueue[head].time = time;
+  commandQueue[head].custom = custom;
+  __atomic_store_n(&commandHead, next, __ATOMIC_RELEASE);   // Publish after the data is written
+}
+
+// Apply all queued commands (motion tick side of the queue)
+void MovementDriver::processCommands() {
+  uint8_t tail = commandTail;
+  while (tail != __atomic_load_n(&commandHead, __ATOMIC_ACQUIRE)) {
+    const MotionCommand &cmd = commandQueue[tail];
+    switch (cmd.type) {
+      case COMMAND_START:
+        startMovementSequence(cmd.state, motionClock(), cmd.custom);
+        break;
+      case COMMAND_START_AT:
+        applyStartAt(cmd.state, cmd.time, cmd.custom);
+        break;
+      case COMMAND_IDLE:
+        applyIdle(cmd.time, cmd.state);
+        break;
+      case COMMAND_SHIFT_CLOCK:
+        applyShiftClock((long)cmd.time);
+        break;
+      case COMMAND_TEMPO:
+        applyTempo(cmd.time);
+        break;
+    }
+
+    tail = (tail + 1) & (COMMAND_QUEUE_SIZE - 1);
+    __atomic_store_n(&commandTail, tail, __ATOMIC_RELEASE);
+  }
+}
+
+// Ticker callback
+void MovementDriver::onMotionTick(MovementDriver* driver) {
+  PROFILE_BEGIN(PROFILE_MOTION);
+  driver->updateFrame();
+  PROFILE_END(PROFILE_MOTION);
+}
+
+// Convert an authored step duration to the current speed
+unsigned long MovementDriver::scaledDuration(int milliseconds) const {
+  return (unsigned long)(milliseconds / speedFactor + 0.5);
+}
+
+// Length of the current step in ms (speed factor, or the tempo for a beat-timed step)
+unsigned long MovementDriver::stepLength() const {
+  return beatTimed ? beatStepMs : scaledDuration(activeStep.durationMs);
+}
+
+// Length of the current beat-timed step, from the time of the beat it ends on
+void MovementDriver::timeBeatStep() {
+  beatStepMs = tickTime(stepTick + activeStep.durationMs) - stepStartTime;
+}
+
+// Motion clock time of a beat position of the sequence playing (a pending tempo applies past its beat)
+unsigned long MovementDriver::tickTime(unsigned long tick) const {
+  if (pendingBpm && tick > pendingTick) {
+    return tickTime(pendingTick) + ticksToMs(tick - pendingTick, pendingBpm);
+  }
+  return anchorTime + ticksToMs(tick - anchorTick, tempoBpm);
+}
+
+// Duration of some beat ticks at a tempo, rounded to the nearest ms
+unsigned long MovementDriver::ticksToMs(unsigned long ticks, uint16_t bpm) {
+  return (ticks * (60000UL / BEAT) + bpm / 2) / bpm;
+}
+
+// Add a fraction of one cycle of a sequence to an odometry estimate
+void MovementDriver::integrateOdometry(Odometry &odo, MovementState state, float cycleFraction) const {
+  const GaitCalibration &cal = calibrations[state];
+  if (cal.forwardMm == 0 && cal.lateralMm == 0 && cal.yawDeg == 0) return;
+
+  float forward = cal.forwardMm * cycleFraction;
+  float lateral = cal.lateralMm * cycleFraction;
+  float yaw = cal.yawDeg * cycleFraction;
+
+  // Move along the mid-step heading so turning while walking follows an arc
+  float heading = (odo.headingDeg + yaw * 0.5f) * DEG_TO_RAD;
+  odo.xMm += forward * cos(heading) - lateral * sin(heading);
+  odo.yMm += forward * sin(heading) + lateral * cos(heading);
+  odo.distanceMm += sqrt(forward * forward + lateral * lateral);
+  odo.cycles += cycleFraction;
+
+  // Keep the heading within -180..180 degrees
+  odo.headingDeg += yaw;
+  if (odo.headingDeg > 180.0f) odo.headingDeg -= 360.0f;
+  if (odo.headingDeg <= -180.0f) odo.headingDeg += 360.0f;
+}
+
+// Start a new movement sequence now (through the queue when the Ticker drives the frames)
 void MovementDriver::startMovementSequence(MovementState newState) {
+  if (timedUpdates) {
+    postCommand(COMMAND_START, newState, 0);
+    return;
+  }
+  startMovementSequence(newState, motionClock());
+}
+
+// Start a new movement sequence with its first step starting at startTime
+void MovementDriver::startMovementSequence(MovementState newState, unsigned long startTime, uint8_t custom) {
   // If already moving, queue the next movement
   if (isMoving) {
-    if (newState != currentState) {
+    if (newState != currentState || (newState == CUSTOM && custom != currentCustom)) {
       nextState = newState;
+      nextCustom = custom;
     }
     return;
   }
 
+  // Joints resting in a passive pose take load again from where they are
+  if (detachedMask) {
+    attachDetachedJoints();
+  }
+
   // Save current state and set new state
   lastState = currentState;
   currentState = newState;
-  stepStartTime = millis();
+  poseState = newState;
+  currentCustom = custom;
+  stepStartTime = startTime;
   isMoving = true;
+  LOG_DEBUG(EVT_SEQUENCE_START, getSequenceId(), nextState);
+  TRACE_INSTANT(TRACE_SEQUENCE_START, getSequenceId());
   currentStep = 0;  // Start from first step
 
-  // Get the movement sequence and set initial positions
-  const MovementArray &seq = sequences[currentState];
-  setServoPositions(seq.steps[currentStep]);
+  // Select where the steps come from
+  if (currentState == CUSTOM) {
+    activeSource = customSequences[currentCustom].source;
+  }
+  else {
+    builtInSource.set(sequences[currentState]);
+    activeSource = &builtInSource;
+  }
+  activeSource->rewind();
+
+  // Beat-timed steps count beats from the start, a pending tempo change applies right away
+  beatTimed = activeSource->isBeatTimed();
+  if (pendingBpm) {
+    tempoBpm = pendingBpm;
+    pendingBpm = 0;
+  }
+  anchorTime = startTime;
+  anchorTick = 0;
+  stepTick = 0;
+
+  // Authored length of one cycle, used to split the calibration over the steps
+  cycleDuration = activeSource->getCycleMs();
+  interpolating = interpolate || interpolateNextSequence;
+  interpolateNextSequence = false;
+
+  // Set initial positions
+  if (!loadStep(currentStep)) {
+    readErrors++;
+    LOG_WARN(EVT_STEP_READ_FAILED, getSequenceId(), currentStep);
+    isMoving = false;
+    activeSource->release();
+    return;
+  }
+  int pose[8];
+  unpackPose(activeStep, pose);
+  beginStep(pose, stepLength());
+}
+
+// Start a registered sequence now (through the queue when the Ticker drives the frames)
+void MovementDriver::startCustomSequence(uint8_t custom) {
+  if (timedUpdates) {
+    postCommand(COMMAND_START, CUSTOM, 0, custom);
+    return;
+  }
+  startMovementSequence(CUSTOM, motionClock(), custom);
+}
+
+// Read a step of the current sequence into activeStep (stepStartTime & stepTick already moved to it)
+bool MovementDriver::loadStep(int index) {
+  if (!activeSource->read(index, activeStep)) return false;
+  if (beatTimed) timeBeatStep();
+  return true;
+}
+
+// Whether a step can be read now - in timed mode the Ticker waits for a streaming source to read it in update()
+bool MovementDriver::isStepReady(int index) {
+  return !timedUpdates || index >= activeSource->getSize() || activeSource->isReady(index);
+}
+
+// Servo angles of a step as a position array row
+void MovementDriver::unpackPose(const PackedStep &step, int pose[8]) {
+  for (int i = 0; i < 8; i++) pose[i] = step.angles[i];
+}
+
+// Step source over a built-in position array
+void MovementDriver::ArrayStepSource::set(const MovementArray &array) {
+  if (sequence == &array) return;
+  sequence = &array;
+  cycleMs = 0;
+  for (int i = 0; i < array.size; i++) {
+    cycleMs += array.steps[i][8];
+  }
+}
+
+bool MovementDriver::ArrayStepSource::read(uint16_t index, PackedStep &step) {
+  if (index >= sequence->size) return false;
+  const int* row = sequence->steps[index];
+  for (int i = 0; i < 8; i++) step.angles[i] = row[i];
+  step.durationMs = row[8];
+  return true;
+}
+
+// Step source over a PackedStep array in RAM
+void PackedStepSource::set(const PackedStep* packedSteps, uint16_t count, bool beatTimed) {
+  steps = packedSteps;
+  size = count;
+  beats = beatTimed;
+  cycleMs = 0;
+  for (uint16_t i = 0; i < count; i++) {
+    cycleMs += steps[i].durationMs;
+  }
+}
+
+bool PackedStepSource::read(uint16_t index, PackedStep &step) {
+  if (index >= size) return false;
+  step = steps[index];
+  return true;
 }
 
 // Public movement commands
@@ -403,14 +1010,353 @@ void MovementDriver::sleep()     { startMovementSequence(SLEEP); }
 
 // Go idle for a certain time, then optionally start another movement
 void MovementDriver::idle(unsigned long duration, MovementState queuedState) {
+  if (timedUpdates) {
+    postCommand(COMMAND_IDLE, queuedState, duration);
+    return;
+  }
+  applyIdle(duration, queuedState);
+}
+
+void MovementDriver::applyIdle(unsigned long duration, MovementState queuedState, uint8_t queuedCustom) {
+  // Keep the part of an interrupted step that was already travelled
+  if (isMoving) {
+    odometry = getOdometry();
+    activeSource->release();
+  }
+
   isMoving = false;
   currentState = IDLE;
-  stepStartTime = millis();
+  stepStartTime = motionClock();
   idleDuration = duration;
   nextState = queuedState;
+  nextCustom = queuedCustom;
+}
+
+// Interrupt whatever runs & start a sequence with its first step at startTime
+void MovementDriver::applyStartAt(MovementState state, unsigned long startTime, uint8_t custom) {
+  long wait = (long)(startTime - motionClock());
+  applyIdle(wait > 0 ? wait : 0, state, custom);
+  stepStartTime = startTime - idleDuration;   // IDLE starts the sequence at exactly startTime
 }
 
 // Check if robot is currently moving
 bool MovementDriver::isBusy() {
   return isMoving;
 }
+
+// Set the step duration scale (clamped to 0.25x - 4x)
+void MovementDriver::setSpeedFactor(float factor) {
+  speedFactor = constrain(factor, 0.25f, 4.0f);
+}
+
+// Set the tempo of beat-timed sequences (through the queue when the Ticker drives the frames)
+void MovementDriver::setTempo(uint16_t bpm) {
+  bpm = constrain(bpm, TEMPO_MIN_BPM, TEMPO_MAX_BPM);
+  if (timedUpdates) {
+    postCommand(COMMAND_TEMPO, currentState, bpm);
+    return;
+  }
+  applyTempo(bpm);
+}
+
+void MovementDriver::applyTempo(uint16_t bpm) {
+  // Nothing on the beat right now - the next beat-timed sequence starts at the new tempo
+  if (!isMoving || !beatTimed) {
+    tempoBpm = bpm;
+    pendingBpm = 0;
+    LOG_INFO(EVT_TEMPO_SET, bpm, 0);
+    return;
+  }
+
+  // Wait for the next whole beat (a second change before it only replaces the tempo)
+  if (!pendingBpm) {
+    long elapsed = (long)(motionClock() - anchorTime);
+    unsigned long tick = anchorTick + (elapsed > 0 ? (unsigned long)elapsed * tempoBpm / (60000UL / BEAT) : 0);
+    pendingTick = (tick / BEAT + 1) * BEAT;
+  }
+  pendingBpm = bpm;
+  timeBeatStep();   // The current step may end after that beat
+  LOG_INFO(EVT_TEMPO_SET, bpm, pendingTick / BEAT);
+}
+
+// Current odometry estimate, including the elapsed part of the step in progress
+Odometry MovementDriver::getOdometry() const {
+  Odometry odo = odometry;
+
+  if (isMoving && currentState != IDLE && cycleDuration > 0) {
+    unsigned long stepDuration = stepLength();
+    long elapsed = min((long)(motionClock() - stepStartTime), (long)stepDuration);
+
+    if (stepDuration > 0 && elapsed > 0) {
+      float stepFraction = (float)activeStep.durationMs / cycleDuration;
+      integrateOdometry(odo, currentState, stepFraction * elapsed / stepDuration);
+    }
+  }
+
+  return odo;
+}
+
+// Start a new odometry estimate from the current position
+void MovementDriver::resetOdometry() {
+  odometry.xMm = 0;
+  odometry.yMm = 0;
+  odometry.headingDeg = 0;
+  odometry.distanceMm = 0;
+  odometry.cycles = 0;
+}
+
+// Replace the measured per-cycle displacement of a sequence
+void MovementDriver::setCalibration(MovementState state, const GaitCalibration &calibration) {
+  calibrations[state] = calibration;
+}
+
+// Number of cycles of a sequence needed to travel a distance (0 if the sequence doesn't travel)
+float MovementDriver::cyclesForDistance(MovementState state, float distanceMm) const {
+  const GaitCalibration &cal = calibrations[state];
+  float perCycle = sqrt(cal.forwardMm * cal.forwardMm + cal.lateralMm * cal.lateralMm);
+  if (perCycle <= 0) return 0;
+  return distanceMm / perCycle;
+}
+
+// Set what happens when a step is more than thresholdMs late
+void MovementDriver::setLatePolicy(LatePolicy policy, unsigned long thresholdMs) {
+  latePolicy = policy;
+  lateThresholdMs = thresholdMs;
+}
+
+// True once every joint has been sent a position & no staggered writes are waiting
+bool MovementDriver::isPoseWritten() const {
+  if (pendingMask) return false;
+  for (int i = 0; i < 8; i++) {
+    if (commandedPose[i] < 0) return false;
+  }
+  return true;
+}
+
+// Detach the servos of a passive pose that have held the same angle for idleDetachMs
+void MovementDriver::detachIdleJoints() {
+  if (!(passiveStates & (1UL << poseState))) return;
+
+  unsigned long now = millis();
+  for (int i = 0; i < 8; i++) {
+    uint8_t bit = 1 << i;
+    if ((detachedMask | pendingMask) & bit || commandedPose[i] < 0) continue;
+    if (now - jointChangedAt[i] < idleDetachMs) continue;
+
+    servos[i]->detach();
+    detachedMask |= bit;
+    detachCount++;
+  }
+}
+
+// Attach the detached servos again, the first pulse is the angle they were left at
+void MovementDriver::attachDetachedJoints() {
+  for (int i = 0; i < 8; i++) {
+    if (!(detachedMask & (1 << i))) continue;
+    servos[i]->attach(servoPins[i], SERVO_MIN_US, SERVO_MAX_US, commandedPose[i]);
+    jointChangedAt[i] = millis();
+  }
+  detachedMask = 0;
+}
+
+// Detach the joints of a passive pose after afterMs without a change (0 = never detach)
+void MovementDriver::setIdleDetach(unsigned long afterMs, uint32_t states) {
+  idleDetachMs = afterMs;
+  passiveStates = states;
+  if (afterMs == 0 && detachedMask) {
+    attachDetachedJoints();
+  }
+}
+
+// Set the order the joints of a staggered keyframe are written in (must be a permutation of 0-7)
+void MovementDriver::setWriteOrder(const uint8_t order[8]) {
+  // Every column must appear exactly once, or a joint would never be written
+  uint8_t seen = 0;
+  for (int i = 0; i < 8; i++) {
+    if (order[i] < 8) seen |= 1 << order[i];
+  }
+  if (seen != 0xFF) return;
+
+  for (int i = 0; i < 8; i++) {
+    writeOrder[i] = order[i];
+  }
+}
+
+// Clear the step timing statistics of all sequences
+void MovementDriver::resetStepTiming() {
+  memset(stepTiming, 0, sizeof(stepTiming));
+}
+
+// Readable name of a state for reports
+const char* MovementDriver::getStateName(MovementState state) {
+  static const char* const names[18] = {
+    "standby", "ready", "forward", "backward", "turn_left", "turn_right",
+    "move_left", "move_right", "wave_hello", "dance1", "dance2", "dance3",
+    "lie_down", "fighting", "push_ups", "sleep", "idle", "custom"
+  };
+  return (state >= STANDBY && state <= CUSTOM) ? names[state] : "unknown";
+}
+
+// ID of the current sequence
+uint8_t MovementDriver::getSequenceId() const {
+  if (currentState == CUSTOM) return CUSTOM_SEQUENCE_BASE + currentCustom;
+  return currentState;
+}
+
+// Register a PackedStep array under a name (or replace the steps of one with the same name)
+int MovementDriver::registerSequence(const char* name, const PackedStep* steps, uint16_t size, bool beatTimed) {
+  if (steps == nullptr || size == 0) return -1;
+
+  int index = claimSequence(name);
+  if (index < 0) return -1;
+
+  CustomSequence &entry = customSequences[index];
+  entry.packed.set(steps, size, beatTimed);
+  entry.source = &entry.packed;
+  return CUSTOM_SEQUENCE_BASE + index;
+}
+
+// Register a step source under a name (or replace the source of one with the same name)
+int MovementDriver::registerSequence(const char* name, StepSource* source) {
+  if (source == nullptr || source->getSize() == 0) return -1;
+
+  int index = claimSequence(name);
+  if (index < 0) return -1;
+
+  customSequences[index].source = source;
+  return CUSTOM_SEQUENCE_BASE + index;
+}
+
+// Registry entry for a name - the existing one, or a new one (-1 if the name can't be used)
+int MovementDriver::claimSequence(const char* name) {
+  if (!canRegister(name)) return -1;
+
+  int id = findSequence(name);
+  if (id >= 0) return id - CUSTOM_SEQUENCE_BASE;
+
+  uint8_t index = customCount++;
+  strcpy(customSequences[index].name, name);
+  return index;
+}
+
+// Same checks as claimSequence(), without taking an entry
+bool MovementDriver::canRegister(const char* name) const {
+  if (name == nullptr || name[0] == '\0' || strlen(name) >= sizeof(customSequences[0].name)) return false;
+
+  // Names of built-in sequences are taken
+  int id = findSequence(name);
+  if (id < 0) return customCount < MAX_CUSTOM_SEQUENCES;
+  if (id < CUSTOM_SEQUENCE_BASE) return false;
+
+  // Still playing (or queued) from the old steps
+  uint8_t index = id - CUSTOM_SEQUENCE_BASE;
+  return !((isMoving && currentState == CUSTOM && currentCustom == index) ||
+           (nextState == CUSTOM && nextCustom == index));
+}
+
+// Look up a sequence ID by name
+int MovementDriver::findSequence(const char* name) const {
+  for (int state = STANDBY; state < IDLE; state++) {
+    if (strcmp(name, getStateName((MovementState)state)) == 0) return state;
+  }
+  for (int i = 0; i < customCount; i++) {
+    if (strcmp(name, customSequences[i].name) == 0) return CUSTOM_SEQUENCE_BASE + i;
+  }
+  return -1;
+}
+
+// Name of a built-in or registered sequence
+const char* MovementDriver::getSequenceName(uint8_t id) const {
+  if (id >= CUSTOM_SEQUENCE_BASE) {
+    return (id - CUSTOM_SEQUENCE_BASE < customCount) ? customSequences[id - CUSTOM_SEQUENCE_BASE].name : "unknown";
+  }
+  return getStateName((MovementState)id);
+}
+
+// Number of steps of a built-in or registered sequence
+uint16_t MovementDriver::getSequenceSteps(uint8_t id) const {
+  if (id >= CUSTOM_SEQUENCE_BASE) {
+    return (id - CUSTOM_SEQUENCE_BASE < customCount) ? customSequences[id - CUSTOM_SEQUENCE_BASE].source->getSize() : 0;
+  }
+  return (id < IDLE) ? sequences[id].size : 0;
+}
+
+// Start a built-in or registered sequence by ID
+bool MovementDriver::play(uint8_t id) {
+  if (id < IDLE) {
+    startMovementSequence((MovementState)id);
+    return true;
+  }
+  if (id >= CUSTOM_SEQUENCE_BASE && id - CUSTOM_SEQUENCE_BASE < customCount) {
+    startCustomSequence(id - CUSTOM_SEQUENCE_BASE);
+    return true;
+  }
+  return false;
+}
+
+// Start a built-in or registered sequence by name
+bool MovementDriver::play(const char* name) {
+  int id = findSequence(name);
+  return id >= 0 && play((uint8_t)id);
+}
+
+// Start a built-in or registered sequence by ID at a time on the motion clock
+bool MovementDriver::playAt(uint8_t id, unsigned long startTime) {
+  MovementState state;
+  uint8_t custom = 0;
+  if (id < IDLE) {
+    state = (MovementState)id;
+  }
+  else if (id >= CUSTOM_SEQUENCE_BASE && id - CUSTOM_SEQUENCE_BASE < customCount) {
+    state = CUSTOM;
+    custom = id - CUSTOM_SEQUENCE_BASE;
+  }
+  else {
+    return false;
+  }
+
+  if (timedUpdates) {
+    postCommand(COMMAND_START_AT, state, startTime, custom);
+  }
+  else {
+    applyStartAt(state, startTime, custom);
+  }
+  return true;
+}
+
+// Keep step deadlines on another clock (nullptr = millis())
+void MovementDriver::setClock(MotionClock clock) {
+  if (!clock) clock = millis;
+  long delta = (long)(clock() - motionClock());
+  motionClock = clock;
+  shiftClock(delta);
+}
+
+// Move the timing of the running step / idle wait along with a jump of the motion clock
+void MovementDriver::shiftClock(long deltaMs) {
+  if (timedUpdates) {
+    postCommand(COMMAND_SHIFT_CLOCK, currentState, (unsigned long)deltaMs);
+    return;
+  }
+  applyShiftClock(deltaMs);
+}
+
+void MovementDriver::applyShiftClock(long deltaMs) {
+  stepStartTime += deltaMs;
+  anchorTime += deltaMs;    // Beat-timed deadlines are computed from the anchor
+}
+
+// Compute the servo frames from a Ticker at a fixed rate
+void MovementDriver::beginTimedUpdates(unsigned int rateHz) {
+  if (rateHz == 0) return;
+
+  timedUpdates = true;
+  motionTicker.attach_ms(1000 / rateHz, onMotionTick, this);
+}
+
+// Go back to computing frames from update() in loop()
+void MovementDriver::endTimedUpdates() {
+  motionTicker.detach();
+  timedUpdates = false;
+  processCommands();    // Don't lose commands posted before the switch
+}
@@ -4,6 +4,23 @@
  * This library provides an interface for controlling the robot.
  * It defines movement patterns as arrays of positions,
  * and manages them through a table-driven simple state machine.
+ * It also keeps a dead-reckoning odometry estimate (distance & heading)
+ * from a per-sequence calibration table.
+ * Steps are scheduled against absolute deadlines so late update() calls don't add up,
+ * and the lateness of every step is recorded per sequence.
+ * Optionally the servo frames can be computed from a fixed rate Ticker instead of loop(),
+ * with commands from the main sketch handed over through a small lock-free queue.
+ * Sequences can also be registered at runtime (e.g. loaded from LittleFS by Sequence_Library)
+ * in a packed format, and are played by the same engine as the built-in ones.
+ * The engine reads every sequence through a StepSource, one step at a time, so a source can
+ * also stream a long show from flash in constant memory.
+ * Servos holding a passive pose (lie down, sleep) can be detached after a while to save
+ * holding current, and are attached again at their last angle when the next movement starts.
+ * Step deadlines are kept on a motion clock, millis() unless the sketch sets another one
+ * (e.g. the shared show clock of Show_Sync), and a sequence can be scheduled to start at
+ * a given time on that clock.
+ * Dances are authored in beats (the duration column holds fractions of BEAT) and play at a
+ * tempo set at runtime, a tempo change takes effect on the next beat.
  * 
  * NOTES:
  * - We determined the useable range of the servo motors in the zeroing project,
@@ -27,6 +44,13 @@
 
 // INCLUDES
 #include <Servo.h>
+#include <Ticker.h>
+
+// DEFINES
+#define BEAT                48    // One beat in the duration column of a beat-timed sequence (ticks)
+#define TEMPO_DEFAULT_BPM   150   // The dances were authored at 150 BPM (a beat = 400 ms)
+#define TEMPO_MIN_BPM       30
+#define TEMPO_MAX_BPM       300
 
 // STATE ENUMS
 enum MovementState {
@@ -46,13 +70,85 @@ enum MovementState {
   FIGHTING,     // Fighting pose
   PUSH_UPS,     // Do push-ups
   SLEEP,        // Sleep position
-  IDLE          // Doing nothing (waiting)
+  IDLE,         // Doing nothing (waiting)
+  CUSTOM        // Playing a sequence registered at runtime (see registerSequence())
+};
+
+// What to do when update() is called far past a step deadline
+enum LatePolicy {
+  LATE_CATCH_UP,  // Play every late step, one per update(), until back on time
+  LATE_SKIP,      // Skip steps that should already have finished
+  LATE_RESYNC     // Restart the timing from now (the sequence runs longer)
 };
 
 // STRUCTS
 struct MovementArray {
   const int (*steps)[9];   // pointer to array of steps
   int size;                // number of steps
+  bool beats;              // duration column in beat ticks (BEAT = one beat) instead of ms
+};
+
+// One step of a sequence registered at runtime (10 bytes instead of 36 for a 9 int row)
+struct PackedStep {
+  uint8_t angles[8];      // Servo angles in position array column order
+  uint16_t durationMs;    // Step duration as authored (beat ticks in a beat-timed sequence)
+};
+
+// Where the engine reads the steps of a sequence from (built-in array, RAM or a file)
+class StepSource {
+  public:
+    virtual ~StepSource() {}
+    virtual uint16_t getSize() const = 0;           // Number of steps
+    virtual unsigned long getCycleMs() const = 0;   // Sum of all step durations as authored
+    virtual bool isBeatTimed() const { return false; }   // Durations are beat ticks, not ms
+    virtual void rewind() {}                        // Playback starts again from step 0
+    virtual bool read(uint16_t index, PackedStep &step) = 0;   // Steps are read in order (false = read error)
+    virtual bool isReady(uint16_t index) { return true; }   // Step can be read without touching flash
+    virtual void prefetch() {}                      // Called from update() while a step plays - read ahead
+    virtual void release() {}                       // Playback ended or was interrupted - close files until rewind()
+};
+
+// Steps held in RAM as a PackedStep array
+class PackedStepSource : public StepSource {
+  public:
+    PackedStepSource() : steps(nullptr), size(0), cycleMs(0), beats(false) {}
+    void set(const PackedStep* packedSteps, uint16_t count, bool beatTimed = false);
+    uint16_t getSize() const override { return size; }
+    unsigned long getCycleMs() const override { return cycleMs; }
+    bool isBeatTimed() const override { return beats; }
+    bool read(uint16_t index, PackedStep &step) override;
+
+  private:
+    const PackedStep* steps;
+    uint16_t size;
+    unsigned long cycleMs;
+    bool beats;
+};
+
+// Measured displacement of one full cycle of a sequence (tape measure per gait)
+struct GaitCalibration {
+  float forwardMm;    // distance moved along the current heading (negative = backward)
+  float lateralMm;    // distance moved to the left (negative = right)
+  float yawDeg;       // heading change (positive = counter-clockwise / left)
+};
+
+// Accumulated dead-reckoning position since the last resetOdometry()
+struct Odometry {
+  float xMm;          // position along the starting heading
+  float yMm;          // position to the left of the starting heading
+  float headingDeg;   // heading relative to the starting heading
+  float distanceMm;   // total path length travelled
+  float cycles;       // completed gait cycles (including partial cycles)
+};
+
+// Step timing statistics of one sequence
+struct StepTiming {
+  unsigned long steps;          // Steps advanced
+  unsigned long lateSteps;      // Steps advanced after their deadline
+  unsigned long skippedSteps;   // Steps skipped by LATE_SKIP
+  unsigned long resyncs;        // Timing restarts by LATE_RESYNC
+  unsigned long totalLateMs;    // Sum of all lateness
+  unsigned long maxLateMs;      // Worst lateness
 };
 
 // CLASSES
@@ -68,6 +164,13 @@ class MovementDriver {
     Servo servoD2_LLA;    // lower left arm
     Servo servoD4_LLP;    // lower left paw
 
+    // Servos in position array column order, their pins & the last angle written to each
+    Servo* servos[8];
+    static const uint8_t servoPins[8];
+    static const uint16_t SERVO_MIN_US = 500;     // Pulse width at 0 degrees
+    static const uint16_t SERVO_MAX_US = 2500;    // Pulse width at 180 degrees
+    int commandedPose[8];
+
     // Position arrays (movement sequences)
     static const int standbyArray[1][9];
     static const int readyArray[1][9];
@@ -89,23 +192,186 @@ class MovementDriver {
     // Lookup table for all sequences
     static const MovementArray sequences[17];   // number of sequences (states)
 
+    // Step source over a built-in position array (9 ints per step)
+    class ArrayStepSource : public StepSource {
+      public:
+        ArrayStepSource() : sequence(nullptr), cycleMs(0) {}
+        void set(const MovementArray &array);
+        uint16_t getSize() const override { return sequence->size; }
+        unsigned long getCycleMs() const override { return cycleMs; }
+        bool isBeatTimed() const override { return sequence->beats; }
+        bool read(uint16_t index, PackedStep &step) override;
+
+      private:
+        const MovementArray* sequence;
+        unsigned long cycleMs;
+    };
+
+    // Default per-cycle displacement of each sequence & the active (calibrated) copy
+    static const GaitCalibration defaultCalibrations[18];
+    GaitCalibration calibrations[18];
+
+    // Sequences registered at runtime
+    struct CustomSequence {
+      char name[16];                // Unique name (NUL terminated)
+      StepSource* source;           // Where the steps come from (owned by the caller)
+      PackedStepSource packed;      // Source used for a registered PackedStep array
+    };
+    CustomSequence customSequences[16];    // MAX_CUSTOM_SEQUENCES
+    uint8_t customCount;            // Registered sequences
+    uint8_t currentCustom;          // Registered sequence playing (while currentState == CUSTOM)
+    uint8_t nextCustom;             // Registered sequence queued (while nextState == CUSTOM)
+
     // Movement state management
     MovementState lastState;        // Previous state
     MovementState currentState;     // Current state
     MovementState nextState;        // Next state to run
     int currentStep;                // Current step in sequence
+    StepSource* activeSource;       // Steps of the current sequence
+    ArrayStepSource builtInSource;  // Source over the built-in array being played
+    PackedStep activeStep;          // Current step, as read from the source
+    unsigned long readErrors;       // Sequences cut short because a step couldn't be read
+    unsigned long completed[CUSTOM + 1];  // Sequences played to the last step, per state
     unsigned long stepStartTime;    // When current step started
     bool isMoving;                  // True if currently moving
     unsigned long idleDuration;     // How long to stay idle
+    float speedFactor;              // Step duration scale (2.0 = twice as fast)
+
+    // Tempo of beat-timed sequences - step deadlines are computed from the anchor (the
+    // sequence start or the last tempo change), not added up step by step
+    bool beatTimed;                 // The sequence playing has its durations in beat ticks
+    uint16_t tempoBpm;              // Tempo it plays at
+    uint16_t pendingBpm;            // Tempo waiting for the next beat (0 = none)
+    unsigned long pendingTick;      // That beat (ticks since the sequence started)
+    unsigned long anchorTick;       // Beat position of the anchor
+    unsigned long anchorTime;       // Its time (motion clock)
+    unsigned long stepTick;         // Beat position of the current step's start
+    unsigned long beatStepMs;       // Length of the current step (set when the step or tempo changes)
+
+    // Step scheduling
+    LatePolicy latePolicy;          // What to do when far behind
+    unsigned long lateThresholdMs;  // Lateness that counts as "far behind"
+    StepTiming stepTiming[18];      // Lateness statistics per sequence (CUSTOM = all registered)
+
+    // Frame computation
+    bool interpolate;               // Move smoothly towards each step's pose
+    bool interpolateNextSequence;   // Interpolate the next sequence that starts (once)
+    bool interpolating;             // The sequence playing is interpolated
+    int fromPose[8];                // Pose at the start of the current step
+    int targetPose[8];              // Pose at the end of the current step
+
+    // Staggered keyframe writes
+    unsigned int staggerMs;         // Delay between servo starts (0 = all at once)
+    uint8_t writeOrder[8];          // Position array columns, first = written first
+    uint8_t pendingMask;            // Joints with a write still waiting (bit = column)
+    int pendingPose[8];             // Angle each waiting joint will be written to
+    unsigned long pendingDue[8];    // millis() when each waiting joint is written
+
+    // Idle detach
+    unsigned long idleDetachMs;     // Unchanged time before a joint of a passive pose is detached (0 = never)
+    uint32_t passiveStates;         // States whose final pose holds no load (bit = MovementState)
+    MovementState poseState;        // Sequence that left the current pose (stays set while IDLE)
+    unsigned long jointChangedAt[8];  // millis() when each joint was last written to a new angle
+    uint8_t detachedMask;           // Joints not driven right now (bit = column)
+    unsigned long detachCount;      // Joints detached so far
+
+    // Fixed rate motion tick (Ticker) & the command queue feeding it
+    enum CommandType : uint8_t {
+      COMMAND_START,                // Start a sequence now
+      COMMAND_START_AT,             // Start a sequence at time (motion clock)
+      COMMAND_IDLE,                 // idle()
+      COMMAND_SHIFT_CLOCK,          // The motion clock jumped by time ms (signed)
+      COMMAND_TEMPO                 // setTempo(), time = BPM
+    };
+    struct MotionCommand {
+      CommandType type;
+      MovementState state;          // Sequence to start / queued after idle
+      uint8_t custom;               // Registered sequence to start (state == CUSTOM)
+      unsigned long time;           // Idle duration, start time, clock shift or tempo
+    };
+    static const uint8_t COMMAND_QUEUE_SIZE = 4;    // Must be a power of 2
+    MotionCommand commandQueue[COMMAND_QUEUE_SIZE];
+    volatile uint8_t commandHead;   // Next slot to write (main loop only)
+    volatile uint8_t commandTail;   // Next slot to read (motion tick only)
+    unsigned long droppedCommands;  // Commands lost because the queue was full
+    Ticker motionTicker;
+    bool timedUpdates;              // True while the Ticker drives the frames
+
+    // Motion clock (step deadlines, idle & odometry timing)
+    unsigned long (*motionClock)(); // millis() or the sketch's clock
+
+    // Odometry
+    Odometry odometry;              // Integrated position of all completed steps
+    unsigned long cycleDuration;    // Total duration of one cycle of the current sequence
 
     // Helper methods
+    void updateFrame();
     void setServoPositions(const int positions[]);
+    void writeJoint(int joint, int angle, unsigned long now);
+    void detachIdleJoints();
+    void attachDetachedJoints();
+    void writeKeyframe(const int positions[], unsigned long windowMs);
+    void servicePendingWrites();
+    void beginStep(const int positions[], unsigned long duration);
+    void writeInterpolatedFrame(unsigned long currentTime, unsigned long stepDuration);
+    void postCommand(CommandType type, MovementState state, unsigned long time, uint8_t custom = 0);
+    void processCommands();
+    void applyIdle(unsigned long duration, MovementState queuedState, uint8_t queuedCustom = 0);
+    void applyStartAt(MovementState state, unsigned long startTime, uint8_t custom);
+    void applyShiftClock(long deltaMs);
+    void applyTempo(uint16_t bpm);
+    static void onMotionTick(MovementDriver* driver);
     void startMovementSequence(MovementState newState);
+    void startMovementSequence(MovementState newState, unsigned long startTime, uint8_t custom = 0);
+    void startCustomSequence(uint8_t custom);
+    bool loadStep(int index);
+    bool isStepReady(int index);
+    int claimSequence(const char* name);
+    static void unpackPose(const PackedStep &step, int pose[8]);
+    unsigned long scaledDuration(int milliseconds) const;
+    unsigned long stepLength() const;
+    unsigned long tickTime(unsigned long tick) const;
+    void timeBeatStep();
+    void integrateOdometry(Odometry &odo, MovementState state, float cycleFraction) const;
 
   public:
     MovementDriver();
     void begin();  // Initialize servos
-    void update();
+    void begin(const int startPose[8]);   // Initialize servos that are known to be at startPose (no jump)
+    void update();   // Call in loop() (only reads ahead for a streamed sequence while timed updates are running)
+
+    // Fixed rate motion tick - frames keep their timing even if loop() stalls
+    void beginTimedUpdates(unsigned int rateHz = 50);
+    void endTimedUpdates();
+    bool isTimed() const { return timedUpdates; }
+    unsigned long getDroppedCommands() const { return droppedCommands; }
+
+    // Interpolate between step poses on every frame instead of jumping at step start
+    void setInterpolation(bool enabled) { interpolate = enabled; }
+    void interpolateNext() { interpolateNextSequence = true; }   // Only the next sequence (e.g. a gentle resume)
+    bool isInterpolating() const { return isMoving && interpolating; }   // An interpolated sequence is moving
+    static void interpolatePose(const int from[8], const int to[8], unsigned long elapsed,
+                                unsigned long duration, int pose[8]);
+
+    // Write a pose straight to the servos (only the joints that change), bypassing the sequences.
+    // The pose no longer belongs to a sequence, so its joints are never idle-detached
+    void writePose(const int positions[8]) { poseState = IDLE; setServoPositions(positions); }
+    void getCommandedPose(int positions[8]) const;   // Last angle written to each joint (-1 = none yet)
+
+    // Staggered keyframe writes - start the servos of a new step one after another (offsetMs apart,
+    // in writeOrder) instead of all at once, to flatten the current peak. The step timing is unchanged
+    void setWriteStagger(unsigned int offsetMs) { staggerMs = offsetMs; }
+    unsigned int getWriteStagger() const { return staggerMs; }
+    bool isPoseWritten() const;     // Every joint has a position & no staggered write is waiting
+    void setWriteOrder(const uint8_t order[8]);
+
+    // Idle detach - in a passive pose, joints whose angle hasn't changed for afterMs are detached
+    // (no pulses, no holding current). The next movement attaches them again with the last angle
+    // preloaded, so they don't jump. passiveStates is a MovementState bit mask
+    void setIdleDetach(unsigned long afterMs, uint32_t states = (1UL << LIE_DOWN) | (1UL << SLEEP));
+    unsigned long getIdleDetach() const { return idleDetachMs; }
+    uint8_t getDetachedJoints() const { return detachedMask; }   // Bit = position array column
+    unsigned long getDetachCount() const { return detachCount; }
 
     // Movement commands
     void standby();
@@ -126,9 +392,65 @@ class MovementDriver {
     void sleep();
     void idle(unsigned long duration, MovementState queuedState = IDLE);
 
+    // Sequences registered at runtime - IDs 0-15 are the built-in sequences (same values as
+    // MovementState), registered sequences get IDs from CUSTOM_SEQUENCE_BASE up.
+    // The steps / source are not copied and must stay valid while the sequence is registered
+    static const uint8_t CUSTOM_SEQUENCE_BASE = 32;
+    static const uint8_t MAX_CUSTOM_SEQUENCES = 16;
+    int registerSequence(const char* name, const PackedStep* steps, uint16_t size,
+                         bool beatTimed = false);   // ID or -1
+    int registerSequence(const char* name, StepSource* source);   // e.g. a streaming file source
+    uint8_t getCustomSequenceCount() const { return customCount; }
+    int findSequence(const char* name) const;      // ID of a built-in or registered sequence or -1
+    bool canRegister(const char* name) const;      // A register*() call with this name would succeed now
+    const char* getSequenceName(uint8_t id) const;
+    uint16_t getSequenceSteps(uint8_t id) const;   // 0 for an unknown ID
+    unsigned long getReadErrors() const { return readErrors; }
+    unsigned long getCompleted(MovementState state) const { return completed[state]; }   // Played to the end (not interrupted)
+    bool play(uint8_t id);                         // Start any sequence by ID (false if unknown)
+    bool play(const char* name);
+    bool playAt(uint8_t id, unsigned long startTime);   // First step at startTime (motion clock), interrupts
+
+    // Motion clock - step deadlines are kept on clock() instead of millis(), e.g. a clock shared
+    // by several robots. Switching clocks keeps the running step where it is, shiftClock() does
+    // the same when the clock itself jumps (small corrections should not be shifted, they are
+    // what moves the steps onto the shared time)
+    typedef unsigned long (*MotionClock)();
+    void setClock(MotionClock clock);              // nullptr = millis()
+    void shiftClock(long deltaMs);                 // The clock just jumped by deltaMs
+    unsigned long getClockTime() const { return motionClock(); }
+
+    // Speed control (scales every step duration, 1.0 = as authored)
+    void setSpeedFactor(float factor);
+    float getSpeedFactor() const { return speedFactor; }
+
+    // Tempo - beat-timed sequences (the dances & beat .qds files) play at bpm instead of the
+    // speed factor. While one plays a new tempo waits for its next beat (counted from the
+    // start of the sequence), so the dance stays on the beat of the music
+    void setTempo(uint16_t bpm);                   // Clamped to TEMPO_MIN_BPM - TEMPO_MAX_BPM
+    uint16_t getTempo() const { return tempoBpm; }
+    bool isTempoPending() const { return pendingBpm != 0; }
+    static unsigned long ticksToMs(unsigned long ticks, uint16_t bpm);
+
+    // Step scheduling - policy for steps that are more than thresholdMs late
+    void setLatePolicy(LatePolicy policy, unsigned long thresholdMs);
+    const StepTiming &getStepTiming(MovementState state) const { return stepTiming[state]; }
+    void resetStepTiming();
+
+    // Odometry - dead reckoning from the per-cycle gait calibration
+    Odometry getOdometry() const;    // Includes the partially completed current step
+    void resetOdometry();
+    void setCalibration(MovementState state, const GaitCalibration &calibration);
+    const GaitCalibration &getCalibration(MovementState state) const { return calibrations[state]; }
+    float cyclesForDistance(MovementState state, float distanceMm) const;
+
     // State information
     MovementState getState() const { return currentState; }
     MovementState getLastState() const { return lastState; }
+    int getCurrentStep() const { return currentStep; }   // Step of the sequence playing (0 = first)
+    unsigned long getStepStartTime() const { return stepStartTime; }   // Its deadline (motion clock)
+    uint8_t getSequenceId() const;    // ID of the current sequence (the state, or the registered ID)
+    static const char* getStateName(MovementState state);
 
     // Check if robot is currently moving
     bool isBusy();
@@ -0,0 +1,227 @@
+/*
+ * Pose_Stream.cpp - Implementation of the PoseStream library
+ * 
+ * IMPLEMENTATION:
+ * - receive(): Checks the frame, starts a stream on the first one, feeds the delay estimate
+ *   & queues the frame unless it is late, a duplicate or the buffer is full
+ * - updateDelay(): Max of the window (offset), its spread (jitter), then the delay target
+ * - update(): Ends a stream that went quiet, moves to the sender time to play, then writes
+ *   the interpolated (or extrapolated) pose
+ * - advance(): Drops the frames whose time has passed, counting the sequence gaps
+ * - blend(): Per joint straight line through two frames, past the second one when extrapolating
+ */
+
+
+// INCLUDES
+#include "Pose_Stream.h"
+#include "Event_Log.h"
+
+// HELPER METHODS
+void PoseStream::start(unsigned long arrivalMs) {
+  active = true;
+  head = 0;
+  count = 0;
+  hasPrevious = false;
+  playing = false;
+  underrun = false;
+  windowCount = 0;
+  windowNext = 0;
+  offset = 0;
+  jitterMs = 0;
+  intervalMs = STREAM_DEFAULT_INTERVAL_MS;
+  delayMs = STREAM_START_DELAY_MS;
+  lastWriteMs = arrivalMs;
+  stats.streams++;
+
+  // The stream takes over from whatever was playing
+  LOG_INFO(EVT_STREAM_START, lastSequence, robot->getState());
+  robot->idle(0);
+}
+
+void PoseStream::updateDelay(long sample) {
+  window[windowNext] = sample;
+  windowNext = (windowNext + 1) % STREAM_WINDOW;
+  if (windowCount < STREAM_WINDOW) windowCount++;
+
+  // The frame with the least delay has the largest sample, the one with the most the smallest
+  long best = window[0];
+  long worst = window[0];
+  for (uint8_t i = 1; i < windowCount; i++) {
+    if (window[i] > best) best = window[i];
+    if (window[i] < worst) worst = window[i];
+  }
+  offset = best;
+  jitterMs = best - worst;
+
+  // Grow at once, shrink slowly
+  unsigned long target = constrain(intervalMs + jitterMs + STREAM_MARGIN_MS,
+                                   (unsigned long)STREAM_MIN_DELAY_MS, (unsigned long)STREAM_MAX_DELAY_MS);
+  if (target > delayMs) {
+    delayMs = target;
+  }
+  else if (delayMs > target) {
+    delayMs -= min(delayMs - target, (unsigned long)STREAM_SHRINK_MS);
+  }
+}
+
+void PoseStream::advance(unsigned long time, unsigned long now) {
+  while (count > 1 && (long)(at(1).time - time) <= 0) {
+    uint16_t gap = at(1).sequence - at(0).sequence;
+    stats.concealed += gap - 1;
+    previous = at(0);
+    hasPrevious = true;
+    head = (head + 1) % STREAM_BUFFER;
+    count--;
+    underrun = false;
+    played(at(0), now);
+  }
+}
+
+void PoseStream::played(const Frame &frame, unsigned long now) {
+  unsigned long heldMs = now - frame.arrivalMs;
+  stats.played++;
+  stats.totalHoldMs += heldMs;
+  if (heldMs > stats.maxHoldMs) stats.maxHoldMs = heldMs;
+  if (playedCallback) playedCallback(frame.sequence, heldMs);
+}
+
+void PoseStream::blend(const Frame &from, const Frame &to, long elapsed, int pose[8]) {
+  long span = (long)(to.time - from.time);
+  for (int i = 0; i < 8; i++) {
+    if (span <= 0) {
+      pose[i] = to.angles[i];
+      continue;
+    }
+    long delta = ((long)to.angles[i] - from.angles[i]) * elapsed;
+    pose[i] = constrain(from.angles[i] + delta / span, 0L, 180L);
+  }
+}
+
+// PUBLIC METHODS
+PoseStream::PoseStream() {
+  robot = nullptr;
+  playedCallback = nullptr;
+  active = false;
+  head = 0;
+  count = 0;
+  hasPrevious = false;
+  playing = false;
+  underrun = false;
+  lastSequence = 0;
+  lastTime = 0;
+  windowCount = 0;
+  windowNext = 0;
+  offset = 0;
+  jitterMs = 0;
+  intervalMs = STREAM_DEFAULT_INTERVAL_MS;
+  delayMs = STREAM_START_DELAY_MS;
+  playoutTime = 0;
+  lastArrivalMs = 0;
+  lastWriteMs = 0;
+  memset(&stats, 0, sizeof(stats));
+}
+
+void PoseStream::begin(MovementDriver &driver) {
+  robot = &driver;
+}
+
+bool PoseStream::receive(const uint8_t* payload, uint8_t size, unsigned long arrivalMs) {
+  if (!robot || size < STREAM_FRAME_SIZE) return false;
+
+  uint16_t sequence = payload[0] | payload[1] << 8;
+  unsigned long time = (uint32_t)payload[2] | (uint32_t)payload[3] << 8 |
+                       (uint32_t)payload[4] << 16 | (uint32_t)payload[5] << 24;
+  if (active && (int16_t)(sequence - lastSequence) < -STREAM_WINDOW) {
+    stop(STREAM_STOP_RESTART);
+  }
+  if (!active) {
+    lastSequence = sequence;
+    start(arrivalMs);
+  }
+  else if ((int16_t)(sequence - lastSequence) <= 0) {
+    stats.duplicates++;
+    return false;
+  }
+  else {
+    // Frame interval of the sender (a gap spreads the time over the missing frames)
+    unsigned long interval = (time - lastTime) / (uint16_t)(sequence - lastSequence);
+    intervalMs = (intervalMs * 7 + min(interval, (unsigned long)STREAM_MAX_DELAY_MS) + 4) / 8;
+  }
+  stats.frames++;
+  lastSequence = sequence;
+  lastTime = time;
+  lastArrivalMs = arrivalMs;
+  updateDelay((long)(time - arrivalMs));
+
+  // Too late to be played, or no room (the sender is far ahead of its clock)
+  if (playing && (long)(time - playoutTime) <= 0) {
+    stats.late++;
+    return false;
+  }
+  if (count == STREAM_BUFFER) {
+    stats.overflows++;
+    return false;
+  }
+
+  Frame &frame = at(count);
+  frame.sequence = sequence;
+  frame.time = time;
+  frame.arrivalMs = arrivalMs;
+  memcpy(frame.angles, payload + 6, sizeof(frame.angles));
+  count++;
+  return true;
+}
+
+void PoseStream::update() {
+  if (!active) return;
+
+  unsigned long now = millis();
+  if (now - lastArrivalMs > STREAM_TIMEOUT_MS) {
+    stop(STREAM_STOP_TIMEOUT);
+    return;
+  }
+  if (now == lastWriteMs) return;   // Once per ms is plenty
+
+  // Sender time to play now - it never goes back, a larger delay holds it instead
+  unsigned long time = now + offset - delayMs;
+  if (playing && (long)(time - playoutTime) < 0) {
+    time = playoutTime;
+  }
+  if (!playing) {
+    if ((long)(time - at(0).time) < 0) return;   // Still filling the buffer
+    playing = true;
+    played(at(0), now);
+  }
+  advance(time, now);
+
+  int pose[8];
+  if (count > 1) {
+    blend(at(0), at(1), (long)(time - at(0).time), pose);
+  }
+  else {
+    // Past the newest frame - carry on along the last two for a while, then hold
+    long ahead = (long)(time - at(0).time);
+    if (ahead > 0) {
+      if (!underrun) stats.underruns++;
+      underrun = true;
+      stats.extrapolatedMs += now - lastWriteMs;
+    }
+    if (hasPrevious && ahead > 0) {
+      long elapsed = (long)(at(0).time - previous.time) + min(ahead, (long)STREAM_MAX_EXTRAPOLATE_MS);
+      blend(previous, at(0), elapsed, pose);
+    }
+    else {
+      for (int i = 0; i < 8; i++) pose[i] = at(0).angles[i];
+    }
+  }
+  robot->writePose(pose);
+  playoutTime = time;
+  lastWriteMs = now;
+}
+
+void PoseStream::stop(StreamStop reason) {
+  if (!active) return;
+
+  active = false;
+  LOG_INFO(EVT_STREAM_STOP, reason, (uint16_t)stats.played, min(delayMs, 0xFFFFUL));
+}
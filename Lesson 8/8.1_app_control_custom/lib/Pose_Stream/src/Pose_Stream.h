@@ -0,0 +1,156 @@
+/*
+ * Pose_Stream.h - Custom library for playing out a live stream of poses from a host
+ * 
+ * For puppeteering (motion capture, a slider UI) the host sends raw 8-joint poses at about
+ * 50 Hz over the app connection instead of starting sequences. Wi-Fi delivers them unevenly:
+ * a retransmission or a busy loop() holds a few back & then they arrive all at once. Writing
+ * each pose as it comes in would make the robot stutter, so the poses are held in a small
+ * jitter buffer & played out on the sender's timeline, a fixed delay after they were sent.
+ * 
+ * IMPLEMENTATION:
+ * - Every frame carries a sequence number & the sender's clock (ms). sender time - arrival
+ *   time is the clock offset plus the network delay of that frame, the largest value of the
+ *   last STREAM_WINDOW frames is the frame with the least delay & the offset estimate
+ *   (the same estimate as Show_Sync). offset - sample is how late each frame came in
+ * - The playout delay is the sender's frame interval + the latest arrival in the window +
+ *   STREAM_MARGIN_MS, clamped to STREAM_MIN_DELAY_MS - STREAM_MAX_DELAY_MS. It grows at once
+ *   when frames come in later, and shrinks by STREAM_SHRINK_MS per frame when the network
+ *   calms down. The playout never goes back in time, a larger delay pauses it instead
+ * - update() plays the sender time now + offset - delay: the pose between the two buffered
+ *   frames around it, interpolated per joint. A gap in the sequence numbers (a frame the
+ *   host dropped) is interpolated over the same way
+ * - When the newest frame has been played & the next isn't there yet (underrun), the last
+ *   two frames are extrapolated for up to STREAM_MAX_EXTRAPOLATE_MS, then the pose is held.
+ *   After STREAM_TIMEOUT_MS without a frame the stream ends (the robot keeps the last pose)
+ * - Frames whose time has already been played are late & dropped, so is a frame that isn't
+ *   newer than the last one received (duplicate). A sequence number more than STREAM_WINDOW
+ *   behind is a sender that started over, it starts a new stream
+ * - The onPlayed() callback gets each frame as its time is reached, with how long it was
+ *   held in the buffer (the sketch echoes it to the host, tools/pose_stream.py measures
+ *   the end-to-end latency from the round trip)
+ * 
+ * FRAME FORMAT (payload of a WIFI_STREAM_ACTION frame, 14 bytes, little endian):
+ *   sequence:2  sender clock:4 (ms)  angles:8 (position array column order, 0-180)
+ * 
+ * NOTES:
+ * - The first frame of a stream interrupts the sequence playing (robot.idle()), the poses
+ *   are written with MovementDriver::writePose(). Any motion command ends the stream (the
+ *   sketch calls stop())
+ * - The latency is bounded: a frame is played STREAM_MAX_DELAY_MS after it would have
+ *   arrived on the fastest path at the latest, anything later is dropped
+ * - update() is called from the motion task, the poses are written from loop() even with
+ *   MOTION_TICK_HZ (the Ticker has nothing to write while the robot is idle)
+ */
+
+
+#ifndef POSE_STREAM_H
+#define POSE_STREAM_H
+
+// INCLUDES
+#include <Arduino.h>
+#include "Movement_Driver.h"
+
+// DEFINES
+#define STREAM_FRAME_SIZE           14      // Payload bytes of a frame
+#define STREAM_BUFFER               16      // Frames held (320 ms at 50 Hz)
+#define STREAM_WINDOW               32      // Frames in the offset & jitter estimate
+#define STREAM_DEFAULT_INTERVAL_MS  20      // Frame interval until one is measured (50 Hz)
+#define STREAM_MARGIN_MS            10      // Delay on top of the frame interval & the jitter
+#define STREAM_START_DELAY_MS       60      // Until the jitter of the first frames is known
+#define STREAM_MIN_DELAY_MS         20
+#define STREAM_MAX_DELAY_MS         200
+#define STREAM_SHRINK_MS            1       // Delay reduction per frame when the network calms down
+#define STREAM_MAX_EXTRAPOLATE_MS   100     // Then the pose is held
+#define STREAM_TIMEOUT_MS           1000    // No frame for this long ends the stream
+
+// ENUMS
+enum StreamStop : uint8_t {
+  STREAM_STOP_TIMEOUT = 1,    // No frame for STREAM_TIMEOUT_MS
+  STREAM_STOP_COMMAND,        // stop(), another motion command
+  STREAM_STOP_RESTART         // The sender started over (the sequence number went back)
+};
+
+// STRUCTS
+// Statistics since boot (the delay & jitter are for the current / last stream)
+struct StreamStats {
+  unsigned long streams;        // Streams started
+  unsigned long frames;         // Frames received
+  unsigned long played;         // Frames whose time was played
+  unsigned long late;           // Dropped, their time had already been played
+  unsigned long duplicates;     // Dropped, not newer than the last frame
+  unsigned long overflows;      // Dropped, the buffer was full
+  unsigned long concealed;      // Missing frames (sequence gaps) interpolated over
+  unsigned long underruns;      // Played past the newest frame (extrapolated)
+  unsigned long extrapolatedMs; // Time spent extrapolating or holding
+  unsigned long totalHoldMs;    // Arrival to playout, sum over the played frames
+  unsigned long maxHoldMs;
+};
+
+// CLASSES
+class PoseStream {
+  public:
+    typedef void (*PlayedCallback)(uint16_t sequence, unsigned long heldMs);
+
+    PoseStream();
+
+    void begin(MovementDriver &robot);
+    void onPlayed(PlayedCallback callback) { playedCallback = callback; }
+    bool receive(const uint8_t* payload, uint8_t size, unsigned long arrivalMs);   // false = dropped
+    void update();                    // Call on every pass through loop() (motion task)
+    void stop(StreamStop reason = STREAM_STOP_COMMAND);
+
+    // State & statistics
+    bool isActive() const { return active; }
+    unsigned long getDelay() const { return delayMs; }      // Playout delay now
+    unsigned long getJitter() const { return jitterMs; }    // Latest arrival in the window
+    unsigned long getInterval() const { return intervalMs; }   // Sender's frame interval
+    uint8_t getBuffered() const { return count; }
+    const StreamStats &getStats() const { return stats; }
+
+  private:
+    struct Frame {
+      uint16_t sequence;
+      unsigned long time;           // Sender clock
+      unsigned long arrivalMs;
+      uint8_t angles[8];
+    };
+
+    MovementDriver* robot;
+    PlayedCallback playedCallback;
+    bool active;
+
+    // Jitter buffer, oldest first - frames[head] is the newest one played (or the first)
+    Frame frames[STREAM_BUFFER];
+    uint8_t head;
+    uint8_t count;
+    Frame previous;                 // Played before frames[head], for the extrapolation
+    bool hasPrevious;
+    bool playing;                   // The first frame's time was reached
+    bool underrun;                  // Played past the newest frame
+    uint16_t lastSequence;          // Newest frame received
+    unsigned long lastTime;         // Its sender time
+
+    // Clock offset & playout delay
+    long window[STREAM_WINDOW];     // Sender time - arrival time of the last frames
+    uint8_t windowCount;
+    uint8_t windowNext;
+    long offset;                    // Sender clock - millis()
+    unsigned long jitterMs;
+    unsigned long intervalMs;
+    unsigned long delayMs;
+    unsigned long playoutTime;      // Sender time played last
+    unsigned long lastArrivalMs;
+    unsigned long lastWriteMs;
+
+    StreamStats stats;
+
+    // Helper methods
+    void start(unsigned long arrivalMs);
+    void updateDelay(long sample);
+    Frame &at(uint8_t index) { return frames[(head + index) % STREAM_BUFFER]; }
+    void advance(unsigned long time, unsigned long now);
+    void played(const Frame &frame, unsigned long now);
+    static void blend(const Frame &from, const Frame &to, long elapsed, int pose[8]);
+};
+
+#endif
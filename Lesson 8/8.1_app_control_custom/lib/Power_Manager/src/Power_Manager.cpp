@@ -0,0 +1,247 @@
+/*
+ * Power_Manager.cpp - Implementation of the PowerManager library
+ * 
+ * IMPLEMENTATION:
+ * - begin(): Keeps the robot reference & applies POWER_ACTIVE (the level the robot boots in)
+ * - update(): Picks the level for the current motion state, activity & stations, switches if needed
+ * - notifyActivity(): Records the command time & switches to POWER_ACTIVE at once (timed)
+ * - switchTo(): Books the time of the old level, applies the new profile & logs the switch
+ * - applyProfile(): Changes only the CPU clock, sleep type & TX power that differ
+ * - park() / enterDeepSleep(): Lie down, then save the posture to RTC memory & deep sleep
+ * - restorePosture(): Reads, checks & invalidates the saved posture after a wake-up
+ * - report(): Prints the profiles, the time per level & the wake latency
+ */
+
+
+// INCLUDES
+#include "Power_Manager.h"
+#include "Event_Log.h"
+#include <user_interface.h>
+
+// CLASS IMPLEMENTATION
+PowerManager::PowerManager() {
+  // Default profiles - currents are rough ESP-12E module figures (see setLevelCurrent())
+  profiles[POWER_ACTIVE] = {160, WIFI_NONE_SLEEP, 20.5f, 80.0f};
+  profiles[POWER_IDLE]   = {80, WIFI_MODEM_SLEEP, 20.5f, 70.0f};
+  profiles[POWER_LOW]    = {80, WIFI_MODEM_SLEEP, 10.0f, 65.0f};
+
+  robot = nullptr;
+  level = POWER_ACTIVE;
+  enabled = true;
+  applied = false;
+  parkRequested = false;
+  resumed = false;
+  activeHoldMs = 5000;
+  lowAfterMs = 30000;
+  lastActivityMs = 0;
+  lastStationMs = 0;
+  levelSinceMs = 0;
+  for (int i = 0; i < POWER_LEVELS; i++) {
+    residencyMs[i] = 0;
+  }
+  switches = 0;
+  lastWakeUs = 0;
+  maxWakeUs = 0;
+}
+
+void PowerManager::begin(MovementDriver &driver) {
+  robot = &driver;
+  unsigned long now = millis();
+  lastActivityMs = now;
+  lastStationMs = now;
+  levelSinceMs = now;
+  level = POWER_ACTIVE;
+  applyProfile(profiles[POWER_ACTIVE], profiles[POWER_ACTIVE], true);
+  applied = true;
+}
+
+void PowerManager::setTimeouts(unsigned long holdMs, unsigned long noStationMs) {
+  activeHoldMs = holdMs;
+  lowAfterMs = noStationMs;
+}
+
+void PowerManager::setEnabled(bool enable) {
+  enabled = enable;
+  if (!enabled && applied && level != POWER_ACTIVE) {
+    switchTo(POWER_ACTIVE, millis());
+  }
+}
+
+void PowerManager::update() {
+  if (!robot) return;
+
+  // Parking - sleep once the lie down has finished & every joint is written
+  if (parkRequested && robot->getState() == LIE_DOWN && !robot->isBusy() && robot->isPoseWritten()) {
+    enterDeepSleep();
+    return;
+  }
+  if (!enabled) return;
+
+  unsigned long now = millis();
+  if (WiFi.softAPgetStationNum() > 0 || WiFi.isConnected()) {
+    lastStationMs = now;
+  }
+
+  PowerLevel newLevel = chooseLevel(now);
+  if (newLevel != level) {
+    switchTo(newLevel, now);
+  }
+}
+
+void PowerManager::notifyActivity() {
+  unsigned long now = millis();
+  lastActivityMs = now;
+  parkRequested = false;
+  if (!applied || !enabled || level == POWER_ACTIVE) return;
+
+  // Time the way back to full power - this is what a command waits for
+  uint32_t start = micros();
+  switchTo(POWER_ACTIVE, now);
+  lastWakeUs = micros() - start;
+  if (lastWakeUs > maxWakeUs) maxWakeUs = lastWakeUs;
+}
+
+// Level for the current motion state, command activity & stations
+PowerLevel PowerManager::chooseLevel(unsigned long now) const {
+  if (robot->isBusy() || now - lastActivityMs < activeHoldMs) {
+    return POWER_ACTIVE;
+  }
+  if (now - lastStationMs < lowAfterMs) {
+    return POWER_IDLE;
+  }
+  return POWER_LOW;
+}
+
+void PowerManager::switchTo(PowerLevel newLevel, unsigned long now) {
+  residencyMs[level] += now - levelSinceMs;
+  levelSinceMs = now;
+
+  PowerLevel oldLevel = level;
+  level = newLevel;
+  switches++;
+  applyProfile(profiles[oldLevel], profiles[newLevel], false);
+  LOG_INFO(EVT_POWER_LEVEL, newLevel, oldLevel);
+}
+
+// Set the parts of a profile that differ from the previous one (all of them with force)
+void PowerManager::applyProfile(const PowerProfile &from, const PowerProfile &to, bool force) {
+  if (force || to.cpuMHz != from.cpuMHz) {
+    system_update_cpu_freq(to.cpuMHz);
+  }
+  if (force || to.sleepType != from.sleepType) {
+    WiFi.setSleepMode(to.sleepType);
+  }
+  if (force || to.txPowerDbm != from.txPowerDbm) {
+    WiFi.setOutputPower(to.txPowerDbm);
+  }
+}
+
+void PowerManager::park() {
+  if (!robot) return;
+  parkRequested = true;
+  if (robot->getState() != LIE_DOWN) {
+    robot->lieDown();
+  }
+}
+
+// Save the posture & sleep until the reset button is pressed (does not return)
+void PowerManager::enterDeepSleep() {
+  int pose[8];
+  robot->getCommandedPose(pose);
+
+  SavedPosture saved;
+  memset(&saved, 0, sizeof(saved));
+  saved.magic = POWER_RTC_MAGIC;
+  saved.state = robot->getState();
+  for (int i = 0; i < 8; i++) {
+    saved.angles[i] = constrain(pose[i], 0, 180);
+  }
+  saved.checksum = checksum(saved);
+  ESP.rtcUserMemoryWrite(POWER_RTC_OFFSET, (uint32_t*)&saved, sizeof(saved));
+
+  ESP.deepSleep(0);
+}
+
+bool PowerManager::restorePosture(int pose[8], MovementState &state) {
+  SavedPosture saved;
+  if (!ESP.rtcUserMemoryRead(POWER_RTC_OFFSET, (uint32_t*)&saved, sizeof(saved))) return false;
+  if (saved.magic != POWER_RTC_MAGIC) return false;
+
+  // Use the record once - a later reset must not resume from it again
+  uint32_t magic = saved.magic;
+  saved.magic = 0;
+  ESP.rtcUserMemoryWrite(POWER_RTC_OFFSET, (uint32_t*)&saved, sizeof(saved));
+  saved.magic = magic;
+
+  if (saved.checksum != checksum(saved) || saved.state > SLEEP) return false;
+  for (int i = 0; i < 8; i++) {
+    if (saved.angles[i] > 180) return false;
+    pose[i] = saved.angles[i];
+  }
+  state = (MovementState)saved.state;
+  resumed = true;
+  return true;
+}
+
+// FNV-1a over the record up to the checksum field
+uint32_t PowerManager::checksum(const SavedPosture &saved) {
+  const uint8_t* data = (const uint8_t*)&saved;
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < offsetof(SavedPosture, checksum); i++) {
+    hash ^= data[i];
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+unsigned long PowerManager::getResidencyMs(PowerLevel powerLevel) const {
+  unsigned long total = residencyMs[powerLevel];
+  if (powerLevel == level && applied) {
+    total += millis() - levelSinceMs;
+  }
+  return total;
+}
+
+float PowerManager::getAverageCurrent() const {
+  float charge = 0;
+  unsigned long total = 0;
+  for (int i = 0; i < POWER_LEVELS; i++) {
+    unsigned long ms = getResidencyMs((PowerLevel)i);
+    charge += profiles[i].currentMa * ms;
+    total += ms;
+  }
+  return total > 0 ? charge / total : profiles[level].currentMa;
+}
+
+const char* PowerManager::getLevelName(PowerLevel powerLevel) {
+  switch (powerLevel) {
+    case POWER_ACTIVE: return "active";
+    case POWER_IDLE:   return "idle";
+    case POWER_LOW:    return "low";
+    default:           return "?";
+  }
+}
+
+void PowerManager::report(Print &output) const {
+  char line[64];
+  output.println("LEVEL    MHZ     TIME_S  TX_DBM  MA");
+  for (int i = 0; i < POWER_LEVELS; i++) {
+    const PowerProfile &profile = profiles[i];
+    snprintf(line, sizeof(line), "%-7s %4u %10lu  ", getLevelName((PowerLevel)i), profile.cpuMHz,
+             getResidencyMs((PowerLevel)i) / 1000);
+    output.print(line);
+    output.print(profile.txPowerDbm, 1);
+    output.print("  ");
+    output.print(profile.currentMa, 1);
+    output.println(i == level ? "  <" : "");
+  }
+
+  output.print("avg ");
+  output.print(getAverageCurrent(), 1);
+  output.print(" mA (estimate), ");
+  output.print(switches);
+  output.println(" switches");
+  snprintf(line, sizeof(line), "wake to active: last %lu us, max %lu us",
+           (unsigned long)lastWakeUs, (unsigned long)maxWakeUs);
+  output.println(line);
+}
@@ -0,0 +1,146 @@
+/*
+ * Power_Manager.h - Custom library for scaling the CPU clock & Wi-Fi power with the robot's activity
+ * 
+ * The ESP8266 runs at a fixed clock & the access point transmits at full power whether the
+ * robot is dancing or has been lying still for an hour. This library picks a power level from
+ * the motion state, the last command & the number of stations on the access point, and sets
+ * the CPU frequency, Wi-Fi sleep type & TX power of that level.
+ * 
+ * IMPLEMENTATION:
+ * - POWER_ACTIVE: a sequence is playing or a command arrived in the last activeHoldMs
+ *   → 160 MHz, no Wi-Fi sleep, full TX power
+ * - POWER_IDLE: nothing moving, a station (the app) is connected
+ *   → 80 MHz, modem sleep, full TX power (the link to the app stays as good as before)
+ * - POWER_LOW: nothing moving & no station on the access point for lowAfterMs
+ *   → 80 MHz, modem sleep, reduced TX power
+ * - A robot that joined a network (station mode) counts as connected, it never drops to
+ *   POWER_LOW & keeps the full TX power for the link to the access point
+ * - update() (from a scheduler task) moves between the levels, notifyActivity() (on every
+ *   command) switches to POWER_ACTIVE straight away, so the command runs at full speed
+ * - Only the settings that differ from the current level are changed
+ * - The time spent in every level is kept, together with the time a switch to
+ *   POWER_ACTIVE took (wake latency, last & worst)
+ * - The average current is estimated from the time per level & a current per level.
+ *   The defaults are rough figures for the ESP-12E module alone (servos not included),
+ *   measure your board with a USB power meter & set them with setLevelCurrent()
+ * 
+ * DEEP SLEEP (PARK):
+ * - park() lies the robot down, once the pose is on the servos update() saves the commanded
+ *   angle of every joint & the motion state to RTC user memory and calls ESP.deepSleep(0).
+ *   Any command before that cancels the park
+ * - RTC memory survives the deep sleep & the reset that ends it, but not a power cycle.
+ *   restorePosture() (call before MovementDriver::begin()) returns the saved pose once,
+ *   the sketch attaches the servos at that pose & glides to ready instead of jumping
+ * - The record has a magic number & a checksum, and sits at POWER_RTC_OFFSET, clear of the
+ *   OTA boot command the core keeps at the start of the RTC user memory
+ * 
+ * NOTES:
+ * - GPIO16 (D0) drives the upper left paw, so it can't be wired to RST for a timer wake-up.
+ *   A parked robot sleeps until the reset button is pressed
+ * - The Servo waveform generator follows the CPU clock at runtime, the servo pulses
+ *   don't change when the frequency is switched. millis() & the Tickers don't either
+ * - The softAP has to send beacons & can't sleep, so the SDK ignores the sleep type
+ *   while the access point is running. It is set anyway, it takes effect in station mode,
+ *   where modem sleep can hold back the first command after an idle spell by up to a beacon
+ *   interval (DTIM). setProfile(POWER_IDLE, ...) with WIFI_NONE_SLEEP if that matters
+ * - Switches are logged as EVT_POWER_LEVEL records
+ */
+
+
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+// INCLUDES
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include "Movement_Driver.h"
+
+// DEFINES
+#define POWER_RTC_OFFSET  32            // RTC user memory block (4 bytes each) of the saved posture
+#define POWER_RTC_MAGIC   0x5041524BUL  // "PARK"
+
+// ENUMS
+enum PowerLevel : uint8_t {
+  POWER_ACTIVE,     // Moving or commanded recently
+  POWER_IDLE,       // Still, app connected
+  POWER_LOW,        // Still, nobody connected
+  POWER_LEVELS
+};
+
+// STRUCTS
+struct PowerProfile {
+  uint8_t cpuMHz;             // 80 or 160
+  WiFiSleepType_t sleepType;  // Wi-Fi sleep type (station mode only)
+  float txPowerDbm;           // Transmit power, 0 - 20.5 dBm
+  float currentMa;            // Estimated current draw of the module at this level
+};
+
+// Posture saved to RTC memory before a deep sleep (a multiple of 4 bytes)
+struct SavedPosture {
+  uint32_t magic;         // POWER_RTC_MAGIC while the record is valid
+  uint8_t state;          // MovementState when parked
+  uint8_t angles[8];      // Last commanded angle of each joint (position array column order)
+  uint8_t reserved[3];
+  uint32_t checksum;      // FNV-1a of the fields above
+};
+
+// CLASSES
+class PowerManager {
+  public:
+    PowerManager();
+
+    void begin(MovementDriver &robot);
+    void update();                    // Call from a scheduler task (every 100 - 250 ms)
+    void notifyActivity();            // A command arrived - full power right away (cancels a park)
+
+    // Deep sleep with the posture kept in RTC memory
+    void park();                      // Lie down, save the posture & deep sleep until reset
+    bool isParking() const { return parkRequested; }
+    bool restorePosture(int pose[8], MovementState &state);   // true (once) after a wake from park()
+    bool wasResumed() const { return resumed; }
+
+    void setTimeouts(unsigned long activeHoldMs, unsigned long lowAfterMs);
+    void setProfile(PowerLevel level, const PowerProfile &profile) { profiles[level] = profile; }
+    void setLevelCurrent(PowerLevel level, float currentMa) { profiles[level].currentMa = currentMa; }
+    void setEnabled(bool enabled);    // false = stay in POWER_ACTIVE
+
+    PowerLevel getLevel() const { return level; }
+    const PowerProfile &getProfile(PowerLevel powerLevel) const { return profiles[powerLevel]; }
+    unsigned long getResidencyMs(PowerLevel powerLevel) const;   // Time spent in a level since boot
+    unsigned long getSwitches() const { return switches; }
+    uint32_t getLastWakeUs() const { return lastWakeUs; }       // Time the last switch to POWER_ACTIVE took
+    uint32_t getMaxWakeUs() const { return maxWakeUs; }
+    float getAverageCurrent() const;  // Estimated average mA since boot
+
+    void report(Print &output) const;
+    static const char* getLevelName(PowerLevel powerLevel);
+
+  private:
+    MovementDriver* robot;
+    PowerProfile profiles[POWER_LEVELS];
+    PowerLevel level;
+    bool enabled;
+    bool applied;                     // The profile of the current level has been set
+    bool parkRequested;               // Deep sleep once the robot lies still
+    bool resumed;                     // This boot resumed a parked posture
+
+    unsigned long activeHoldMs;       // Time at POWER_ACTIVE after the last command
+    unsigned long lowAfterMs;         // Time without a station before POWER_LOW
+    unsigned long lastActivityMs;     // millis() of the last command
+    unsigned long lastStationMs;      // millis() when a station was last seen
+
+    unsigned long levelSinceMs;       // millis() when the current level was entered
+    unsigned long residencyMs[POWER_LEVELS];  // Time spent in each finished level period
+    unsigned long switches;
+    uint32_t lastWakeUs;
+    uint32_t maxWakeUs;
+
+    // Helper methods
+    PowerLevel chooseLevel(unsigned long now) const;
+    void switchTo(PowerLevel newLevel, unsigned long now);
+    void applyProfile(const PowerProfile &from, const PowerProfile &to, bool force);
+    void enterDeepSleep();
+    static uint32_t checksum(const SavedPosture &saved);
+};
+
+#endif
@@ -0,0 +1,639 @@
+/*
+ * Sequence_Library.cpp - Implementation of the SequenceLibrary library
+ * 
+ * IMPLEMENTATION:
+ * - begin(): Mounts LittleFS (without formatting it) & loads every *.qds file in /seq
+ * - load(): Loads one file & keeps its result entry
+ * - save(): Writes a version 1 file to a temporary name, replaces the old file with it & loads it
+ * - loadFile(): Reads the header, then either fills a new PackedStep array (readSteps()) or
+ *   opens a FileStepSource for long files, checks every step with fullCheck & registers
+ *   the sequence
+ * - readHeader(): Parses the header of either version & leaves the file at the step data
+ * - SequenceDecoder: Reads version 1 steps & undoes the version 2 delta & varint encoding,
+ *   rejects anything that runs past the data or produces an angle above 180
+ * - FileStepSource: Buffered reads from the file, a ring of decoded steps ahead of the
+ *   step playing, a rewind to the first steps kept in RAM whenever playback starts over
+ *   (the file is opened & positioned after them by the next refill()) & release() closing
+ *   the file when playback ends or is interrupted
+ * - report(): Prints the result of every file
+ */
+
+
+// INCLUDES
+#include "Sequence_Library.h"
+#include <LittleFS.h>
+#include <new>
+
+// The step data in a file is read straight into PackedStep arrays (the ESP8266 is little endian)
+static_assert(sizeof(PackedStep) == 10, "PackedStep must match the 10 byte step of a .qds file");
+
+// HELPER METHODS
+// Zigzag varint value back to a signed change (0, 1, 2, 3 ... = 0, -1, 1, -2 ...)
+static int32_t unzigzag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// CLASS IMPLEMENTATION
+SequenceDecoder::SequenceDecoder() {
+  begin(nullptr, 0, 2, 0);
+}
+
+void SequenceDecoder::begin(const uint8_t* stepData, size_t dataLength, uint8_t fileVersion, uint8_t fileFlags) {
+  setData(stepData, dataLength);
+  version = fileVersion;
+  flags = fileFlags;
+  decoded = 0;
+  memset(angles, 0, sizeof(angles));
+  durationMs = 0;
+}
+
+void SequenceDecoder::setData(const uint8_t* stepData, size_t dataLength) {
+  data = stepData;
+  length = dataLength;
+  position = 0;
+}
+
+bool SequenceDecoder::next(PackedStep &step) {
+  uint32_t value;
+
+  if (version == 1) {
+    // Fixed size step - 8 angles & a uint16 duration
+    if (position + sizeof(PackedStep) > length) return false;
+    for (int j = 0; j < 8; j++) {
+      angles[j] = data[position++];
+      if (angles[j] > 180) return false;
+    }
+    durationMs = data[position] | (data[position + 1] << 8);
+    position += 2;
+  }
+  else if (decoded == 0 || !(flags & SEQUENCE_FLAG_DELTA)) {
+    // Whole step - 8 angles & the duration
+    if (position + 8 > length) return false;
+    for (int j = 0; j < 8; j++) {
+      angles[j] = data[position++];
+      if (angles[j] > 180) return false;
+    }
+    if (!readVarint(data, length, position, value) || value > 0xFFFF) return false;
+    durationMs = value;
+  }
+  else {
+    // Changes - joint mask, an angle change per set bit, then the duration change
+    if (position >= length) return false;
+    uint8_t mask = data[position++];
+    for (int j = 0; j < 8; j++) {
+      if (!(mask & (1 << j))) continue;
+      if (!readVarint(data, length, position, value)) return false;
+      long angle = angles[j] + unzigzag(value);
+      if (angle < 0 || angle > 180) return false;
+      angles[j] = angle;
+    }
+    if (!readVarint(data, length, position, value)) return false;
+    long duration = durationMs + unzigzag(value);
+    if (duration < 0 || duration > 0xFFFF) return false;
+    durationMs = duration;
+  }
+
+  memcpy(step.angles, angles, sizeof(angles));
+  step.durationMs = durationMs;
+  decoded++;
+  return true;
+}
+
+// LEB128 unsigned varint of at most 3 bytes (21 bits)
+bool SequenceDecoder::readVarint(const uint8_t* data, size_t length, size_t &position, uint32_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 21; shift += 7) {
+    if (position >= length) return false;
+    uint8_t byte = data[position++];
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+FileStepSource::FileStepSource() {
+  path[0] = '\0';
+  memset(&header, 0, sizeof(header));
+  cycleMs = 0;
+  seekPending = false;
+  fileRemaining = 0;
+  bufferStart = 0;
+  bufferEnd = 0;
+  blockStart = 0;
+  blockCount = 0;
+  blockFirst = 0;
+  headCount = 0;
+  headBytes = 0;
+  underruns = 0;
+  missedStep = 0xFFFF;
+}
+
+// Verify the whole file once (checksum, then every step) & remember where the steps are
+SequenceLoadResult FileStepSource::open(const char* filePath, const SequenceHeader &fileHeader, bool fullCheck) {
+  if (strlen(filePath) >= sizeof(path)) return SEQ_OPEN_FAILED;
+  strcpy(path, filePath);
+  header = fileHeader;
+  headCount = 0;                  // Both passes start from the first byte of the step data
+  headBytes = 0;
+  headDecoder.begin(buffer, 0, header.version, header.flags);
+
+  // Checksum pass, a buffer at a time
+  rewind();
+  if (!seekFile()) return SEQ_OPEN_FAILED;
+  uint32_t hash = 2166136261UL;
+  while (fileRemaining > 0) {
+    bufferStart = bufferEnd = 0;
+    refill();
+    if (bufferEnd == 0) break;
+    hash = SequenceLibrary::checksum(buffer, bufferEnd, hash);
+  }
+  if (fileRemaining > 0) {
+    file.close();
+    return SEQ_OPEN_FAILED;
+  }
+  if (hash != header.checksum) {
+    file.close();
+    return SEQ_BAD_CHECKSUM;
+  }
+
+  // Decode pass - every step has to decode & the data has to end with the last one,
+  // the first steps & where they end are kept for rewind()
+  rewind();
+  cycleMs = 0;
+  uint8_t first = min(header.steps, (uint16_t)SEQUENCE_STREAM_BLOCK);
+  PackedStep firstSteps[SEQUENCE_STREAM_BLOCK];
+  SequenceDecoder firstDecoder;
+  uint32_t firstBytes = 0;
+  for (uint16_t s = 0; s < header.steps; s++) {
+    if (!decodeNext() || (fullCheck && block[blockStart].durationMs == 0)) {
+      file.close();
+      return SEQ_BAD_STEP;
+    }
+    cycleMs += block[blockStart].durationMs;
+    if (s < first) firstSteps[s] = block[blockStart];
+    if (s + 1 == first) {
+      firstDecoder = decoder;
+      firstBytes = header.dataLength - fileRemaining - (bufferEnd - bufferStart);
+    }
+    dropFirst();
+  }
+  if (fileRemaining > 0 || bufferStart != bufferEnd) {
+    file.close();
+    return SEQ_BAD_STEP;
+  }
+
+  file.close();   // Opened again when the sequence plays past the first steps
+  memcpy(head, firstSteps, first * sizeof(PackedStep));
+  headCount = first;
+  headBytes = firstBytes;
+  headDecoder = firstDecoder;
+  underruns = 0;
+  return SEQ_LOADED;
+}
+
+// Back to step 0 without touching the file (the first steps are in RAM)
+void FileStepSource::rewind() {
+  seekPending = true;
+  fileRemaining = header.dataLength - headBytes;
+  bufferStart = 0;
+  bufferEnd = 0;
+  decoder = headDecoder;
+  memcpy(block, head, headCount * sizeof(PackedStep));
+  blockStart = 0;
+  blockCount = headCount;
+  blockFirst = 0;
+  missedStep = 0xFFFF;
+}
+
+// Open the file (if it isn't) at the first step data byte after the steps kept in RAM
+bool FileStepSource::seekFile() {
+  seekPending = false;
+  if (!file) file = LittleFS.open(path, "r");
+  if (file && file.seek(header.dataOffset + headBytes)) return true;
+
+  if (file) file.close();
+  fileRemaining = 0;
+  return false;
+}
+
+bool FileStepSource::read(uint16_t index, PackedStep &step) {
+  if (index >= header.steps) return false;
+  if (index < blockFirst) rewind();
+
+  // Steps before index won't be read again
+  while (blockCount > 0 && blockFirst < index) {
+    dropFirst();
+  }
+
+  // Not decoded yet - prefetch didn't keep up (or steps were skipped), decode now
+  if (blockCount == 0) {
+    underruns++;
+    while (blockFirst < index) {
+      if (!decodeNext()) return false;
+      dropFirst();
+    }
+    if (!decodeNext()) return false;
+  }
+
+  step = block[blockStart];
+  return true;
+}
+
+bool FileStepSource::isReady(uint16_t index) {
+  if (index >= blockFirst && index - blockFirst < blockCount) return true;
+
+  // Due but not decoded yet - count the step once, however long the engine waits for it
+  if (index != missedStep) {
+    missedStep = index;
+    underruns++;
+  }
+  return false;
+}
+
+void FileStepSource::prefetch() {
+  while (blockCount < SEQUENCE_STREAM_BLOCK && decodeNext()) {}
+}
+
+void FileStepSource::release() {
+  if (file) file.close();
+
+  // Nothing decoded is kept, the next read() starts over from the file (rewind())
+  blockCount = 0;
+  blockFirst = header.steps;
+}
+
+// Move the undecoded bytes to the front of the buffer & fill the rest from the file
+void FileStepSource::refill() {
+  uint8_t undecoded = bufferEnd - bufferStart;
+  memmove(buffer, buffer + bufferStart, undecoded);
+  bufferStart = 0;
+  bufferEnd = undecoded;
+  if (seekPending) seekFile();
+
+  size_t wanted = min((uint32_t)(sizeof(buffer) - bufferEnd), fileRemaining);
+  size_t got = file ? file.read(buffer + bufferEnd, wanted) : 0;
+  bufferEnd += got;
+  fileRemaining = (got == wanted) ? fileRemaining - got : 0;    // A short read means the file ended
+}
+
+// Decode the step after the ring into the ring
+bool FileStepSource::decodeNext() {
+  if (blockCount >= SEQUENCE_STREAM_BLOCK || blockFirst + blockCount >= header.steps) return false;
+
+  // Keep at least one whole encoded step in the buffer
+  if (bufferEnd - bufferStart < SEQUENCE_MAX_STEP_BYTES && fileRemaining > 0) {
+    refill();
+  }
+
+  decoder.setData(buffer + bufferStart, bufferEnd - bufferStart);
+  if (!decoder.next(block[(blockStart + blockCount) % SEQUENCE_STREAM_BLOCK])) return false;
+  bufferStart += decoder.getPosition();
+  blockCount++;
+
+  // Last step decoded - free the file handle until the sequence plays again
+  if (blockFirst + blockCount == header.steps && file) {
+    file.close();
+  }
+  return true;
+}
+
+void FileStepSource::dropFirst() {
+  blockStart = (blockStart + 1) % SEQUENCE_STREAM_BLOCK;
+  blockFirst++;
+  blockCount--;
+}
+
+SequenceLibrary::SequenceLibrary() {
+  for (int i = 0; i < MovementDriver::MAX_CUSTOM_SEQUENCES; i++) {
+    buffers[i] = nullptr;
+    streams[i] = nullptr;
+    slotBytes[i] = 0;
+  }
+  fileCount = 0;
+  mounted = false;
+  loaded = 0;
+  rejected = 0;
+  bytes = 0;
+}
+
+int SequenceLibrary::begin(MovementDriver &robot, bool fullCheck) {
+  // Don't let a failed mount format the partition
+  LittleFSConfig config;
+  config.setAutoFormat(false);
+  LittleFS.setConfig(config);
+  if (!LittleFS.begin()) return 0;    // No file system image uploaded
+  mounted = true;
+
+  char path[48];
+  Dir dir = LittleFS.openDir(SEQUENCE_DIRECTORY);
+  while (dir.next()) {
+    if (!dir.isFile() || !dir.fileName().endsWith(SEQUENCE_EXTENSION)) continue;
+    snprintf(path, sizeof(path), "%s/%s", SEQUENCE_DIRECTORY, dir.fileName().c_str());
+    load(robot, path, fullCheck);
+  }
+  return loaded;
+}
+
+SequenceLoadResult SequenceLibrary::load(MovementDriver &robot, const char* path, bool fullCheck) {
+  // Keep a result entry while there's room (the counters always count)
+  SequenceFile scratch;
+  SequenceFile &entry = fileCount < SEQUENCE_MAX_FILES ? files[fileCount++] : scratch;
+
+  // Until the header says otherwise, name the entry after the file
+  const char* fileName = strrchr(path, '/');
+  fileName = fileName ? fileName + 1 : path;
+  size_t length = strcspn(fileName, ".");
+  if (length >= sizeof(entry.name)) length = sizeof(entry.name) - 1;
+  memcpy(entry.name, fileName, length);
+  entry.name[length] = '\0';
+  entry.id = -1;
+  entry.steps = 0;
+  entry.streamed = false;
+  entry.beats = false;
+
+  entry.result = loadFile(robot, path, fullCheck, entry);
+  if (entry.result == SEQ_LOADED) loaded++;
+  else rejected++;
+  return entry.result;
+}
+
+SequenceLoadResult SequenceLibrary::save(MovementDriver &robot, const char* name, const PackedStep* steps,
+                                         uint16_t count) {
+  if (!isValidName(name)) return SEQ_BAD_NAME;
+  if (!mounted || count == 0) return SEQ_WRITE_FAILED;
+
+  // A built-in name, a full registry or the old steps still playing - the file would be
+  // replaced & the sequence in RAM not, so nothing is written
+  if (!robot.canRegister(name)) return SEQ_NOT_REGISTERED;
+
+  // Version 1 header - the step data is the PackedStep array as it is
+  size_t length = (size_t)count * sizeof(PackedStep);
+  uint32_t hash = checksum((const uint8_t*)steps, length);
+  uint8_t header[SEQUENCE_V1_HEADER_SIZE] = {'Q', 'D', 'S', 1, 8, 0};
+  header[6] = count;
+  header[7] = count >> 8;
+  strncpy((char*)header + 8, name, 16);
+  header[24] = hash;
+  header[25] = hash >> 8;
+  header[26] = hash >> 16;
+  header[27] = hash >> 24;
+
+  char path[48];
+  char temporary[48];
+  snprintf(path, sizeof(path), "%s/%s%s", SEQUENCE_DIRECTORY, name, SEQUENCE_EXTENSION);
+  snprintf(temporary, sizeof(temporary), "%s/%s.tmp", SEQUENCE_DIRECTORY, name);
+  LittleFS.mkdir(SEQUENCE_DIRECTORY);
+  File file = LittleFS.open(temporary, "w");
+  if (!file) return SEQ_WRITE_FAILED;
+  bool written = file.write(header, sizeof(header)) == sizeof(header) &&
+                 file.write((const uint8_t*)steps, length) == length;
+  file.close();
+
+  // Only a complete file replaces the old one (rename() replaces it in one step, so the
+  // old file stays until then)
+  if (!written || !LittleFS.rename(temporary, path)) {
+    LittleFS.remove(temporary);
+    return SEQ_WRITE_FAILED;
+  }
+  return load(robot, path, true);
+}
+
+SequenceLoadResult SequenceLibrary::loadFile(MovementDriver &robot, const char* path, bool fullCheck,
+                                             SequenceFile &entry) {
+  File file = LittleFS.open(path, "r");
+  if (!file) return SEQ_OPEN_FAILED;
+
+  // Fast path part 1 - the header
+  SequenceHeader header;
+  SequenceLoadResult result = readHeader(file, header);
+  if (result != SEQ_LOADED) {
+    file.close();
+    return result;
+  }
+  entry.steps = header.steps;
+  entry.beats = header.flags & SEQUENCE_FLAG_BEATS;
+  if (header.name[0] != '\0') {
+    strcpy(entry.name, header.name);
+  }
+
+  // Long shows are streamed from flash while they play
+  if (header.steps >= SEQUENCE_STREAM_MIN_STEPS) {
+    file.close();
+    FileStepSource* stream = new (std::nothrow) FileStepSource();
+    if (stream == nullptr) return SEQ_NO_MEMORY;
+
+    result = stream->open(path, header, fullCheck);
+    int id = result == SEQ_LOADED ? robot.registerSequence(entry.name, stream) : -1;
+    if (id < 0) {
+      delete stream;
+      return result == SEQ_LOADED ? SEQ_NOT_REGISTERED : result;
+    }
+
+    keep(id, nullptr, stream, sizeof(FileStepSource));
+    entry.id = id;
+    entry.streamed = true;
+    return SEQ_LOADED;
+  }
+
+  // Short ones are loaded into RAM (fast path part 2 - the checksum)
+  PackedStep* steps = nullptr;
+  result = readSteps(file, header, steps);
+  file.close();
+  if (result != SEQ_LOADED) return result;    // readSteps() frees the steps on failure
+
+  // Full check - no zero length steps
+  if (fullCheck) {
+    for (uint16_t s = 0; s < header.steps; s++) {
+      if (steps[s].durationMs == 0) {
+        free(steps);
+        return SEQ_BAD_STEP;
+      }
+    }
+  }
+
+  int id = robot.registerSequence(entry.name, steps, header.steps, entry.beats);
+  if (id < 0) {
+    free(steps);
+    return SEQ_NOT_REGISTERED;
+  }
+
+  keep(id, steps, nullptr, header.steps * sizeof(PackedStep));
+  entry.id = id;
+  return SEQ_LOADED;
+}
+
+// Take over the memory of a registered sequence (a file with a name that is already
+// registered replaced its steps, so the old ones are freed)
+void SequenceLibrary::keep(int id, PackedStep* steps, FileStepSource* stream, size_t size) {
+  int index = id - MovementDriver::CUSTOM_SEQUENCE_BASE;
+  free(buffers[index]);
+  delete streams[index];
+  bytes -= slotBytes[index];
+
+  buffers[index] = steps;
+  streams[index] = stream;
+  slotBytes[index] = size;
+  bytes += size;
+}
+
+// Parse the header of either version, the file is left at the first byte of the step data
+SequenceLoadResult SequenceLibrary::readHeader(File &file, SequenceHeader &header) {
+  uint8_t raw[SEQUENCE_V1_HEADER_SIZE + 2];    // Longest header (version 2 with a 15 character name)
+  size_t got = file.read(raw, sizeof(raw));
+  if (got < 6 || memcmp(raw, "QDS", 3) != 0 || raw[4] != 8) return SEQ_BAD_HEADER;
+
+  header.version = raw[3];
+  header.flags = raw[5];
+  header.name[0] = '\0';
+
+  if (header.version == 1) {
+    if (got < SEQUENCE_V1_HEADER_SIZE) return SEQ_BAD_HEADER;
+    header.steps = raw[6] | (raw[7] << 8);
+    memcpy(header.name, raw + 8, sizeof(header.name) - 1);
+    header.name[sizeof(header.name) - 1] = '\0';
+    header.dataOffset = SEQUENCE_V1_HEADER_SIZE;
+  }
+  else if (header.version == 2) {
+    size_t position = 6;
+    uint8_t nameLength = got > position ? raw[position++] : 0xFF;
+    if (nameLength >= sizeof(header.name) || position + nameLength > got) return SEQ_BAD_HEADER;
+    memcpy(header.name, raw + position, nameLength);
+    header.name[nameLength] = '\0';
+    position += nameLength;
+
+    uint32_t steps;
+    if (!SequenceDecoder::readVarint(raw, got, position, steps) || steps > 0xFFFF) return SEQ_BAD_HEADER;
+    header.steps = steps;
+    header.dataOffset = position + 4;
+  }
+  else {
+    return SEQ_BAD_HEADER;
+  }
+
+  size_t checksumOffset = header.dataOffset - 4;
+  if (header.steps == 0 || header.dataOffset > got || file.size() < header.dataOffset) return SEQ_BAD_HEADER;
+  header.checksum = (uint32_t)raw[checksumOffset] | ((uint32_t)raw[checksumOffset + 1] << 8) |
+                    ((uint32_t)raw[checksumOffset + 2] << 16) | ((uint32_t)raw[checksumOffset + 3] << 24);
+  header.dataLength = file.size() - header.dataOffset;
+
+  // Version 1 steps have a fixed size, so the file size has to match
+  if (header.version == 1 && header.dataLength != (uint32_t)header.steps * sizeof(PackedStep)) return SEQ_BAD_HEADER;
+
+  file.seek(header.dataOffset);
+  return SEQ_LOADED;
+}
+
+// Read the step data into a new PackedStep array
+SequenceLoadResult SequenceLibrary::readSteps(File &file, const SequenceHeader &header, PackedStep* &steps) {
+  size_t length = (size_t)header.steps * sizeof(PackedStep);
+  steps = (PackedStep*)malloc(length);
+  if (steps == nullptr) return SEQ_NO_MEMORY;
+
+  // Version 1 - the step data is read straight into the array that gets registered
+  if (header.version == 1) {
+    if (file.read((uint8_t*)steps, length) != length) {
+      free(steps);
+      return SEQ_OPEN_FAILED;
+    }
+    if (checksum((const uint8_t*)steps, length) != header.checksum) {
+      free(steps);
+      return SEQ_BAD_CHECKSUM;
+    }
+
+    // Angles above 180 would drive the servos to their end stops
+    for (uint16_t s = 0; s < header.steps; s++) {
+      for (int j = 0; j < 8; j++) {
+        if (steps[s].angles[j] > 180) {
+          free(steps);
+          return SEQ_BAD_STEP;
+        }
+      }
+    }
+    return SEQ_LOADED;
+  }
+
+  // Version 2 - read the whole (short) step data & expand it
+  uint8_t* encoded = (uint8_t*)malloc(header.dataLength);
+  if (encoded == nullptr) {
+    free(steps);
+    return SEQ_NO_MEMORY;
+  }
+
+  SequenceLoadResult result = SEQ_LOADED;
+  if (file.read(encoded, header.dataLength) != header.dataLength) {
+    result = SEQ_OPEN_FAILED;
+  }
+  else if (checksum(encoded, header.dataLength) != header.checksum) {
+    result = SEQ_BAD_CHECKSUM;
+  }
+  else {
+    // Every step has to decode & the data has to end with the last one
+    SequenceDecoder decoder;
+    decoder.begin(encoded, header.dataLength, header.version, header.flags);
+    for (uint16_t s = 0; s < header.steps && result == SEQ_LOADED; s++) {
+      if (!decoder.next(steps[s])) result = SEQ_BAD_STEP;
+    }
+    if (decoder.getPosition() != header.dataLength) result = SEQ_BAD_STEP;
+  }
+
+  free(encoded);
+  if (result != SEQ_LOADED) {
+    free(steps);
+  }
+  return result;
+}
+
+unsigned long SequenceLibrary::getUnderruns() const {
+  unsigned long total = 0;
+  for (int i = 0; i < MovementDriver::MAX_CUSTOM_SEQUENCES; i++) {
+    if (streams[i] != nullptr) total += streams[i]->getUnderruns();
+  }
+  return total;
+}
+
+void SequenceLibrary::report(Print &output) const {
+  char line[80];
+  output.println("SEQUENCE          ID  STEPS  MODE   TIME   RESULT");
+  for (int i = 0; i < fileCount; i++) {
+    const SequenceFile &entry = files[i];
+    snprintf(line, sizeof(line), "%-15s %4d %6u  %-5s  %-5s  %s", entry.name, entry.id, entry.steps,
+             entry.streamed ? "flash" : "ram", entry.beats ? "beats" : "ms", getResultName(entry.result));
+    output.println(line);
+  }
+
+  snprintf(line, sizeof(line), "%u loaded (%u bytes), %u rejected, %lu stream underruns", loaded,
+           (unsigned int)bytes, rejected, getUnderruns());
+  output.println(line);
+}
+
+const char* SequenceLibrary::getResultName(SequenceLoadResult result) {
+  switch (result) {
+    case SEQ_LOADED:          return "loaded";
+    case SEQ_OPEN_FAILED:     return "open failed";
+    case SEQ_BAD_HEADER:      return "bad header";
+    case SEQ_BAD_CHECKSUM:    return "bad checksum";
+    case SEQ_BAD_STEP:        return "bad step";
+    case SEQ_NO_MEMORY:       return "no memory";
+    case SEQ_NOT_REGISTERED:  return "not registered";
+    case SEQ_BAD_NAME:        return "bad name";
+    case SEQ_WRITE_FAILED:    return "write failed";
+  }
+  return "unknown";
+}
+
+bool SequenceLibrary::isValidName(const char* name) {
+  size_t length = strlen(name);
+  if (length == 0 || length > 15) return false;
+  for (size_t i = 0; i < length; i++) {
+    if (!isalnum((unsigned char)name[i]) && name[i] != '_' && name[i] != '-') return false;
+  }
+  return true;
+}
+
+uint32_t SequenceLibrary::checksum(const uint8_t* data, size_t length, uint32_t hash) {
+  for (size_t i = 0; i < length; i++) {
+    hash ^= data[i];
+    hash *= 16777619UL;
+  }
+  return hash;
+}
@@ -0,0 +1,237 @@
+/*
+ * Sequence_Library.h - Custom library for loading choreography files from LittleFS
+ * 
+ * The built-in sequences are compiled into Movement_Driver.cpp, so a new dance needs a full
+ * rebuild. This library loads sequence files from the LittleFS partition at boot & registers
+ * them with the MovementDriver, where they play like the built-in ones (robot.play(name) or
+ * by ID). Updating a dance means uploading the file system image, not reflashing the firmware.
+ * 
+ * FILE FORMAT (.qds, little endian, both versions start with magic "QDS", version, joint count (8)
+ * & flags, angles are in position array order URP, URA, LRA, LRP, ULP, ULA, LLA, LLP, durations
+ * are in ms, or in beat ticks (BEAT per beat) with SEQUENCE_FLAG_BEATS):
+ * - Version 1 - fixed size, 28 byte header + 10 bytes per step:
+ *   - 6   uint16    step count
+ *   - 8   char[16]  sequence name (NUL padded, empty = use the file name)
+ *   - 24  uint32    FNV-1a checksum of the step data
+ *   - 28  steps     step count x { uint8 angles[8], uint16 ms }
+ * - Version 2 - compact, what tools/qds_compiler.py writes by default:
+ *   - 6   uint8     name length (0-15), followed by the name
+ *   - varint step count, uint32 FNV-1a checksum of the step data, then the step data
+ *   - First step: the 8 angles as bytes & the duration as a varint
+ *   - Next steps with SEQUENCE_FLAG_DELTA: a byte with a bit per joint that moves, a zigzag
+ *     varint angle change for each of those joints & a zigzag varint duration change
+ *     (an unchanged step with the same duration takes 2 bytes), without the flag every
+ *     step is stored like the first one
+ *   - Varints are LEB128 (7 bits per byte, low bits first, at most 3 bytes), zigzag maps
+ *     0, -1, 1, -2 ... to 0, 1, 2, 3 ...
+ * 
+ * IMPLEMENTATION:
+ * - begin() mounts LittleFS & loads every *.qds file in /seq
+ * - Version 1 step data has the same layout as PackedStep, so it is read straight into the
+ *   array that is registered (one allocation per file, kept for as long as the robot runs)
+ * - Version 2 files are read into a temporary buffer & expanded into the PackedStep array
+ *   by SequenceDecoder, one step at a time
+ * - Files with SEQUENCE_STREAM_MIN_STEPS steps or more (long shows) are not loaded into RAM,
+ *   they are registered as a FileStepSource that streams them from flash while they play:
+ *   - The file is read SEQUENCE_STREAM_BUFFER bytes at a time & decoded into a ring of
+ *     SEQUENCE_STREAM_BLOCK steps, so a 10 minute show uses the same memory as a short one
+ *   - The first SEQUENCE_STREAM_BLOCK steps stay decoded in RAM, so rewind() & the start of
+ *     playback don't touch flash, the file is opened by the first read after them
+ *   - The engine calls prefetch() from update() after each frame, which tops up the ring,
+ *     so the step changes themselves don't wait for flash
+ *   - A step that isn't decoded yet when it is due is an underrun: it is decoded on the spot
+ *     when update() computes the frames, with timed motion updates the engine holds the
+ *     pose until prefetch() has read it (isReady())
+ *   - At boot the file is read through once to verify the checksum & decode every step,
+ *     and it is only kept open while it plays: it is closed once the last step is decoded,
+ *     or by release() when the engine ends or interrupts the sequence
+ * - The fast path only checks the header (magic, version, joint count, file size) and the
+ *   checksum, the full check (fullCheck = true) also checks every step for a zero duration
+ *   (angles outside 0-180 can only come from a broken version 2 file & are always rejected)
+ * - Every file gets a result entry, report() prints them
+ * - save() writes steps recorded on the robot (Teach_Recorder) as a version 1 file in /seq,
+ *   under a temporary name first that rename() then puts in place of the old file in one
+ *   step, so a failed write never leaves half a file or loses the old one. Then it loads
+ *   it like the others (the sequence can play at once & is loaded again at the next boot).
+ *   A name that can't be registered right now (built-in, registry full, or the sequence is
+ *   playing or queued) fails before anything is written
+ * 
+ * NOTES:
+ * - Create the files with tools/qds_compiler.py, put them in data/seq/ & run
+ *   "pio run -t uploadfs" (platformio.ini selects the LittleFS image)
+ * - A file whose name matches a built-in sequence is rejected, a name that is already
+ *   registered replaces the steps of that sequence
+ * - Load before the robot starts playing registered sequences (normally in setup())
+ * - save() needs the file system - upload the image once, a failed mount is never formatted
+ * - With timed motion updates (Ticker) the file is only read in loop() (robot.update()),
+ *   a loop() stalled for longer than the SEQUENCE_STREAM_BLOCK steps ahead stalls the show
+ */
+
+
+#ifndef SEQUENCE_LIBRARY_H
+#define SEQUENCE_LIBRARY_H
+
+// INCLUDES
+#include <Arduino.h>
+#include <FS.h>
+#include "Movement_Driver.h"
+
+// DEFINES
+#define SEQUENCE_DIRECTORY    "/seq"
+#define SEQUENCE_EXTENSION    ".qds"
+#define SEQUENCE_V1_HEADER_SIZE 28
+#define SEQUENCE_FLAG_DELTA   0x01  // Version 2: steps after the first store angle changes
+#define SEQUENCE_FLAG_BEATS   0x02  // Durations are beat ticks, the sequence plays at the robot's tempo
+#define SEQUENCE_MAX_FILES    20    // Result entries kept for report()
+#define SEQUENCE_MAX_STEP_BYTES 20  // Largest encoded step (version 2, every joint & the duration change)
+
+#ifndef SEQUENCE_STREAM_MIN_STEPS
+#define SEQUENCE_STREAM_MIN_STEPS 64  // Files with this many steps or more are streamed from flash
+#endif
+#define SEQUENCE_STREAM_BLOCK   8     // Steps decoded ahead while streaming (and the first steps kept in RAM)
+#define SEQUENCE_STREAM_BUFFER  64    // Bytes read from the file at a time while streaming
+
+// ENUMS
+enum SequenceLoadResult : uint8_t {
+  SEQ_LOADED,             // Registered with the robot
+  SEQ_OPEN_FAILED,        // File couldn't be opened or read
+  SEQ_BAD_HEADER,         // Wrong magic, version, joint count or file size
+  SEQ_BAD_CHECKSUM,       // Step data doesn't match the header checksum
+  SEQ_BAD_STEP,           // Step data can't be decoded, angle above 180 or (full check) zero duration
+  SEQ_NO_MEMORY,          // Step array couldn't be allocated
+  SEQ_NOT_REGISTERED,     // Built-in name, registry full or sequence playing
+  SEQ_BAD_NAME,           // save(): not 1-15 letters, digits, '_' or '-'
+  SEQ_WRITE_FAILED        // save(): no file system or the file couldn't be written
+};
+
+// STRUCTS
+struct SequenceFile {
+  char name[16];                  // Sequence name
+  SequenceLoadResult result;
+  int id;                         // Registered ID (-1 if not loaded)
+  uint16_t steps;                 // Step count from the header
+  bool streamed;                  // Played from flash instead of RAM
+  bool beats;                     // Beat-timed (SEQUENCE_FLAG_BEATS)
+};
+
+// Header fields of a .qds file (either version)
+struct SequenceHeader {
+  uint8_t version;
+  uint8_t flags;
+  char name[16];                  // Empty if the file has no name
+  uint16_t steps;
+  uint32_t checksum;              // FNV-1a of the step data
+  uint32_t dataOffset;            // First byte of the step data
+  uint32_t dataLength;
+};
+
+// CLASSES
+// Expands step data (either version) into PackedSteps, one step per next() call
+class SequenceDecoder {
+  public:
+    SequenceDecoder();
+    void begin(const uint8_t* data, size_t length, uint8_t version, uint8_t flags);
+    void setData(const uint8_t* data, size_t length);   // Continue in a new buffer (keeps the previous step)
+    bool next(PackedStep &step);          // false if the data is broken or used up
+    size_t getPosition() const { return position; }
+    uint16_t getDecoded() const { return decoded; }
+
+    static bool readVarint(const uint8_t* data, size_t length, size_t &position, uint32_t &value);
+
+  private:
+    const uint8_t* data;
+    size_t length;
+    size_t position;                // Next byte to read
+    uint8_t version;
+    uint8_t flags;
+    uint16_t decoded;               // Steps decoded so far
+    uint8_t angles[8];              // Previous step (the base of the changes)
+    uint16_t durationMs;
+};
+
+// Streams the steps of a sequence file from LittleFS in constant memory
+class FileStepSource : public StepSource {
+  public:
+    FileStepSource();
+    SequenceLoadResult open(const char* path, const SequenceHeader &fileHeader, bool fullCheck);
+
+    uint16_t getSize() const override { return header.steps; }
+    unsigned long getCycleMs() const override { return cycleMs; }
+    bool isBeatTimed() const override { return header.flags & SEQUENCE_FLAG_BEATS; }
+    void rewind() override;
+    bool read(uint16_t index, PackedStep &step) override;
+    bool isReady(uint16_t index) override;
+    void prefetch() override;
+    void release() override;
+    unsigned long getUnderruns() const { return underruns; }   // Steps not decoded yet when they were due
+
+  private:
+    char path[40];
+    SequenceHeader header;
+    unsigned long cycleMs;
+    File file;                      // Open while playing
+    bool seekPending;               // Position the file after the first block before reading
+    uint32_t fileRemaining;         // Step data bytes not read from the file yet
+    uint8_t buffer[SEQUENCE_STREAM_BUFFER];
+    uint8_t bufferStart;            // Read but not yet decoded bytes are bufferStart..bufferEnd
+    uint8_t bufferEnd;
+    SequenceDecoder decoder;
+    PackedStep block[SEQUENCE_STREAM_BLOCK];   // Ring of decoded steps
+    uint8_t blockStart;             // Slot of step blockFirst
+    uint8_t blockCount;             // Decoded steps in the ring
+    uint16_t blockFirst;            // Index of the oldest step in the ring
+    PackedStep head[SEQUENCE_STREAM_BLOCK];    // First steps, decoded at open() (playback starts without flash)
+    uint8_t headCount;
+    uint32_t headBytes;             // Step data bytes of the first steps
+    SequenceDecoder headDecoder;    // Decoder state after them
+    unsigned long underruns;
+    uint16_t missedStep;            // Last step counted as an underrun by isReady()
+
+    bool seekFile();
+    void refill();
+    bool decodeNext();
+    void dropFirst();
+};
+
+class SequenceLibrary {
+  public:
+    SequenceLibrary();
+
+    // Mount LittleFS & load every sequence file, returns the number loaded
+    int begin(MovementDriver &robot, bool fullCheck = false);
+
+    // Load one file (e.g. after an upload)
+    SequenceLoadResult load(MovementDriver &robot, const char* path, bool fullCheck = false);
+
+    // Write steps to /seq/<name>.qds & load the file (registers the sequence or replaces its steps)
+    SequenceLoadResult save(MovementDriver &robot, const char* name, const PackedStep* steps, uint16_t count);
+    bool isMounted() const { return mounted; }
+
+    uint8_t getLoaded() const { return loaded; }
+    uint8_t getRejected() const { return rejected; }
+    size_t getBytes() const { return bytes; }     // Heap used by the loaded steps & stream buffers
+    unsigned long getUnderruns() const;           // Stream underruns of all streamed files
+
+    void report(Print &output) const;
+    static const char* getResultName(SequenceLoadResult result);
+    static uint32_t checksum(const uint8_t* data, size_t length, uint32_t hash = 2166136261UL);  // FNV-1a
+    static SequenceLoadResult readHeader(File &file, SequenceHeader &header);
+    static bool isValidName(const char* name);    // Usable as a sequence & file name
+
+  private:
+    PackedStep* buffers[MovementDriver::MAX_CUSTOM_SEQUENCES];     // Steps per registered index
+    FileStepSource* streams[MovementDriver::MAX_CUSTOM_SEQUENCES]; // Or the stream
+    size_t slotBytes[MovementDriver::MAX_CUSTOM_SEQUENCES];        // Heap used per registered index
+    SequenceFile files[SEQUENCE_MAX_FILES];
+    uint8_t fileCount;
+    bool mounted;
+    uint8_t loaded;
+    uint8_t rejected;
+    size_t bytes;
+
+    SequenceLoadResult loadFile(MovementDriver &robot, const char* path, bool fullCheck, SequenceFile &entry);
+    SequenceLoadResult readSteps(File &file, const SequenceHeader &header, PackedStep* &steps);
+    void keep(int id, PackedStep* steps, FileStepSource* stream, size_t size);
+};
+
+#endif
@@ -0,0 +1,232 @@
+/*
+ * Show_Sync.cpp - Implementation of the ShowSync library
+ * 
+ * IMPLEMENTATION:
+ * - update(): Reads every waiting packet, then (as master) sends a beacon when one is due
+ * - handleBeacon(): Checks the packet, follows a new master, feeds the offset estimate &
+ *   passes a new start order on to handleStart()
+ * - updateOffset(): Max of the window, then a jump (first beacon, large error) or a slew
+ * - handleStart(): Plays a start order on the robot at its show time (unless it is too old)
+ * - put32() / get32(): Little endian fields, independent of the CPU's byte order
+ */
+
+
+// INCLUDES
+#include "Show_Sync.h"
+#include "Event_Log.h"
+
+// HELPER METHODS
+void ShowSync::put32(uint8_t* out, uint32_t value) {
+  out[0] = value;
+  out[1] = value >> 8;
+  out[2] = value >> 16;
+  out[3] = value >> 24;
+}
+
+uint32_t ShowSync::get32(const uint8_t* in) {
+  return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+void ShowSync::sendBeacon() {
+  uint8_t packet[SHOW_PACKET_SIZE];
+  put32(packet, SHOW_MAGIC);
+  packet[4] = SHOW_VERSION;
+  packet[5] = startSequence;
+  packet[6] = group;
+  packet[7] = group >> 8;
+  put32(packet + 8, id);
+  put32(packet + 12, now());
+  put32(packet + 16, startCount);
+  put32(packet + 20, startTime);
+
+  udp.beginPacket(IPAddress(255, 255, 255, 255), port);
+  udp.write(packet, sizeof(packet));
+  udp.endPacket();
+  lastBeaconMs = millis();
+  beacons++;
+}
+
+void ShowSync::receive() {
+  uint8_t packet[SHOW_PACKET_SIZE];
+  int size;
+  while ((size = udp.parsePacket()) > 0) {
+    unsigned long receivedMs = millis();
+    if (size != SHOW_PACKET_SIZE || udp.read(packet, sizeof(packet)) != SHOW_PACKET_SIZE) {
+      rejected++;
+      continue;
+    }
+    handleBeacon(packet, receivedMs);
+  }
+}
+
+void ShowSync::handleBeacon(const uint8_t packet[SHOW_PACKET_SIZE], unsigned long receivedMs) {
+  uint32_t sender = get32(packet + 8);
+  if (get32(packet) != SHOW_MAGIC || packet[4] != SHOW_VERSION ||
+      (uint16_t)(packet[6] | packet[7] << 8) != group) {
+    rejected++;
+    return;
+  }
+  if (sender == id) return;     // Our own broadcast
+  if (role == SHOW_MASTER) {
+    conflicts++;
+    return;
+  }
+
+  // A new master - its clock & start orders have nothing to do with the old ones
+  if (sender != masterId) {
+    masterId = sender;
+    windowCount = 0;
+    windowNext = 0;
+    startCount = 0;
+  }
+
+  updateOffset((long)(get32(packet + 12) - receivedMs));
+  lastBeaconMs = receivedMs;
+  beacons++;
+
+  handleStart(get32(packet + 16), packet[5], get32(packet + 20));
+}
+
+void ShowSync::updateOffset(long sample) {
+  window[windowNext] = sample;
+  windowNext = (windowNext + 1) % SHOW_WINDOW;
+  if (windowCount < SHOW_WINDOW) windowCount++;
+
+  // The beacon with the least delay has the largest sample
+  long best = window[0];
+  long worst = window[0];
+  for (uint8_t i = 1; i < windowCount; i++) {
+    if (window[i] > best) best = window[i];
+    if (window[i] < worst) worst = window[i];
+  }
+  spread = best - worst;
+
+  long delta = best - offset;
+  if (!hasOffset || delta > SHOW_JUMP_MS || delta < -SHOW_JUMP_MS) {
+    // Set the clock at once & keep the running step where it is
+    offset = best;
+    hasOffset = true;
+    jumps++;
+    robot->shiftClock(delta);
+    LOG_INFO(EVT_SHOW_CLOCK_SET, (uint16_t)masterId, min(labs(delta), 0xFFFFL), delta < 0);
+  }
+  else {
+    offset += constrain(delta, -SHOW_SLEW_MS, SHOW_SLEW_MS);
+  }
+  error = best - offset;
+}
+
+void ShowSync::handleStart(uint32_t count, uint8_t sequenceId, unsigned long time) {
+  // Every beacon repeats the latest order. A master that restarted counts from 1 again,
+  // so an order with the same count is still new when its time or sequence changed
+  if (count == startCount && time == startTime && sequenceId == startSequence) return;
+  startCount = count;
+  startSequence = sequenceId;
+  startTime = time;
+  if (count == 0) return;
+
+  long late = (long)(now() - time);
+  if (late > SHOW_MAX_LATE_MS || !robot->playAt(sequenceId, time)) {
+    missedStarts++;
+    return;
+  }
+  starts++;
+  LOG_INFO(EVT_SHOW_START, sequenceId, late < 0 ? -late : 0, late > 0 ? late : 0);
+}
+
+// PUBLIC METHODS
+ShowSync::ShowSync() {
+  robot = nullptr;
+  port = SHOW_DEFAULT_PORT;
+  group = SHOW_DEFAULT_GROUP;
+  id = 0;
+  role = SHOW_OFF;
+  offset = 0;
+  hasOffset = false;
+  masterId = 0;
+  windowCount = 0;
+  windowNext = 0;
+  lastBeaconMs = 0;
+  error = 0;
+  spread = 0;
+  startCount = 0;
+  startTime = 0;
+  startSequence = 0;
+  beacons = 0;
+  rejected = 0;
+  jumps = 0;
+  starts = 0;
+  missedStarts = 0;
+  conflicts = 0;
+}
+
+void ShowSync::begin(MovementDriver &driver, uint32_t robotId, uint16_t udpPort, uint16_t showGroup) {
+  robot = &driver;
+  id = robotId;
+  port = udpPort;
+  group = showGroup;
+  role = SHOW_FOLLOWER;
+  udp.begin(port);
+}
+
+void ShowSync::update() {
+  if (role == SHOW_OFF) return;
+
+  receive();
+
+  if (role == SHOW_MASTER) {
+    bool pending = startCount && (long)(startTime - now()) > 0;
+    if (millis() - lastBeaconMs >= (pending ? SHOW_START_BEACON_MS : SHOW_BEACON_MS)) {
+      sendBeacon();
+    }
+  }
+}
+
+void ShowSync::lead() {
+  if (role == SHOW_OFF || role == SHOW_MASTER) return;
+
+  role = SHOW_MASTER;
+  masterId = id;
+  hasOffset = true;
+  beacons = 0;
+  sendBeacon();
+}
+
+void ShowSync::follow() {
+  if (role != SHOW_MASTER) return;
+
+  role = SHOW_FOLLOWER;
+  masterId = 0;
+  windowCount = 0;
+  windowNext = 0;
+  beacons = 0;
+}
+
+// Start a sequence on every robot of the show (including this one) leadMs from now
+bool ShowSync::start(uint8_t sequenceId, unsigned long leadMs) {
+  if (role != SHOW_MASTER) return false;
+
+  unsigned long time = now() + leadMs;
+  if (!robot->playAt(sequenceId, time)) return false;
+
+  startCount++;
+  startSequence = sequenceId;
+  startTime = time;
+  starts++;
+  LOG_INFO(EVT_SHOW_START, sequenceId, min(leadMs, 0xFFFFUL), 0);
+  sendBeacon();
+  return true;
+}
+
+bool ShowSync::isLocked() const {
+  if (role == SHOW_MASTER) return true;
+  return role == SHOW_FOLLOWER && hasOffset && beacons > 0 && millis() - lastBeaconMs < SHOW_LOCK_TIMEOUT_MS;
+}
+
+const char* ShowSync::getRoleName(ShowRole showRole) {
+  switch (showRole) {
+    case SHOW_FOLLOWER: return "follower";
+    case SHOW_MASTER:   return "master";
+    default:            return "off";
+  }
+}
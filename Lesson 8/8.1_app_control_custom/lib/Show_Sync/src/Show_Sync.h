@@ -0,0 +1,149 @@
+/*
+ * Show_Sync.h - Custom library for keeping several robots on one clock during a show
+ * 
+ * Robots started from the app by hand drift apart within a few steps: each one starts when
+ * its command arrives & counts steps on its own crystal. In a show one robot (or a host PC)
+ * is the master & broadcasts its clock over UDP, the others (followers) estimate the offset
+ * to it, so every robot has the same show clock. The master also broadcasts start orders
+ * ("play sequence X at show time T"), and MovementDriver schedules the step deadlines of
+ * the sequence on the show clock, so every robot starts & steps at the same moment.
+ * 
+ * IMPLEMENTATION:
+ * - The master sends a beacon every SHOW_BEACON_MS (every SHOW_START_BEACON_MS while a start
+ *   is pending) with its show clock & the latest start order, so a lost packet or a robot
+ *   that joins late only waits for the next beacon
+ * - A follower timestamps every beacon on receipt: master time - local time is the offset
+ *   plus the network delay of that packet. The largest value of the last SHOW_WINDOW
+ *   beacons has the least delay & is the offset estimate (a late beacon can only be too low)
+ * - The first beacon sets the offset, later estimates move it by at most SHOW_SLEW_MS per
+ *   beacon, so the steps playing are corrected smoothly. An error above SHOW_JUMP_MS
+ *   (new master, master rebooted) sets it at once & shifts the running step with it
+ * - A new start order (count, time or sequence changed) is played with MovementDriver::playAt()
+ *   at its show time. Orders more than SHOW_MAX_LATE_MS old are ignored (a robot booting in
+ *   the middle of a show), younger late ones start at once & the late policy catches up
+ *   with the master
+ * - Beacons from another show group or with a different layout are ignored
+ * 
+ * PACKET FORMAT (24 bytes, little endian):
+ *   magic:4 ("QSHW")  version:1  sequence:1  group:2  sender:4
+ *   clock:4 (sender's show clock, ms)  start count:4 (0 = none yet)  start time:4 (show clock, ms)
+ * 
+ * NOTES:
+ * - The sketch sets a motion clock that returns now() with MovementDriver::setClock(), the
+ *   start times are on that clock
+ * - Beacons go to the broadcast address, which works in station mode & on the robot's own
+ *   access point. UDP broadcasts are not acknowledged or retried, the repeated beacons are
+ *   the retries
+ * - The one-way delay isn't measured, so every follower runs late by the smallest delay seen
+ *   (typically 1-3 ms on a quiet network). The offsets are also whole milliseconds, robots
+ *   agree to within a few ms - far below what anyone sees on a 100+ ms step
+ * - One master per group - a master ignores the beacons of another master & counts them
+ */
+
+
+#ifndef SHOW_SYNC_H
+#define SHOW_SYNC_H
+
+// INCLUDES
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include "Movement_Driver.h"
+
+// DEFINES
+#define SHOW_DEFAULT_PORT     4210
+#define SHOW_DEFAULT_GROUP    1
+#define SHOW_MAGIC            0x57485351UL  // "QSHW"
+#define SHOW_VERSION          1
+#define SHOW_PACKET_SIZE      24
+
+#define SHOW_BEACON_MS        250     // Beacon interval of the master
+#define SHOW_START_BEACON_MS  50      // Beacon interval while a start is pending
+#define SHOW_DEFAULT_LEAD_MS  500     // start() plays this far ahead, time for a few beacons
+#define SHOW_WINDOW           8       // Beacons in the offset estimate
+#define SHOW_SLEW_MS          2       // Largest offset correction per beacon
+#define SHOW_JUMP_MS          100     // Larger errors are corrected at once
+#define SHOW_LOCK_TIMEOUT_MS  2000    // A follower without beacons for this long is unlocked
+#define SHOW_MAX_LATE_MS      2000    // Older start orders are ignored
+
+// ENUMS
+enum ShowRole : uint8_t {
+  SHOW_OFF,         // begin() not called
+  SHOW_FOLLOWER,    // Follows the master's clock & start orders
+  SHOW_MASTER       // Sends the beacons
+};
+
+// CLASSES
+class ShowSync {
+  public:
+    ShowSync();
+
+    void begin(MovementDriver &robot, uint32_t id, uint16_t port = SHOW_DEFAULT_PORT,
+               uint16_t group = SHOW_DEFAULT_GROUP);   // Start as a follower
+    void update();                    // Call on every pass through loop() (beacons are timed on receipt)
+
+    // Master
+    void lead();                      // Send beacons, the show clock continues from where it is
+    void follow();                    // Back to following
+    bool start(uint8_t sequenceId, unsigned long leadMs = SHOW_DEFAULT_LEAD_MS);   // Master only
+
+    // Show clock
+    unsigned long now() const { return millis() + offset; }
+    long getOffset() const { return offset; }   // Show clock - millis()
+    bool isLocked() const;            // Master, or a follower that heard a beacon recently
+
+    // State & statistics
+    ShowRole getRole() const { return role; }
+    uint32_t getMasterId() const { return masterId; }
+    long getError() const { return error; }               // Estimate - offset after the last beacon
+    unsigned long getSpread() const { return spread; }    // Delay variation in the window (ms)
+    unsigned long getBeacons() const { return beacons; }  // Sent (master) or accepted (follower)
+    unsigned long getRejected() const { return rejected; }
+    unsigned long getJumps() const { return jumps; }
+    unsigned long getStarts() const { return starts; }
+    unsigned long getMissedStarts() const { return missedStarts; }
+    unsigned long getConflicts() const { return conflicts; }
+    static const char* getRoleName(ShowRole showRole);
+
+  private:
+    MovementDriver* robot;
+    WiFiUDP udp;
+    uint16_t port;
+    uint16_t group;
+    uint32_t id;                      // Sender ID of our beacons
+    ShowRole role;
+
+    // Show clock
+    volatile long offset;             // Read by the motion Ticker through the motion clock
+    bool hasOffset;                   // A beacon was heard since boot (or we led)
+    uint32_t masterId;
+    long window[SHOW_WINDOW];         // Master time - local time of the last beacons
+    uint8_t windowCount;
+    uint8_t windowNext;
+    unsigned long lastBeaconMs;       // millis() of the last beacon sent / accepted
+    long error;
+    unsigned long spread;
+
+    // Start order (sent as master, last one seen as follower)
+    uint32_t startCount;
+    unsigned long startTime;
+    uint8_t startSequence;
+
+    // Statistics
+    unsigned long beacons;
+    unsigned long rejected;
+    unsigned long jumps;
+    unsigned long starts;
+    unsigned long missedStarts;
+    unsigned long conflicts;
+
+    // Helper methods
+    void sendBeacon();
+    void receive();
+    void handleBeacon(const uint8_t packet[SHOW_PACKET_SIZE], unsigned long receivedMs);
+    void updateOffset(long sample);
+    void handleStart(uint32_t count, uint8_t sequenceId, unsigned long time);
+    static void put32(uint8_t* out, uint32_t value);
+    static uint32_t get32(const uint8_t* in);
+};
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * Teach_Recorder.cpp - Implementation of the TeachRecorder library
+ * 
+ * IMPLEMENTATION:
+ * - start(): Allocates the keyframes once (kept for the next recording until clear()) & opens
+ *   the first keyframe with the commanded pose
+ * - update(): Samples the pose, merges it into the open keyframe or closes that one at the
+ *   sample time & opens the next
+ * - closeKeyframe(): The duration is the time since the keyframe started, cut to
+ *   TEACH_END_HOLD_MS for the first & the last keyframe
+ * - print(): One position array row per keyframe
+ */
+
+
+// INCLUDES
+#include "Teach_Recorder.h"
+#include "Event_Log.h"
+
+// HELPER METHODS
+bool TeachRecorder::samplePose(uint8_t angles[8]) const {
+  int pose[8];
+  robot->getCommandedPose(pose);
+  for (int i = 0; i < 8; i++) {
+    if (pose[i] < 0) return false;    // Joint never written
+    angles[i] = constrain(pose[i], 0, 180);
+  }
+  return true;
+}
+
+bool TeachRecorder::isWithinTolerance(const uint8_t angles[8]) const {
+  const uint8_t* open = steps[count - 1].angles;
+  for (int i = 0; i < 8; i++) {
+    if (abs((int)angles[i] - (int)open[i]) > toleranceDeg) return false;
+  }
+  return true;
+}
+
+void TeachRecorder::closeKeyframe(unsigned long now, bool last) {
+  unsigned long duration = now - keyframeStartMs;
+  if (count == 1 || last) {
+    duration = min(duration, (unsigned long)TEACH_END_HOLD_MS);
+  }
+  steps[count - 1].durationMs = constrain(duration, 1UL, 0xFFFFUL);
+}
+
+bool TeachRecorder::openKeyframe(const uint8_t angles[8], unsigned long now) {
+  if (count == TEACH_MAX_STEPS) {
+    full = true;
+    return false;
+  }
+  memcpy(steps[count].angles, angles, sizeof(steps[count].angles));
+  steps[count].durationMs = 0;        // Still open
+  count++;
+  keyframeStartMs = now;
+  return true;
+}
+
+// PUBLIC METHODS
+TeachRecorder::TeachRecorder() {
+  robot = nullptr;
+  steps = nullptr;
+  count = 0;
+  recording = false;
+  full = false;
+  toleranceDeg = TEACH_DEFAULT_TOLERANCE_DEG;
+  keyframeStartMs = 0;
+  lastSampleMs = 0;
+  merged = 0;
+}
+
+void TeachRecorder::begin(MovementDriver &driver) {
+  robot = &driver;
+}
+
+bool TeachRecorder::start(uint8_t tolerance) {
+  if (!robot) return false;
+  stop();
+
+  uint8_t angles[8];
+  if (!samplePose(angles)) return false;
+  if (!steps) {
+    steps = (PackedStep*)malloc(TEACH_MAX_STEPS * sizeof(PackedStep));
+    if (!steps) return false;
+  }
+
+  count = 0;
+  full = false;
+  merged = 0;
+  toleranceDeg = tolerance;
+  recording = true;
+  lastSampleMs = millis();
+  openKeyframe(angles, lastSampleMs);
+  LOG_INFO(EVT_TEACH_START, toleranceDeg);
+  return true;
+}
+
+void TeachRecorder::stop() {
+  if (!recording) return;
+
+  closeKeyframe(millis(), true);
+  recording = false;
+  LOG_INFO(EVT_TEACH_STOP, count, min(getDurationMs(), 0xFFFFUL), full ? 1 : 0);
+}
+
+void TeachRecorder::clear() {
+  stop();
+  free(steps);
+  steps = nullptr;
+  count = 0;
+  full = false;
+  merged = 0;
+}
+
+void TeachRecorder::update() {
+  if (!recording) return;
+
+  unsigned long now = millis();
+  if (now - lastSampleMs < TEACH_SAMPLE_MS) return;
+  lastSampleMs = now;
+
+  uint8_t angles[8];
+  if (!samplePose(angles)) return;
+  if (isWithinTolerance(angles)) {
+    merged++;
+    if (now - keyframeStartMs < 0xFFFF) return;
+    memcpy(angles, steps[count - 1].angles, sizeof(angles));   // Split a long hold
+  }
+
+  closeKeyframe(now, false);
+  if (!openKeyframe(angles, now)) {
+    // Full - the closed keyframes are the recording
+    recording = false;
+    LOG_WARN(EVT_TEACH_STOP, count, min(getDurationMs(), 0xFFFFUL), 1);
+  }
+}
+
+unsigned long TeachRecorder::getDurationMs() const {
+  unsigned long total = 0;
+  for (uint16_t i = 0; i < count; i++) {
+    total += steps[i].durationMs;
+  }
+  return total;
+}
+
+void TeachRecorder::print(Print &output) const {
+  output.println("// URP---URA---LRA---LRP---ULP---ULA---LLA---LLP---MS");
+  char line[64];
+  for (uint16_t i = 0; i < count; i++) {
+    const PackedStep &step = steps[i];
+    snprintf(line, sizeof(line), "  {%3d, %4d, %4d, %4d, %4d, %4d, %4d, %4d, %5u},",
+             step.angles[0], step.angles[1], step.angles[2], step.angles[3],
+             step.angles[4], step.angles[5], step.angles[6], step.angles[7], step.durationMs);
+    output.println(line);
+  }
+}
@@ -0,0 +1,82 @@
+/*
+ * Teach_Recorder.h - Custom library for recording a new sequence by moving the robot
+ * 
+ * Writing a sequence by hand means guessing angles in a C array, flashing & watching. In teach
+ * mode the robot is moved into shape instead (joints jogged one at a time from the app or a
+ * pose stream from a host) while the recorder samples the pose the servos are commanded to.
+ * The recording is a list of keyframes in the PackedStep format, so Sequence_Library can
+ * save it to LittleFS as a .qds file & register it like any other sequence.
+ * 
+ * IMPLEMENTATION:
+ * - start() allocates the keyframe buffer (TEACH_MAX_STEPS steps) & takes the current pose
+ *   as the first keyframe, stop() closes the last one, clear() frees the buffer
+ * - update() samples the commanded pose every TEACH_SAMPLE_MS. A pose within the tolerance
+ *   of the open keyframe (every joint within toleranceDeg) is merged into it, the first
+ *   one that isn't starts the next keyframe. A keyframe lasts until the next one starts,
+ *   so the steps play back with the timing they were recorded with
+ * - The holds at the start & the end of a recording are cut to TEACH_END_HOLD_MS (the time
+ *   spent reaching for the buttons), a hold longer than a step can be (65 s) is split
+ * - A full buffer stops the recording, the keyframes so far are kept
+ * - print() lists the keyframes as position array rows (9 values), ready to paste into
+ *   Movement_Driver.cpp or to feed to tools/qds_compiler.py
+ * 
+ * NOTES:
+ * - Any pose written to the servos is recorded: jogged joints, a pose stream, or a sequence
+ *   that is playing
+ * - update() is called from the motion task, after the robot has written its frame
+ */
+
+
+#ifndef TEACH_RECORDER_H
+#define TEACH_RECORDER_H
+
+// INCLUDES
+#include <Arduino.h>
+#include "Movement_Driver.h"
+
+// DEFINES
+#define TEACH_MAX_STEPS       512     // Keyframes per recording (10 bytes each, allocated by the first start())
+#define TEACH_SAMPLE_MS       10      // Pose sampling interval
+#define TEACH_DEFAULT_TOLERANCE_DEG 2 // Poses this close to the open keyframe are merged into it
+#define TEACH_END_HOLD_MS     500     // Longest hold kept at the start & the end of a recording
+
+// CLASSES
+class TeachRecorder {
+  public:
+    TeachRecorder();
+
+    void begin(MovementDriver &robot);
+    bool start(uint8_t toleranceDeg = TEACH_DEFAULT_TOLERANCE_DEG);   // false = no memory or no pose yet
+    void stop();
+    void clear();                     // Stop & free the keyframes
+    void update();                    // Call on every pass through loop() (motion task)
+
+    // Recording
+    bool isRecording() const { return recording; }
+    bool isFull() const { return full; }
+    const PackedStep* getSteps() const { return steps; }
+    uint16_t getStepCount() const { return count; }
+    unsigned long getDurationMs() const;        // Sum of the closed keyframes
+    uint8_t getTolerance() const { return toleranceDeg; }
+    unsigned long getMerged() const { return merged; }   // Samples merged into a keyframe
+    void print(Print &output) const;
+
+  private:
+    MovementDriver* robot;
+    PackedStep* steps;                // Keyframes (nullptr until start())
+    uint16_t count;                   // Keyframes, the last one is open while recording
+    bool recording;
+    bool full;
+    uint8_t toleranceDeg;
+    unsigned long keyframeStartMs;    // millis() when the open keyframe started
+    unsigned long lastSampleMs;
+    unsigned long merged;
+
+    // Helper methods
+    bool samplePose(uint8_t angles[8]) const;
+    bool isWithinTolerance(const uint8_t angles[8]) const;
+    void closeKeyframe(unsigned long now, bool last);
+    bool openKeyframe(const uint8_t angles[8], unsigned long now);
+};
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Telemetry.cpp - Implementation of the Telemetry library
+ * 
+ * IMPLEMENTATION:
+ * - addSection(): Stores the name & callback in a fixed size table
+ * - report(): Prints the header, runs every section callback, prints the footer
+ * - field(): Prints one "section.key=value" line to the current output
+ */
+
+
+// INCLUDES
+#include "Telemetry.h"
+
+// HELPER METHODS
+void Telemetry::printKey(const char* key) {
+  out->print(currentSection);
+  out->print('.');
+  out->print(key);
+  out->print('=');
+}
+
+// PUBLIC METHODS
+bool Telemetry::addSection(const char* name, SectionCallback callback) {
+  if (sectionCount >= MAX_SECTIONS) return false;
+
+  sections[sectionCount].name = name;
+  sections[sectionCount].callback = callback;
+  sectionCount++;
+  return true;
+}
+
+void Telemetry::report(Print &output) {
+  out = &output;
+
+  out->print("#TELEMETRY ms=");
+  out->println(millis());
+
+  for (int i = 0; i < sectionCount; i++) {
+    currentSection = sections[i].name;
+    sections[i].callback(*this);
+  }
+
+  out->println("#END");
+  out = nullptr;
+  currentSection = nullptr;
+}
+
+void Telemetry::field(const char* key, long value) {
+  if (!out) return;
+  printKey(key);
+  out->println(value);
+}
+
+void Telemetry::field(const char* key, unsigned long value) {
+  if (!out) return;
+  printKey(key);
+  out->println(value);
+}
+
+void Telemetry::field(const char* key, float value, int decimals) {
+  if (!out) return;
+  printKey(key);
+  out->println(value, decimals);
+}
+
+void Telemetry::field(const char* key, const char* value) {
+  if (!out) return;
+  printKey(key);
+  out->println(value);
+}
@@ -0,0 +1,65 @@
+/*
+ * Telemetry.h - Custom library for reporting robot status as plain text
+ * 
+ * This library collects status values from the other drivers and prints them
+ * as one report to any output (Serial monitor or the connected Wi-Fi client).
+ * 
+ * IMPLEMENTATION:
+ * - Each driver or the main sketch registers a named section with a callback
+ * - report() calls every section callback in the order they were added
+ * - The callbacks write their values with field(), which prefixes the section name
+ * - Nothing is buffered, so a report costs no RAM beyond the section table
+ * 
+ * REPORT FORMAT:
+ *   #TELEMETRY ms=123456
+ *   odom.x_mm=120.0
+ *   odom.heading_deg=-30.0
+ *   ...
+ *   #END
+ */
+
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+// INCLUDES
+#include <Arduino.h>
+
+// CLASSES
+class Telemetry {
+  public:
+    // Section callback - writes its values with field()
+    typedef void (*SectionCallback)(Telemetry &telemetry);
+
+    // Public methods
+    bool addSection(const char* name, SectionCallback callback);  // Register a section (false if table is full)
+    void report(Print &output);                                   // Print all sections
+
+    // Field writers (only valid inside a section callback)
+    void field(const char* key, long value);
+    void field(const char* key, unsigned long value);
+    void field(const char* key, int value) { field(key, (long)value); }
+    void field(const char* key, unsigned int value) { field(key, (unsigned long)value); }
+    void field(const char* key, float value, int decimals = 2);
+    void field(const char* key, const char* value);
+
+  private:
+    static const int MAX_SECTIONS = 16;
+
+    struct Section {
+      const char* name;
+      SectionCallback callback;
+    };
+
+    Section sections[MAX_SECTIONS];
+    int sectionCount = 0;
+
+    // Output & section currently being reported
+    Print* out = nullptr;
+    const char* currentSection = nullptr;
+
+    // Helper methods
+    void printKey(const char* key);
+};
+
+#endif
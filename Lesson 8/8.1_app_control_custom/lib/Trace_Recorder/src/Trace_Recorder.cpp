@@ -0,0 +1,99 @@
+/*
+ * Trace_Recorder.cpp - Implementation of the TraceRecorder library
+ * 
+ * IMPLEMENTATION:
+ * - write(): Adds a gap record after a long quiet period, then stores the record
+ * - endPoll(): Writes the begin & end of a poll span only when it is worth keeping
+ * - dump(): Prints the header, the records oldest first & the end marker
+ */
+
+
+// INCLUDES
+#include "Trace_Recorder.h"
+
+// Shared recorder instance
+TraceRecorder trace;
+
+#if TRACE_RECORDER_ENABLED
+
+// DEFINES
+#define GAP_RECORD_MS 10000   // Well below the cycle counter wrap at 160MHz (~27s)
+
+// HELPER METHODS
+static void printHex(Print &output, uint32_t value, int digits) {
+  static const char hexDigits[] = "0123456789abcdef";
+  for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4) {
+    output.print(hexDigits[(value >> shift) & 0x0F]);
+  }
+}
+
+void TraceRecorder::write(uint8_t phase, uint8_t id, uint16_t arg, uint32_t cycles) {
+  if (paused) return;
+
+  // Nothing recorded for a while - note how long, so the host can unwrap the cycle counter
+  unsigned long now = millis();
+  if (count > 0 && now - lastRecordMs >= GAP_RECORD_MS) {
+    unsigned long seconds = (now - lastRecordMs) / 1000;
+    TraceRecord &gap = records[count & (TRACE_CAPACITY - 1)];
+    gap.cycles = cycles;
+    gap.phase = TRACE_PHASE_GAP;
+    gap.id = 0;
+    gap.arg = seconds > 0xFFFF ? 0xFFFF : seconds;
+    count++;
+  }
+  lastRecordMs = now;
+
+  TraceRecord &record = records[count & (TRACE_CAPACITY - 1)];
+  record.cycles = cycles;
+  record.phase = phase;
+  record.id = id;
+  record.arg = arg;
+  count++;
+}
+
+// PUBLIC METHODS
+void TraceRecorder::endPoll(uint8_t id, uint32_t startCycles, uint32_t startCount) {
+  uint32_t endCycles = ESP.getCycleCount();
+
+  // Keep the span if something happened inside it or it took long enough to matter
+  if (count == startCount && endCycles - startCycles < TRACE_MIN_POLL_US * ESP.getCpuFreqMHz()) {
+    return;
+  }
+
+  // The begin record goes after any records from inside the span (the host sorts by time)
+  write(TRACE_PHASE_BEGIN, id, 0, startCycles);
+  write(TRACE_PHASE_END, id, 0, endCycles);
+}
+
+void TraceRecorder::dump(Print &output) {
+  paused = true;
+
+  uint16_t stored = size();
+  output.print("#TRACE mhz=");
+  output.print(ESP.getCpuFreqMHz());
+  output.print(" records=");
+  output.print(stored);
+  output.print(" lost=");
+  output.println(count - stored);
+
+  // Oldest record first
+  for (uint32_t i = count - stored; i != count; i++) {
+    const TraceRecord &record = records[i & (TRACE_CAPACITY - 1)];
+    output.print("#TR ");
+    printHex(output, record.cycles, 8);
+    printHex(output, record.phase, 2);
+    printHex(output, record.id, 2);
+    printHex(output, record.arg, 4);
+    output.println();
+  }
+  output.println("#TREND");
+
+  clear();
+  paused = false;
+}
+
+void TraceRecorder::clear() {
+  count = 0;
+}
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ * Trace_Recorder.h - Custom library for recording a timeline of what the robot was doing
+ * 
+ * When a movement stutters, the latency histograms show that something was slow but not
+ * what happened around it. This library keeps the last few hundred begin / end / instant
+ * events with CPU cycle timestamps, so the moments before a stutter can be dumped & viewed
+ * as a timeline (tools/trace_to_chrome.py converts a dump for chrome://tracing or Perfetto).
+ * 
+ * IMPLEMENTATION:
+ * - Every event is an 8 byte record (cycle count, phase, trace ID & one argument)
+ * - The buffer is a ring that overwrites the oldest records, so it always holds the
+ *   most recent part of the timeline
+ * - TRACE_SCOPE(id, arg) records a begin event now & the end event when the scope is left
+ * - TRACE_POLL_SCOPE(id) is for code that runs on every loop() pass (polling Wi-Fi, motion
+ *   frames with nothing to do): the span is only recorded when it took at least
+ *   TRACE_MIN_POLL_US or when something else was recorded inside it. Otherwise idle
+ *   passes would fill the buffer in a few milliseconds
+ * - TRACE_INSTANT(id, arg) records a single point in time (command received, step started)
+ * - The cycle counter wraps every 2^32 cycles (~54s at 80MHz), so a gap record with the
+ *   number of seconds since the last event is added when nothing was recorded for a while
+ * - dump() pauses recording, prints the buffer oldest first & clears it
+ * 
+ * OUTPUT FORMAT:
+ *   #TRACE mhz=<CPU MHz> records=<count> lost=<overwritten records>
+ *   #TR <cycles:8 hex><phase:2 hex><id:2 hex><arg:4 hex>    (one line per record)
+ *   #TREND
+ * 
+ * NOTES:
+ * - Add "-D TRACE_RECORDER_ENABLED=0" to build_flags to compile the recorder out
+ * - Keep the trace table in tools/trace_to_chrome.py in sync with TraceId below
+ */
+
+
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+// INCLUDES
+#include <Arduino.h>
+
+// DEFINES
+#ifndef TRACE_RECORDER_ENABLED
+#define TRACE_RECORDER_ENABLED 1
+#endif
+
+#ifndef TRACE_CAPACITY
+#define TRACE_CAPACITY 256    // Records (must be a power of 2, 8 bytes each)
+#endif
+
+#ifndef TRACE_MIN_POLL_US
+#define TRACE_MIN_POLL_US 200 // Shorter empty poll spans are not recorded
+#endif
+
+// ENUMS
+enum TraceId : uint8_t {
+  TRACE_LOOP = 1,           // Span: one pass through loop()
+  TRACE_WIFI_POLL,          // Span: wifi.handleClient()
+  TRACE_MOTION_FRAME,       // Span: one motion frame (robot.update() or the Ticker)
+  TRACE_SERVO_WRITE,        // Span: writing servo positions, arg = state
+  TRACE_CLIENT_CONNECTED,   // Instant
+  TRACE_COMMAND,            // Instant: complete frame received, arg = action
+  TRACE_SEQUENCE_START,     // Instant: arg = sequence ID
+  TRACE_STEP,               // Instant: arg = step index
+  TRACE_STEP_LATE           // Instant: arg = lateness ms
+};
+
+enum TracePhase : uint8_t {
+  TRACE_PHASE_BEGIN = 'B',
+  TRACE_PHASE_END = 'E',
+  TRACE_PHASE_INSTANT = 'i',
+  TRACE_PHASE_GAP = 'G'     // Arg = seconds since the previous record
+};
+
+// CLASSES
+#if TRACE_RECORDER_ENABLED
+
+// STRUCTS
+struct TraceRecord {
+  uint32_t cycles;          // ESP.getCycleCount() when the event happened
+  uint8_t phase;            // TracePhase
+  uint8_t id;               // TraceId
+  uint16_t arg;
+};
+
+class TraceRecorder {
+  public:
+    void begin(uint8_t id, uint16_t arg = 0) { write(TRACE_PHASE_BEGIN, id, arg, ESP.getCycleCount()); }
+    void end(uint8_t id) { write(TRACE_PHASE_END, id, 0, ESP.getCycleCount()); }
+    void instant(uint8_t id, uint16_t arg = 0) { write(TRACE_PHASE_INSTANT, id, arg, ESP.getCycleCount()); }
+    void endPoll(uint8_t id, uint32_t startCycles, uint32_t startCount);  // Used by TRACE_POLL_SCOPE
+
+    void dump(Print &output);         // Print the buffer & start a new trace
+    void clear();
+
+    uint32_t getCount() const { return count; }   // Records written since the last clear
+    uint16_t size() const { return count < TRACE_CAPACITY ? count : TRACE_CAPACITY; }
+
+  private:
+    TraceRecord records[TRACE_CAPACITY];
+    uint32_t count = 0;
+    unsigned long lastRecordMs = 0;
+    bool paused = false;
+
+    void write(uint8_t phase, uint8_t id, uint16_t arg, uint32_t cycles);
+};
+
+// Shared recorder instance
+extern TraceRecorder trace;
+
+// Records begin on construction & end on destruction
+class TraceScope {
+  public:
+    TraceScope(uint8_t id, uint16_t arg) : id(id) { trace.begin(id, arg); }
+    ~TraceScope() { trace.end(id); }
+
+  private:
+    uint8_t id;
+};
+
+// Records begin & end on destruction, if the span was slow or had events inside it
+class TracePollScope {
+  public:
+    TracePollScope(uint8_t id) : id(id), startCycles(ESP.getCycleCount()), startCount(trace.getCount()) {}
+    ~TracePollScope() { trace.endPoll(id, startCycles, startCount); }
+
+  private:
+    uint8_t id;
+    uint32_t startCycles;
+    uint32_t startCount;
+};
+
+#define TRACE_SCOPE(id, arg)    TraceScope traceScope_##id(id, arg)
+#define TRACE_POLL_SCOPE(id)    TracePollScope tracePoll_##id(id)
+#define TRACE_INSTANT(id, arg)  trace.instant(id, arg)
+
+#else
+
+// Tracing compiled out - same interface, no RAM & no code
+class TraceRecorder {
+  public:
+    void dump(Print &output) { output.println("Trace recorder disabled"); }
+    void clear() {}
+};
+
+extern TraceRecorder trace;
+
+#define TRACE_SCOPE(id, arg)
+#define TRACE_POLL_SCOPE(id)
+#define TRACE_INSTANT(id, arg)
+
+#endif
+
+#endif
@@ -5,22 +5,38 @@
  * and protocol parsing for incoming command data.
  * 
  * IMPLEMENTATION:
- * - begin(): Initializes Wi-Fi in AP mode with specified credentials
+ * - begin(): Initializes Wi-Fi in AP mode with specified credentials (after a channel scan
+ *   when no channel is given)
+ * - beginStation(): Joins an existing network, with the access point as the fallback
+ * - advertise(): Sets the mDNS host name & service records, announced once a link is up
+ * - finishStart(): Finishes the scan or the join from handleClient(), until a link is up
+ * - finishScan() / scoreChannels(): Pick the channel from the scan results
  * - handleClient(): Main loop for client connection management and data parsing
+ * - feedByte(): The protocol parser, one received byte at a time (no network needed, so it
+ *   can also be fed from benchmarks or other transports)
  * - parseReceivedData(): Extracts command data from received protocol packets
+ * - getPayload(): The bytes after the command fields, for frames that carry data (pose stream)
  * - sendData(): Sends data back to connected client
  * - isClientConnected(): Checks if client is still connected
+ * - getStream(): Gives access to the client as a Print output (for text reports)
  * 
  * PROTOCOL PARSING:
  * - Looks for 0xFF 0x55 preamble to start receiving
  * - Second byte indicates total data length
  * - Times out after 3 seconds of inactivity
  * - Automatically returns to standby if client disconnects
+ * 
+ * LOGGING:
+ * - Received commands & connection changes are logged as Event_Log records instead of
+ *   Serial prints, so the receive path costs a few cycles instead of milliseconds
+ * - handleClient() calls, new clients & received commands are recorded by the Trace_Recorder
  */
 
 
 // INCLUDES
 #include "WiFi_Driver.h"
+#include "Event_Log.h"
+#include "Trace_Recorder.h"
 
 // HELPER METHODS
 unsigned char WiFiDriver::readBuffer(int index) {
@@ -39,62 +55,251 @@ WiFiDriver::CommandData WiFiDriver::parseReceivedData() {
   // Extract the important information from the message
   cmd.action = readBuffer(9);        // What action to perform
   cmd.device = readBuffer(10);       // Which device to control
+  if (cmd.action < WIFI_ACTION_CODES) {
+    commandCounts[cmd.action]++;
+  }
+  else {
+    otherCommands++;
+  }
+  cmd.movementType = 0;
+  if (cmd.action == WIFI_STREAM_ACTION) {
+    return cmd;   // 50 a second - counted, not logged
+  }
+  TRACE_INSTANT(TRACE_COMMAND, cmd.action);
   
-  // For movement commands, get the specific movement type
-  if (cmd.action == 1) { // CMD_RUN - movement command
+  // Movement type of a movement command, the parameter byte of the others (0 if the frame is shorter)
+  if (frameLength > 12) {
     cmd.movementType = readBuffer(12);
-    
-    // Show what we received in the Serial Monitor
-    Serial.print("Movement Command: Action 0x");
-    Serial.print(cmd.action, HEX);
-    Serial.print(", Device 0x");
-    Serial.print(cmd.device, HEX);
-    Serial.print(", MovementType 0x");
-    if (cmd.movementType < 0x10) Serial.print("0"); // Add leading zero for formatting
-    Serial.println(cmd.movementType, HEX);
+  }
+  if (cmd.action == 1) { // CMD_RUN - movement command
+    // Log what we received (decoded later by tools/decode_event_log.py)
+    LOG_INFO(EVT_CMD_MOVEMENT, cmd.action, cmd.device, cmd.movementType);
   }
   else {
-    cmd.movementType = 0; // Not a movement command
-    
-    // Show what we received in the Serial Monitor
-    Serial.print("Action Command: Action 0x");
-    Serial.print(cmd.action, HEX);
-    Serial.print(", Device 0x");
-    if (cmd.device < 0x10) Serial.print("0"); // Add leading zero for formatting
-    Serial.println(cmd.device, HEX);
+    // Not a movement command, log what we received (decoded later by tools/decode_event_log.py)
+    LOG_INFO(EVT_CMD_ACTION, cmd.action, cmd.device);
   }
   
   return cmd;
 }
 
-// PUBLIC METHODS
-void WiFiDriver::begin(const char* ssid, const char* password) {
-  Serial.println("\nInitializing Wi-Fi...");
-  
-  // Set up as Access Point
+// Finish the channel scan or the network join (true = link is up)
+bool WiFiDriver::finishStart() {
+  if (link == WIFI_LINK_JOINING && !finishJoin()) return false;
+  if (link == WIFI_LINK_SCANNING && !finishScan()) return false;
+  return true;
+}
+
+// Check the join, start the server once the network is joined or fall back to the AP
+bool WiFiDriver::finishJoin() {
+  unsigned long elapsed = millis() - joinStartMs;
+  if (WiFi.status() == WL_CONNECTED) {
+    link = WIFI_LINK_STATION;
+    joinMs = elapsed;
+    channel = WiFi.channel();
+    startServer();
+    LOG_INFO(EVT_WIFI_JOINED, channel, -WiFi.RSSI(), joinMs > 0xFFFF ? 0xFFFF : joinMs);
+
+    // Show connection information
+    Serial.print("Wi-Fi joined ");
+    Serial.print(networkSsid);
+    Serial.print(" on channel ");
+    Serial.print(channel);
+    Serial.print(", connect to ");
+    Serial.print(WiFi.localIP());
+    if (advertised) {
+      Serial.print(" or ");
+      Serial.print(hostname);
+      Serial.print(".local");
+    }
+    Serial.print(" port ");
+    Serial.println(WIFI_CONTROL_PORT);
+    return true;
+  }
+  if (elapsed < WIFI_JOIN_TIMEOUT_MS) return false;
+
+  // Not joined - run our own access point instead
+  LOG_WARN(EVT_WIFI_JOIN_FAILED, WiFi.status(), elapsed > 0xFFFF ? 0xFFFF : elapsed);
+  Serial.print("Wi-Fi couldn't join ");
+  Serial.print(networkSsid);
+  Serial.println(", starting the access point");
+  WiFi.disconnect();
+  if (autoChannel) {
+    startScan();
+    return false;
+  }
+  startAccessPoint();
+  return true;
+}
+
+// Check the channel scan, pick the channel & start the AP when it is done (true = AP is up)
+bool WiFiDriver::finishScan() {
+  int networks = WiFi.scanComplete();
+  bool timedOut = millis() - scanStartMs > WIFI_SCAN_TIMEOUT_MS;
+  if (networks == WIFI_SCAN_RUNNING && !timedOut) return false;
+
+  scanMs = millis() - scanStartMs;
+  if (networks >= 0) {
+    scanCount = networks;
+    channel = scoreChannels(networks);
+  }
+  else {
+    scanCount = -1;
+    channel = WIFI_DEFAULT_CHANNEL;
+  }
+  WiFi.scanDelete();
+
+  startAccessPoint();
+  return true;
+}
+
+// Score every channel by the access points that overlap it, return the quietest
+uint8_t WiFiDriver::scoreChannels(int networks) {
+  memset(channelAps, 0, sizeof(channelAps));
+  memset(channelScore, 0, sizeof(channelScore));
+
+  for (int i = 0; i < networks; i++) {
+    int apChannel = WiFi.channel(i);
+    int strength = constrain(WiFi.RSSI(i) + 100, 1, 70);   // -99 dBm = 1 ... -30 dBm = 70
+    if (apChannel >= 1 && apChannel <= WIFI_MAX_CHANNEL) channelAps[apChannel]++;
+
+    // Full weight on its own channel, a quarter less for every channel further away
+    for (int ch = 1; ch <= WIFI_MAX_CHANNEL; ch++) {
+      int distance = abs(ch - apChannel);
+      if (distance < 4) {
+        channelScore[ch] += strength * (4 - distance) / 4;
+      }
+    }
+  }
+
+  uint8_t best = 1;
+  for (int ch = 2; ch <= WIFI_MAX_CHANNEL; ch++) {
+    bool preferred = ch == 6 || ch == 11;
+    bool bestPreferred = best == 1 || best == 6 || best == 11;
+    if (channelScore[ch] < channelScore[best] ||
+        (channelScore[ch] == channelScore[best] && preferred && !bestPreferred)) {
+      best = ch;
+    }
+  }
+  return best;
+}
+
+// Scan in station mode without waiting, finishScan() picks the channel
+void WiFiDriver::startScan() {
+  link = WIFI_LINK_SCANNING;
+  WiFi.mode(WIFI_STA);
+  scanStartMs = millis();
+  WiFi.scanNetworks(true, true);
+}
+
+void WiFiDriver::startAccessPoint() {
+  // Set up as Access Point - the SDK finishes bringing it up in the background, no need to wait
+  link = WIFI_LINK_ACCESS_POINT;
   WiFi.mode(WIFI_AP);
-  WiFi.softAP(ssid, password, 5);
-  server.begin();
-  delay(100);
-  
+  WiFi.softAP(apSsid, apPassword, channel);
+  startServer();
+  LOG_INFO(EVT_WIFI_READY, channel, scanCount < 0 ? 0 : scanCount, scanMs > 0xFFFF ? 0xFFFF : scanMs);
+
   // Show connection information
-  Serial.println("Wi-Fi AP ready and server started.");
-  Serial.print("Connect to SSID: ");
-  Serial.print(ssid);
+  Serial.print("Wi-Fi AP started on channel ");
+  Serial.print(channel);
+  Serial.print(", connect to SSID: ");
+  Serial.print(apSsid);
   Serial.print(" with password: ");
-  Serial.print(password);
-  Serial.println(" to control the robot.");
+  Serial.println(apPassword);
+}
+
+// Start the command server & announce it over mDNS on the link that is up
+void WiFiDriver::startServer() {
+  server.begin();
+  if (!hostname) return;
+
+  advertised = MDNS.begin(hostname);
+  if (advertised) {
+    MDNS.addService(WIFI_SERVICE, "tcp", WIFI_CONTROL_PORT);
+    MDNS.addServiceTxt(WIFI_SERVICE, "tcp", "id", robotId);
+    MDNS.addServiceTxt(WIFI_SERVICE, "tcp", "model", "QD020");
+    MDNS.addServiceTxt(WIFI_SERVICE, "tcp", "caps", capabilities);
+  }
+}
+
+// True when the link the app connection runs over is gone
+bool WiFiDriver::isLinkLost() {
+  if (link == WIFI_LINK_STATION) {
+    return WiFi.status() != WL_CONNECTED;
+  }
+  return WiFi.softAPgetStationNum() == 0;
+}
+
+// PUBLIC METHODS
+void WiFiDriver::begin(const char* ssid, const char* password, uint8_t fixedChannel) {
+  apSsid = ssid;
+  apPassword = password;
+  autoChannel = fixedChannel == WIFI_AUTO_CHANNEL;
+
+  if (autoChannel) {
+    startScan();   // handleClient() finishes the job
+  }
+  else {
+    channel = fixedChannel;
+    startAccessPoint();
+  }
+}
+
+void WiFiDriver::beginStation(const char* stationSsid, const char* stationPassword,
+                              const char* ssid, const char* password, uint8_t fixedChannel) {
+  apSsid = ssid;
+  apPassword = password;
+  autoChannel = fixedChannel == WIFI_AUTO_CHANNEL;
+  channel = autoChannel ? 0 : fixedChannel;
+  networkSsid = stationSsid;
+
+  // Join without waiting, handleClient() starts the server or the AP
+  link = WIFI_LINK_JOINING;
+  WiFi.mode(WIFI_STA);
+  WiFi.persistent(false);         // Don't store the credentials in flash
+  WiFi.setAutoReconnect(true);
+  if (hostname) WiFi.hostname(hostname);
+  joinStartMs = millis();
+  WiFi.begin(stationSsid, stationPassword);
+}
+
+void WiFiDriver::advertise(const char* name, const char* id, const char* caps) {
+  hostname = name;
+  robotId = id;
+  capabilities = caps;
+}
+
+const char* WiFiDriver::getLinkName(WiFiLink link) {
+  switch (link) {
+    case WIFI_LINK_SCANNING:      return "scanning";
+    case WIFI_LINK_JOINING:       return "joining";
+    case WIFI_LINK_STATION:       return "station";
+    case WIFI_LINK_ACCESS_POINT:  return "ap";
+    default:                      return "off";
+  }
 }
 
 WiFiDriver::CommandData WiFiDriver::handleClient() {
+  TRACE_POLL_SCOPE(TRACE_WIFI_POLL);
+
   CommandData cmd;
   cmd.isValid = false;
 
+  // Still choosing the channel or joining - nothing to accept clients on yet
+  if (link < WIFI_LINK_STATION && link != WIFI_LINK_OFF && !finishStart()) {
+    return cmd;
+  }
+  if (advertised) {
+    MDNS.update();
+  }
+
   // Check for new client connection
   if (!client || !client.connected()) {
     client = server.accept();
     if (client) {
-      Serial.println("[Client connected]");
+      LOG_INFO(EVT_CLIENT_CONNECTED);
+      TRACE_INSTANT(TRACE_CLIENT_CONNECTED, 0);
       // Reset state for new client
       bufferIndex = 0;
       isStartReceiving = false;
@@ -111,60 +316,23 @@ WiFiDriver::CommandData WiFiDriver::handleClient() {
 
     while (client.available()) {
       previousMillis = millis();
-      unsigned char receivedChar = client.read() & 0xff;
-      
-      isStandbyTriggered = false;
-      if (receivedChar == 200) {
-        isStandbyTriggered = true;
-      }
-
-      // Look for the special start sequence: 0xFF 0x55
-      if (receivedChar == 0x55 && !isStartReceiving) {
-        if (previousChar == 0xff) {
-          bufferIndex = 1;
-          isStartReceiving = true;
-        }
-      }
-      else {
-        previousChar = receivedChar;
-        if (isStartReceiving) {
-          if (bufferIndex == 2) {
-            dataLength = receivedChar; // Second byte tells us how long the message is
-          }
-          else if (bufferIndex > 2) {
-            dataLength--;
-          }
-          writeBuffer(bufferIndex, receivedChar); // Store the data
-        }
-      }
-
-      bufferIndex++;
-
-      // Prevent buffer overflow
-      if (bufferIndex > 120) {
-        bufferIndex = 0;
-        isStartReceiving = false;
-      }
-
-      // If we received a complete message, figure out what it means
-      if (isStartReceiving && dataLength == 0 && bufferIndex > 3) {
-        cmd = parseReceivedData();
-        isStartReceiving = false;
-        bufferIndex = 0;
+      if (feedByte(client.read() & 0xff, cmd)) {
         return cmd;
       }
     }
 
     // If we don't hear from the client for 3 seconds with a standby flag, go to standby
     if ((millis() - previousMillis) > timeoutDuration && client.available() == 0 && isStandbyTriggered == true) {
+      LOG_INFO(EVT_CLIENT_TIMEOUT);
       client.stop();
       cmd.action = 3; // CMD_STANDBY
       cmd.isValid = true;
       return cmd;
     }
 
-    // If the client disconnects from Wi-Fi, go to standby
-    if (WiFi.softAPgetStationNum() == 0) {
+    // If the client disconnects from Wi-Fi (or the robot lost the network), go to standby
+    if (isLinkLost()) {
+      LOG_INFO(EVT_CLIENT_DISCONNECTED, 1);
       client.stop();
       cmd.action = 3; // CMD_STANDBY
       cmd.isValid = true;
@@ -175,6 +343,62 @@ WiFiDriver::CommandData WiFiDriver::handleClient() {
   return cmd;
 }
 
+bool WiFiDriver::feedByte(unsigned char receivedChar, CommandData &cmd) {
+  isStandbyTriggered = false;
+  if (receivedChar == 200) {
+    isStandbyTriggered = true;
+  }
+
+  // Look for the special start sequence: 0xFF 0x55
+  if (receivedChar == 0x55 && !isStartReceiving) {
+    if (previousChar == 0xff) {
+      bufferIndex = 1;
+      isStartReceiving = true;
+    }
+  }
+  else {
+    previousChar = receivedChar;
+    if (isStartReceiving) {
+      if (bufferIndex == 2) {
+        dataLength = receivedChar; // Second byte tells us how long the message is
+      }
+      else if (bufferIndex > 2) {
+        dataLength--;
+      }
+      writeBuffer(bufferIndex, receivedChar); // Store the data
+    }
+  }
+
+  bufferIndex++;
+
+  // Prevent buffer overflow (a corrupt length byte would otherwise write past receiveBuffer)
+  if (bufferIndex >= sizeof(receiveBuffer)) {
+    LOG_WARN(EVT_FRAME_OVERFLOW, bufferIndex);
+    frameErrors++;
+    bufferIndex = 0;
+    isStartReceiving = false;
+  }
+
+  // If we received a complete message, figure out what it means
+  if (isStartReceiving && dataLength == 0 && bufferIndex > 3) {
+    frameLength = bufferIndex;
+    cmd = parseReceivedData();
+    isStartReceiving = false;
+    bufferIndex = 0;
+    return true;
+  }
+
+  return false;
+}
+
+uint8_t WiFiDriver::getPayload(uint8_t* out, uint8_t size) const {
+  uint8_t count = 0;
+  for (uint8_t i = WIFI_PAYLOAD_START; i < frameLength && count < size; i++) {
+    out[count++] = receiveBuffer[i];
+  }
+  return count;
+}
+
 void WiFiDriver::sendData(byte* data, size_t len) {
   if (client && client.connected()) {
     client.write(data, len);
@@ -184,3 +408,10 @@ void WiFiDriver::sendData(byte* data, size_t len) {
 bool WiFiDriver::isClientConnected() {
   return client && client.connected();
 }
+
+Print* WiFiDriver::getStream() {
+  if (isClientConnected()) {
+    return &client;
+  }
+  return nullptr;
+}
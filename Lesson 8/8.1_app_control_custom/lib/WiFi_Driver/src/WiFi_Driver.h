@@ -10,6 +10,9 @@
  * - Parses incoming data using a custom protocol format
  * - Extracts command data (action, device, movement type)
  * - Handles client timeouts and disconnections gracefully
+ * - Picks the least congested channel for the AP with a scan at boot (or uses a fixed one)
+ * - Can join an existing network instead (station mode) & falls back to the AP if that fails
+ * - Advertises the control port over mDNS, so host tools find every robot on the network
  * 
  * PROTOCOL FORMAT:
  * - Commands start with 0xFF 0x55 preamble
@@ -18,6 +21,29 @@
  *   - Byte 9: Action (e.g., CMD_RUN, CMD_STANDBY)
  *   - Byte 10: Device identifier
  *   - Byte 12: Movement type (for CMD_RUN commands)
+ *   - Bytes 11 & up: Payload of frames that carry more than that (getPayload(), e.g. a pose)
+ * - Streamed frames (action WIFI_STREAM_ACTION, 50 per second) are counted but not logged or
+ *   traced, they would flood the event log
+ * 
+ * CHANNEL SELECTION:
+ * - begin() with WIFI_AUTO_CHANNEL starts an asynchronous scan in station mode & returns,
+ *   handleClient() picks the channel & starts the AP once the scan is done (or failed)
+ * - Every access point found adds to the score of its own channel & the 3 channels on either
+ *   side (a 20 MHz channel overlaps them), weighted by its signal strength & the overlap.
+ *   The channel with the lowest score wins, ties go to 1, 6 & 11, then to the lower channel
+ * - Only channels 1-11 are used, phones set up for the US don't join 12 & 13
+ * - The AP count & score of every channel are kept for telemetry
+ * 
+ * STATION MODE & DISCOVERY:
+ * - beginStation() joins a network (DHCP, no credentials stored in flash, the SDK reconnects
+ *   on its own), handleClient() starts the server once the link is up. Not joined within
+ *   WIFI_JOIN_TIMEOUT_MS → the access point is started like begin() would
+ * - advertise() (before begin) sets the mDNS host name & the TXT records of the
+ *   _quadbot._tcp service: id (robot ID), model & caps (supported commands).
+ *   The service is announced on whichever link comes up, host tools (tools/fleet.py)
+ *   browse for it instead of needing a static IP per robot
+ * - In station mode the app connection ends with a standby when the robot loses the network,
+ *   in AP mode when the last station leaves the AP
  */
 
 
@@ -27,6 +53,28 @@
 // INCLUDES
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
+#include <ESP8266mDNS.h>
+
+// DEFINES
+#define WIFI_AUTO_CHANNEL     0     // begin(): pick the least congested channel
+#define WIFI_DEFAULT_CHANNEL  5     // Used when the scan fails
+#define WIFI_MAX_CHANNEL      11    // Highest channel the scan picks
+#define WIFI_SCAN_TIMEOUT_MS  5000  // Give up on the scan after this long
+#define WIFI_JOIN_TIMEOUT_MS  15000 // Fall back to the AP if the network isn't joined by then
+#define WIFI_CONTROL_PORT     100   // App & host tool connections
+#define WIFI_SERVICE          "quadbot"   // mDNS service (_quadbot._tcp)
+#define WIFI_ACTION_CODES     0x30  // Commands are counted per action below this, the rest together
+#define WIFI_STREAM_ACTION    0x28  // Pose stream frames (not logged)
+#define WIFI_PAYLOAD_START    11    // First payload byte of a frame
+
+// ENUMS
+enum WiFiLink : uint8_t {
+  WIFI_LINK_OFF,
+  WIFI_LINK_SCANNING,         // Choosing the AP channel
+  WIFI_LINK_JOINING,          // Joining the network
+  WIFI_LINK_STATION,          // Joined the network
+  WIFI_LINK_ACCESS_POINT      // Own access point
+};
 
 // CLASSES
 class WiFiDriver {
@@ -35,19 +83,44 @@ class WiFiDriver {
     struct CommandData {  
       int action;         // What to do (e.g., move forward, dance)
       int device;         // Which device (for future use, like lights)
-      int movementType;   // How to move (for movement commands)
+      int movementType;   // How to move (for movement commands), byte 12 of the others
       bool isValid;       // True if this is a real, complete command
     };
 
     // Public methods - these are the main functions you can use
-    void begin(const char* ssid, const char* password);  // Start Wi-Fi
+    void begin(const char* ssid, const char* password, uint8_t channel = WIFI_AUTO_CHANNEL);  // Start the AP (ssid & password must stay valid)
+    void beginStation(const char* networkSsid, const char* networkPassword,
+                      const char* ssid, const char* password, uint8_t channel = WIFI_AUTO_CHANNEL);  // Join a network, AP as fallback
+    void advertise(const char* hostname, const char* robotId, const char* capabilities);  // mDNS name & TXT records (must stay valid)
     CommandData handleClient();                          // Check for new commands
+    bool feedByte(unsigned char character, CommandData &cmd);  // Parse one received byte (true = cmd complete)
+    uint8_t getPayload(uint8_t* out, uint8_t size) const;  // Copy bytes 11+ of the last frame (count copied)
     void sendData(byte* data, size_t len);               // Send data back to app
     bool isClientConnected();                            // Check if app is connected
+    Print* getStream();                                  // Text output to the app (nullptr if not connected)
+
+    // Link & channel selection results
+    WiFiLink getLink() const { return link; }
+    bool isUp() const { return link >= WIFI_LINK_STATION; }  // Accepting app connections
+    bool isAdvertised() const { return advertised; }
+    const char* getHostname() const { return hostname; }
+    unsigned long getJoinMs() const { return joinMs; }
+    static const char* getLinkName(WiFiLink link);
+
+    // Received frames
+    unsigned long getCommandCount(uint8_t action) const { return action < WIFI_ACTION_CODES ? commandCounts[action] : 0; }
+    unsigned long getOtherCommands() const { return otherCommands; }   // Action codes >= WIFI_ACTION_CODES
+    unsigned long getFrameErrors() const { return frameErrors; }       // Frames dropped by the parser
+    uint8_t getChannel() const { return channel; }
+    bool isAutoChannel() const { return autoChannel; }
+    int getScanCount() const { return scanCount; }        // Access points found (-1 = scan failed)
+    unsigned long getScanMs() const { return scanMs; }
+    uint8_t getChannelAps(uint8_t ch) const { return ch <= WIFI_MAX_CHANNEL ? channelAps[ch] : 0; }
+    uint16_t getChannelScore(uint8_t ch) const { return ch <= WIFI_MAX_CHANNEL ? channelScore[ch] : 0; }
 
   private:
     // Network setup - server runs on port 100
-    WiFiServer server = WiFiServer(100);
+    WiFiServer server = WiFiServer(WIFI_CONTROL_PORT);
     WiFiClient client;
 
     // Variables for reading and understanding incoming data
@@ -55,13 +128,46 @@ class WiFiDriver {
     byte bufferIndex = 0;               // Where we are in the message
     char receiveBuffer[52];             // Where we store incoming data
     unsigned char previousChar = 0;     // Remember previous character
+    byte frameLength = 0;               // Bytes of the last complete message
     bool isStartReceiving = false;      // True when we find start of message
     bool isStandbyTriggered = false;    // True if standby command received
+    unsigned long commandCounts[WIFI_ACTION_CODES] = {};
+    unsigned long otherCommands = 0;
+    unsigned long frameErrors = 0;
+
+    // Link, access point & channel selection
+    WiFiLink link = WIFI_LINK_OFF;
+    const char* apSsid = nullptr;
+    const char* apPassword = nullptr;
+    const char* networkSsid = nullptr;
+    unsigned long joinStartMs = 0;
+    unsigned long joinMs = 0;
+    bool autoChannel = false;
+    uint8_t channel = 0;
+    int scanCount = 0;
+    unsigned long scanStartMs = 0;
+    unsigned long scanMs = 0;
+    uint8_t channelAps[WIFI_MAX_CHANNEL + 1] = {};
+    uint16_t channelScore[WIFI_MAX_CHANNEL + 1] = {};
+
+    // mDNS
+    const char* hostname = nullptr;
+    const char* robotId = nullptr;
+    const char* capabilities = nullptr;
+    bool advertised = false;
 
     // Helper methods (used internally)
     unsigned char readBuffer(int index);
     void writeBuffer(int index, unsigned char character);
     CommandData parseReceivedData();
+    bool finishStart();
+    bool finishScan();
+    bool finishJoin();
+    uint8_t scoreChannels(int networks);
+    void startScan();
+    void startAccessPoint();
+    void startServer();
+    bool isLinkLost();
 };
 
 #endif
@@ -7,6 +7,57 @@
  * - When a command arrives, it figures out which movement to run, tells the movement system
  *   to perform the requested action and sends a response back to the control app
  * - The update() function keeps the movements smooth and continuous
+ * - loop() only runs the task scheduler: robot.update() is the highest priority task,
+ *   followed by the app commands and the lower priority diagnostic jobs
+ * - Build with MOTION_TICK_HZ (e.g. 50) to compute the servo frames from a fixed rate Ticker,
+ *   so Wi-Fi handling in loop() can't delay the movements
+ * - Build with SERVO_STAGGER_MS (e.g. 8) to start the servos of each step one after another,
+ *   which avoids brownout resets when the battery sags during push ups & fighting
+ * - After lie down & sleep the servos are detached once their angle hasn't changed for
+ *   SERVO_IDLE_DETACH_MS (0 = keep driving them), the next command attaches them again
+ * - The power manager runs the CPU at 160 MHz while moving or commanded & at 80 MHz otherwise,
+ *   and lowers the TX power while nobody is connected ('w' prints the time per power level)
+ * - CMD_PARK (or 'z') lies the robot down & deep sleeps until the reset button is pressed, the pose
+ *   is kept in RTC memory so the robot wakes up at that pose & glides to ready instead of jumping
+ * - Commands & motion events are logged as binary Event_Log records and printed in idle time,
+ *   decode a Serial Monitor capture with tools/decode_event_log.py ('e' pauses / resumes the
+ *   Serial output, CMD_EVENT_LOG dumps the buffered records over Wi-Fi)
+ * - loop(), wifi.handleClient() & every servo frame (also from the Ticker) are timed by the latency profiler,
+ *   the histograms are printed with 'p' in the Serial Monitor or the CMD_PROFILE action
+ * - A telemetry report (odometry, motion state) can be requested over Wi-Fi with the
+ *   CMD_TELEMETRY action, or by sending 't' in the Serial Monitor
+ * - The last few hundred loop(), Wi-Fi & motion events are kept by the trace recorder,
+ *   'd' in the Serial Monitor or CMD_TRACE dumps them for tools/trace_to_chrome.py
+ * - Free heap, fragmentation & the stack high-water mark are sampled every second, crossing
+ *   a threshold logs EVT_MEMORY_WARNING ('m' prints the memory report)
+ * - Choreography files in LittleFS (.qds files in data/seq, uploaded with "pio run -t uploadfs") are
+ *   loaded at boot & play like the built-in sequences, CMD_PLAY starts any sequence by ID
+ *   ('c' lists the loaded files)
+ * - Boot goes straight to the ready pose, Wi-Fi & the choreography files are started by a one-shot
+ *   task once the pose is written (after a park: once the glide to it is over), the "boot"
+ *   telemetry section has the boot-to-ready, boot-to-Wi-Fi & boot-to-first-command times
+ *   (ms since reset)
+ * - The access point uses the least congested channel found by a scan at boot, build with
+ *   WIFI_CHANNEL (1-13) to use a fixed channel instead, the "wifi" telemetry section has the
+ *   chosen channel & the access points seen per channel
+ * - Build with WIFI_STA_SSID & WIFI_STA_PASSWORD to join an existing network instead (the AP is
+ *   the fallback), every robot announces itself as quadbot-<chip ID>.local with a _quadbot._tcp
+ *   mDNS service, so one host can find & control a whole fleet (tools/fleet.py)
+ * - GET /metrics on port METRICS_PORT serves commands per action, frame errors, dropped commands,
+ *   completed sequences, loop times, heap, uptime, RSSI & stations in the Prometheus text format
+ *   ("python3 tools/fleet.py targets" writes the scrape targets of every robot found)
+ * - Robots on the same network share a show clock over UDP (port SHOW_SYNC_PORT): CMD_SHOW makes
+ *   this robot the master & starts a sequence on every robot at the same moment, the step
+ *   deadlines are kept on the show clock so they stay together (tools/show_master.py can be
+ *   the master from a PC instead)
+ * - The dances are authored in beats & play at TEMPO_BPM, CMD_TEMPO sets another tempo (it takes
+ *   effect on the next beat of a dance that is playing, so the robot stays on the music)
+ * - CMD_POSE frames stream raw poses from a host (tools/pose_stream.py, 50 Hz): they are played
+ *   out after a small adaptive jitter buffer, bypassing the sequences, & every played frame is
+ *   echoed back so the host can measure the latency. Any motion command ends the stream
+ * - Teach mode: CMD_RECORD records the pose the servos are commanded to (jogged a joint at a
+ *   time with CMD_JOG, or streamed) as keyframes, CMD_SAVE writes them to LittleFS as a named
+ *   sequence that plays at once & after a reboot (tools/teach.py, 'k' prints the keyframes)
  */
 
 
@@ -14,6 +65,18 @@
 #include <Arduino.h>
 #include "Movement_Driver.h"
 #include "WiFi_Driver.h"
+#include "Telemetry.h"
+#include "Task_Scheduler.h"
+#include "Latency_Profiler.h"
+#include "Event_Log.h"
+#include "Memory_Monitor.h"
+#include "Trace_Recorder.h"
+#include "Sequence_Library.h"
+#include "Power_Manager.h"
+#include "Metrics_Server.h"
+#include "Show_Sync.h"
+#include "Pose_Stream.h"
+#include "Teach_Recorder.h"
 
 // DEFINES
 #define CMD_RUN       1   // Movement command (walk, turn, etc.)
@@ -27,13 +90,91 @@
 #define CMD_DANCE2    11  // Dance routine 2
 #define CMD_DANCE3    12  // Dance routine 3
 
+// Diagnostic commands (not used by the ACEBOTT app, sent by host tools)
+#define CMD_TELEMETRY 0x20  // Send a telemetry report back as text
+#define CMD_PROFILE   0x21  // Send the latency histograms back as text
+#define CMD_EVENT_LOG 0x22  // Send the buffered event log records back
+#define CMD_TRACE     0x23  // Send the trace recorder buffer back
+#define CMD_PLAY      0x24  // Play a built-in or loaded sequence (sequence ID in the device byte)
+#define CMD_PARK      0x25  // Lie down & deep sleep until the reset button is pressed
+#define CMD_SHOW      0x26  // Lead a show: every robot plays a sequence (ID in the device byte) at the same time,
+                            // movement type = lead time in 100 ms units (0 = SHOW_DEFAULT_LEAD_MS)
+#define CMD_TEMPO     0x27  // Tempo of the dances & beat-timed sequences (BPM: device byte = low byte, byte 12 = high byte)
+#define CMD_POSE      WIFI_STREAM_ACTION  // 0x28 - one pose of a live stream (payload in Pose_Stream.h)
+#define CMD_RECORD    0x29  // Teach mode - device byte 1 = start (tolerance in degrees in byte 12, 0 = default),
+                            // 0 = stop, 2 = discard the keyframes
+#define CMD_SAVE      0x2A  // Save the recording as a sequence (name from byte 11), replies with the result as text
+#define CMD_JOG       0x2B  // Move one joint (position array column in the device byte) by the signed degrees in byte 12
+
+// Motion timing - 0 = robot.update() from loop(), otherwise frames per second from a Ticker
+#ifndef MOTION_TICK_HZ
+#define MOTION_TICK_HZ 0
+#endif
+
+// Servo start stagger within a step in ms - 0 = all servos at once (e.g. 8 for weak battery packs)
+#ifndef SERVO_STAGGER_MS
+#define SERVO_STAGGER_MS 0
+#endif
+
+// Time in ms a joint of a passive pose (lie down, sleep) holds still before it is detached - 0 = never
+#ifndef SERVO_IDLE_DETACH_MS
+#define SERVO_IDLE_DETACH_MS 3000
+#endif
+
+// Access point channel - 0 = scan at boot & pick the least congested one
+#ifndef WIFI_CHANNEL
+#define WIFI_CHANNEL WIFI_AUTO_CHANNEL
+#endif
+
+// Existing network to join (station mode) - WIFI_STA_SSID not set = run the access point
+#if defined(WIFI_STA_SSID) && !defined(WIFI_STA_PASSWORD)
+#define WIFI_STA_PASSWORD ""
+#endif
+
+// Commands announced in the mDNS "caps" record, for host tools
+#define ROBOT_CAPABILITIES "move,telemetry,profile,events,trace,play,park,metrics,show,tempo,stream,teach"
+
+// HTTP port of the /metrics endpoint - 0 = no metrics server
+#ifndef METRICS_PORT
+#define METRICS_PORT 80
+#endif
+
+// Tempo of the beat-timed sequences at boot (TEMPO_DEFAULT_BPM = the dances' original timing)
+#ifndef TEMPO_BPM
+#define TEMPO_BPM TEMPO_DEFAULT_BPM
+#endif
+
+// UDP port of the show clock beacons - 0 = no show sync (the motion clock stays millis())
+#ifndef SHOW_SYNC_PORT
+#define SHOW_SYNC_PORT SHOW_DEFAULT_PORT
+#endif
+
 // GLOBAL VARIABLES
 const char* ssid = "QuadBot";
 const char* password = "12345678";
+char robotId[9];            // Chip ID in hex - the mDNS ID of this robot
+char hostname[20];          // quadbot-<robotId>
+bool logToSerial = true;    // Stream event log records to the Serial Monitor
+
+// Boot timing - millis() at each milestone (0 = not reached yet)
+unsigned long bootReadyMs = 0;          // Ready pose reached (fully written, the glide after a park is over)
+unsigned long bootWiFiMs = 0;           // Access point & command server started
+unsigned long bootFirstCommandMs = 0;   // First valid command from the app
 
 // Create driver instances
 MovementDriver robot;
 WiFiDriver wifi;
+Telemetry telemetry;
+TaskScheduler scheduler;
+MemoryMonitor memory;
+SequenceLibrary choreography;
+PowerManager power;
+MetricsServer metrics;
+ShowSync show;
+PoseStream stream;
+TeachRecorder teach;
+unsigned long teachSaves = 0;                   // Recordings saved since boot
+SequenceLoadResult lastSaveResult = SEQ_LOADED;
 
 // Response messages to send back to the app - Format: {0xFF, 0x55, length, device, action}
 byte callbackForwardPackage[5]    =  {0xff, 0x55, 0x02, 0x01, 0x01};
@@ -52,36 +193,452 @@ byte callbackDance1Package[5]     =  {0xff, 0x55, 0x02, 0x01, 0x0d};
 byte callbackDance2Package[5]     =  {0xff, 0x55, 0x02, 0x01, 0x0e};
 byte callbackDance3Package[5]     =  {0xff, 0x55, 0x02, 0x01, 0x0f};
 
+// Played pose stream frame - Format: {0xFF, 0x55, length, device, CMD_POSE, sequence (2), held ms (2)}
+byte callbackPosePackage[9]       =  {0xff, 0x55, 0x06, 0x01, CMD_POSE, 0x00, 0x00, 0x00, 0x00};
 
-// SETUP
-void setup() {
-  Serial.begin(115200);
-  delay(100);
 
-  Serial.println("\n=================================================================");
-  Serial.println("Starting ACEBOTT QD020 Quadruped Bionic Spider Robot App Control.");
-  Serial.println("=================================================================");
+// TELEMETRY SECTIONS
+void reportMotion(Telemetry &t) {
+  t.field("state", (int)robot.getState());
+  t.field("sequence", robot.getSequenceName(robot.getSequenceId()));
+  t.field("busy", robot.isBusy() ? 1 : 0);
+  t.field("speed", robot.getSpeedFactor());
+  t.field("tempo_bpm", (unsigned int)robot.getTempo());
+  t.field("tempo_pending", robot.isTempoPending() ? 1 : 0);
+  t.field("timed", robot.isTimed() ? 1 : 0);
+  t.field("stagger_ms", robot.getWriteStagger());
+  t.field("detached", (unsigned int)robot.getDetachedJoints());
+  t.field("detaches", robot.getDetachCount());
+  t.field("dropped_cmds", robot.getDroppedCommands());
+}
 
-  // Initialize Wi-Fi
-  wifi.begin(ssid, password);
+void reportBoot(Telemetry &t) {
+  t.field("reset_reason", (unsigned int)ESP.getResetInfoPtr()->reason);
+  t.field("resumed", power.wasResumed() ? 1 : 0);
+  t.field("ready_ms", bootReadyMs);
+  t.field("wifi_ms", bootWiFiMs);
+  t.field("first_cmd_ms", bootFirstCommandMs);
+}
 
-  // Initialize movement driver
-  Serial.println("\nInitializing movement driver...");
-  robot.begin();
+void reportOdometry(Telemetry &t) {
+  Odometry odo = robot.getOdometry();
+  t.field("x_mm", odo.xMm, 1);
+  t.field("y_mm", odo.yMm, 1);
+  t.field("heading_deg", odo.headingDeg, 1);
+  t.field("distance_mm", odo.distanceMm, 1);
+  t.field("cycles", odo.cycles);
+}
 
-  // Start in standby mode
-  robot.standby();
-  Serial.println("Robot initialized in standby mode");
-  Serial.println("Setup Complete!");
+void reportStepTiming(Telemetry &t) {
+  unsigned long lateSteps = 0, skippedSteps = 0, maxLateMs = 0;
+  for (int state = STANDBY; state <= CUSTOM; state++) {
+    const StepTiming &timing = robot.getStepTiming((MovementState)state);
+    lateSteps += timing.lateSteps;
+    skippedSteps += timing.skippedSteps;
+    if (timing.maxLateMs > maxLateMs) maxLateMs = timing.maxLateMs;
+  }
+  t.field("late_steps", lateSteps);
+  t.field("skipped_steps", skippedSteps);
+  t.field("max_late_ms", maxLateMs);
 }
 
-// MAIN LOOP
-void loop() {
-  // Check the client for a new command
+void reportChoreography(Telemetry &t) {
+  t.field("loaded", (unsigned int)choreography.getLoaded());
+  t.field("rejected", (unsigned int)choreography.getRejected());
+  t.field("bytes", (unsigned long)choreography.getBytes());
+  t.field("underruns", choreography.getUnderruns());
+  t.field("read_errors", robot.getReadErrors());
+}
+
+void reportPower(Telemetry &t) {
+  t.field("level", PowerManager::getLevelName(power.getLevel()));
+  t.field("cpu_mhz", (unsigned int)ESP.getCpuFreqMHz());
+  t.field("stations", (unsigned int)WiFi.softAPgetStationNum());
+  t.field("active_s", power.getResidencyMs(POWER_ACTIVE) / 1000);
+  t.field("idle_s", power.getResidencyMs(POWER_IDLE) / 1000);
+  t.field("low_s", power.getResidencyMs(POWER_LOW) / 1000);
+  t.field("avg_ma", power.getAverageCurrent(), 1);
+  t.field("wake_us", (unsigned long)power.getLastWakeUs());
+  t.field("max_wake_us", (unsigned long)power.getMaxWakeUs());
+}
+
+void reportWiFi(Telemetry &t) {
+  t.field("link", WiFiDriver::getLinkName(wifi.getLink()));
+  t.field("id", robotId);
+  t.field("mdns", wifi.isAdvertised() ? hostname : "none");
+  if (wifi.getLink() == WIFI_LINK_STATION) {
+    t.field("ip", WiFi.localIP().toString().c_str());
+    t.field("rssi_dbm", (long)WiFi.RSSI());
+    t.field("join_ms", wifi.getJoinMs());
+  }
+  t.field("channel", (unsigned int)wifi.getChannel());
+  t.field("auto", wifi.isAutoChannel() ? "yes" : "no");
+  t.field("scan_aps", wifi.getScanCount());
+  t.field("scan_ms", wifi.getScanMs());
+
+  // Access points & score per channel, channel 1 first
+  char aps[4 * WIFI_MAX_CHANNEL + 1] = "";
+  char scores[6 * WIFI_MAX_CHANNEL + 1] = "";
+  int apsLength = 0;
+  int scoresLength = 0;
+  for (uint8_t ch = 1; ch <= WIFI_MAX_CHANNEL; ch++) {
+    const char* separator = ch > 1 ? "," : "";
+    apsLength += snprintf(aps + apsLength, sizeof(aps) - apsLength, "%s%u", separator, wifi.getChannelAps(ch));
+    scoresLength += snprintf(scores + scoresLength, sizeof(scores) - scoresLength, "%s%u", separator, wifi.getChannelScore(ch));
+  }
+  t.field("channel_aps", aps);
+  t.field("channel_scores", scores);
+}
+
+void reportEventLog(Telemetry &t) {
+  t.field("pending", (unsigned int)eventLog.pending());
+  t.field("dropped", eventLog.getDropped());
+}
+
+void reportMemory(Telemetry &t) {
+  const MemorySample &last = memory.getLast();
+  const MemorySample &worst = memory.getWorst();
+  t.field("free_heap", (unsigned long)last.freeHeap);
+  t.field("min_free_heap", (unsigned long)worst.freeHeap);
+  t.field("frag_pct", (unsigned int)last.fragmentation);
+  t.field("max_frag_pct", (unsigned int)worst.fragmentation);
+  t.field("max_block", (unsigned long)last.maxFreeBlock);
+  t.field("min_max_block", (unsigned long)worst.maxFreeBlock);
+  t.field("min_free_stack", (unsigned long)worst.freeStack);
+  t.field("warnings", (unsigned int)memory.getWarnings());
+}
+
+void reportShow(Telemetry &t) {
+  char master[9];
+  snprintf(master, sizeof(master), "%06x", (unsigned int)show.getMasterId());
+  t.field("role", ShowSync::getRoleName(show.getRole()));
+  t.field("master", master);
+  t.field("locked", show.isLocked() ? 1 : 0);
+  t.field("offset_ms", show.getOffset());
+  t.field("error_ms", show.getError());
+  t.field("spread_ms", show.getSpread());
+  t.field("beacons", show.getBeacons());
+  t.field("rejected", show.getRejected());
+  t.field("jumps", show.getJumps());
+  t.field("starts", show.getStarts());
+  t.field("missed_starts", show.getMissedStarts());
+  t.field("conflicts", show.getConflicts());
+}
+
+void reportStream(Telemetry &t) {
+  const StreamStats &stats = stream.getStats();
+  t.field("active", stream.isActive() ? 1 : 0);
+  t.field("delay_ms", stream.getDelay());
+  t.field("jitter_ms", stream.getJitter());
+  t.field("interval_ms", stream.getInterval());
+  t.field("buffered", (unsigned int)stream.getBuffered());
+  t.field("streams", stats.streams);
+  t.field("frames", stats.frames);
+  t.field("played", stats.played);
+  t.field("late", stats.late);
+  t.field("duplicates", stats.duplicates);
+  t.field("overflows", stats.overflows);
+  t.field("concealed", stats.concealed);
+  t.field("underruns", stats.underruns);
+  t.field("extrapolated_ms", stats.extrapolatedMs);
+  t.field("avg_hold_ms", stats.played ? stats.totalHoldMs / stats.played : 0UL);
+  t.field("max_hold_ms", stats.maxHoldMs);
+}
+
+void reportTeach(Telemetry &t) {
+  t.field("recording", teach.isRecording() ? 1 : 0);
+  t.field("steps", (unsigned int)teach.getStepCount());
+  t.field("duration_ms", teach.getDurationMs());
+  t.field("tolerance_deg", (unsigned int)teach.getTolerance());
+  t.field("merged", teach.getMerged());
+  t.field("full", teach.isFull() ? 1 : 0);
+  t.field("saves", teachSaves);
+  t.field("last_save", SequenceLibrary::getResultName(lastSaveResult));
+}
+
+void reportMetrics(Telemetry &t) {
+  t.field("scrapes", metrics.getScrapes());
+  t.field("busy", metrics.getBusy());
+  t.field("truncated", metrics.getTruncated());
+  t.field("bytes", (unsigned long)metrics.getLength());
+  t.field("render_us", (unsigned long)metrics.getRenderUs());
+}
+
+#if LATENCY_PROFILER_ENABLED
+void reportLatency(Telemetry &t) {
+  const LatencyHistogram &loopTime = profiler.get(PROFILE_LOOP);
+  t.field("loop_p50_us", loopTime.percentile(50));
+  t.field("loop_p99_us", loopTime.percentile(99));
+  t.field("loop_max_us", loopTime.getMax());
+  t.field("loop_stalls", loopTime.getStalls());
+  t.field("wifi_p99_us", profiler.get(PROFILE_WIFI).percentile(99));
+  t.field("motion_p99_us", profiler.get(PROFILE_MOTION).percentile(99));
+}
+#endif
+
+
+// Metric collectors for the /metrics endpoint
+void collectSystem(MetricsServer &m) {
+  m.family("info", "gauge", "Robot ID (the mDNS id record), always 1");
+  m.sample("info", "id", robotId, 1);
+  m.family("uptime_seconds", "counter", "Time since boot");
+  m.sample("uptime_seconds", millis() / 1000);
+  m.family("free_heap_bytes", "gauge", "Free heap");
+  m.sample("free_heap_bytes", ESP.getFreeHeap());
+  m.family("max_free_block_bytes", "gauge", "Largest block that can be allocated");
+  m.sample("max_free_block_bytes", ESP.getMaxFreeBlockSize());
+  m.family("heap_fragmentation_percent", "gauge", "Heap fragmentation");
+  m.sample("heap_fragmentation_percent", ESP.getHeapFragmentation());
+  m.family("power_level", "gauge", "Power level (0 = active, 1 = idle, 2 = low)");
+  m.sample("power_level", power.getLevel());
+  m.family("event_log_dropped_total", "counter", "Event log records lost to a full buffer");
+  m.sample("event_log_dropped_total", eventLog.getDropped());
+}
+
+void collectWiFi(MetricsServer &m) {
+  m.family("wifi_stations", "gauge", "Stations on the access point");
+  m.sample("wifi_stations", WiFi.softAPgetStationNum());
+  m.family("wifi_channel", "gauge", "Wi-Fi channel");
+  m.sample("wifi_channel", wifi.getChannel());
+  if (wifi.getLink() == WIFI_LINK_STATION) {
+    m.family("wifi_rssi_dbm", "gauge", "Signal strength of the joined network");
+    m.sample("wifi_rssi_dbm", WiFi.RSSI());
+  }
+
+  char action[5];
+  m.family("commands_total", "counter", "Commands received per action code");
+  for (uint8_t code = 0; code < WIFI_ACTION_CODES; code++) {
+    unsigned long count = wifi.getCommandCount(code);
+    if (count == 0) continue;
+    snprintf(action, sizeof(action), "0x%02X", code);
+    m.sample("commands_total", "action", action, count);
+  }
+  if (wifi.getOtherCommands() > 0) {
+    m.sample("commands_total", "action", "other", wifi.getOtherCommands());
+  }
+  m.family("frame_errors_total", "counter", "Frames dropped by the protocol parser");
+  m.sample("frame_errors_total", wifi.getFrameErrors());
+}
+
+void collectMotion(MetricsServer &m) {
+  m.family("sequences_completed_total", "counter", "Sequences played to the last step");
+  for (int state = STANDBY; state <= CUSTOM; state++) {
+    unsigned long count = robot.getCompleted((MovementState)state);
+    if (count == 0) continue;
+    m.sample("sequences_completed_total", "state", MovementDriver::getStateName((MovementState)state), count);
+  }
+  m.family("motion_commands_dropped_total", "counter", "Commands lost to a full motion queue");
+  m.sample("motion_commands_dropped_total", robot.getDroppedCommands());
+  m.family("step_read_errors_total", "counter", "Sequences cut short by a step that couldn't be read");
+  m.sample("step_read_errors_total", robot.getReadErrors());
+  m.family("tempo_bpm", "gauge", "Tempo of the beat-timed sequences");
+  m.sample("tempo_bpm", robot.getTempo());
+}
+
+void collectShow(MetricsServer &m) {
+  m.family("show_locked", "gauge", "1 while on the show clock (master or recent beacon)");
+  m.sample("show_locked", show.isLocked() ? 1 : 0);
+  m.family("show_offset_ms", "gauge", "Show clock - local clock");
+  m.sample("show_offset_ms", show.getOffset());
+  m.family("show_error_ms", "gauge", "Offset estimate - offset after the last beacon");
+  m.sample("show_error_ms", show.getError());
+  m.family("show_beacons_total", "counter", "Show beacons sent (master) or accepted (follower)");
+  m.sample("show_beacons_total", show.getBeacons());
+  m.family("show_starts_total", "counter", "Show start orders played");
+  m.sample("show_starts_total", show.getStarts());
+}
+
+void collectStream(MetricsServer &m) {
+  const StreamStats &stats = stream.getStats();
+  m.family("stream_active", "gauge", "1 while a pose stream is playing");
+  m.sample("stream_active", stream.isActive() ? 1 : 0);
+  m.family("stream_delay_ms", "gauge", "Playout delay of the pose stream");
+  m.sample("stream_delay_ms", stream.getDelay());
+  m.family("stream_jitter_ms", "gauge", "Arrival spread of the recent pose frames");
+  m.sample("stream_jitter_ms", stream.getJitter());
+  m.family("stream_frames_total", "counter", "Pose frames received");
+  m.sample("stream_frames_total", stats.frames);
+  m.family("stream_frames_dropped_total", "counter", "Pose frames dropped");
+  m.sample("stream_frames_dropped_total", "reason", "late", stats.late);
+  m.sample("stream_frames_dropped_total", "reason", "duplicate", stats.duplicates);
+  m.sample("stream_frames_dropped_total", "reason", "overflow", stats.overflows);
+  m.family("stream_concealed_total", "counter", "Missing pose frames interpolated over");
+  m.sample("stream_concealed_total", stats.concealed);
+  m.family("stream_underruns_total", "counter", "Times the playout ran past the newest pose frame");
+  m.sample("stream_underruns_total", stats.underruns);
+}
+
+#if LATENCY_PROFILER_ENABLED
+void collectLatency(MetricsServer &m) {
+  const LatencyHistogram &loopTime = profiler.get(PROFILE_LOOP);
+  m.family("loop_time_us", "summary", "Time of one pass through loop()");
+  m.sample("loop_time_us", "quantile", "0.5", loopTime.percentile(50));
+  m.sample("loop_time_us", "quantile", "0.9", loopTime.percentile(90));
+  m.sample("loop_time_us", "quantile", "0.99", loopTime.percentile(99));
+  m.sample("loop_time_us_sum", loopTime.getTotal());
+  m.sample("loop_time_us_count", loopTime.getCount());
+  m.family("loop_time_max_us", "gauge", "Longest pass through loop()");
+  m.sample("loop_time_max_us", loopTime.getMax());
+  m.family("loop_stalls_total", "counter", "Passes through loop() over the stall threshold");
+  m.sample("loop_stalls_total", loopTime.getStalls());
+}
+#endif
+
+
+// Print the step lateness statistics of every sequence that has run
+void printStepTiming(Print &out) {
+  out.println("SEQUENCE      STEPS   LATE  SKIPPED  RESYNCS  AVG_LATE_MS  MAX_LATE_MS");
+
+  char line[80];
+  for (int state = STANDBY; state <= CUSTOM; state++) {
+    const StepTiming &timing = robot.getStepTiming((MovementState)state);
+    if (timing.steps == 0) continue;
+
+    snprintf(line, sizeof(line), "%-11s %7lu %6lu %8lu %8lu %12lu %12lu",
+             MovementDriver::getStateName((MovementState)state), timing.steps, timing.lateSteps,
+             timing.skippedSteps, timing.resyncs, timing.totalLateMs / timing.steps, timing.maxLateMs);
+    out.println(line);
+  }
+}
+
+
+// Called by the memory monitor when a threshold is crossed
+void onMemoryWarning(uint8_t newWarnings, const MemorySample &sample) {
+  LOG_WARN(EVT_MEMORY_WARNING, newWarnings, min(sample.freeHeap, (uint32_t)0xFFFF),
+           min(sample.maxFreeBlock, (uint32_t)0xFFFF));
+}
+
+
+// Echo a played pose stream frame to the host, with the time it spent in the jitter buffer
+void onStreamPlayed(uint16_t sequence, unsigned long heldMs) {
+  heldMs = min(heldMs, 0xFFFFUL);
+  callbackPosePackage[5] = sequence;
+  callbackPosePackage[6] = sequence >> 8;
+  callbackPosePackage[7] = heldMs;
+  callbackPosePackage[8] = heldMs >> 8;
+  wifi.sendData(callbackPosePackage, sizeof(callbackPosePackage));
+}
+
+// A task that didn't get a slot would silently never run
+void checkTask(int taskId, const char* name) {
+  if (taskId >= 0) return;
+  LOG_ERROR(EVT_TASK_REJECTED, TaskScheduler::MAX_TASKS);
+  Serial.print("Task table full, not running: ");
+  Serial.println(name);
+}
+
+// Commands that move the robot (they end a pose stream)
+bool isMotionCommand(int action) {
+  return action < CMD_TELEMETRY || action == CMD_PLAY || action == CMD_PARK || action == CMD_SHOW ||
+         action == CMD_JOG;
+}
+
+// Move one joint from the pose it is commanded to - a sequence that is playing stops there
+void jogJoint(uint8_t joint, int8_t degrees) {
+  if (joint >= 8) return;
+  int pose[8];
+  robot.getCommandedPose(pose);
+  if (pose[joint] < 0) return;
+  if (robot.isBusy()) robot.idle(0);
+  pose[joint] = constrain(pose[joint] + degrees, 0, 180);
+  robot.writePose(pose);
+}
+
+// Save the recording under the name in the frame payload & reply with the result
+void saveRecording(Print* reply) {
+  char name[16];
+  uint8_t size = wifi.getPayload((uint8_t*)name, sizeof(name) - 1);
+  name[size] = '\0';
+
+  teach.stop();
+  lastSaveResult = choreography.save(robot, name, teach.getSteps(), teach.getStepCount());
+  int id = robot.findSequence(name);
+  LOG_INFO(EVT_SEQUENCE_SAVED, lastSaveResult == SEQ_LOADED ? id : 0, teach.getStepCount(), lastSaveResult);
+  if (lastSaveResult == SEQ_LOADED) teachSaves++;
+  if (!reply) return;
+
+  if (lastSaveResult != SEQ_LOADED) {
+    reply->print("Save failed: ");
+    reply->println(SequenceLibrary::getResultName(lastSaveResult));
+    return;
+  }
+  char line[48];
+  snprintf(line, sizeof(line), "Saved %s as ID %d, %u steps", name, id, teach.getStepCount());
+  reply->println(line);
+  teach.print(*reply);
+}
+
+
+// TASKS
+// Single character commands from the Serial Monitor
+void handleSerialCommands() {
+  while (Serial.available()) {
+    switch (Serial.read()) {
+      case 't':
+        telemetry.report(Serial);
+        break;
+      case 'o':
+        robot.resetOdometry();
+        Serial.println("Odometry reset");
+        break;
+      case 's':
+        scheduler.report(Serial);
+        break;
+      case 'p':
+        profiler.report(Serial);
+        break;
+      case 'l':
+        printStepTiming(Serial);
+        break;
+      case 'm':
+        memory.report(Serial);
+        break;
+      case 'd':
+        trace.dump(Serial);
+        break;
+      case 'c':
+        choreography.report(Serial);
+        break;
+      case 'w':
+        power.report(Serial);
+        break;
+      case 'z':
+        Serial.println("Parking - press reset to wake up");
+        power.park();
+        break;
+      case 'e':
+        logToSerial = !logToSerial;
+        Serial.println(logToSerial ? "Event log output on" : "Event log output paused");
+        break;
+      case 'k':
+        teach.print(Serial);
+        break;
+      case 'r':
+        profiler.reset();
+        scheduler.resetStats();
+        robot.resetStepTiming();
+        Serial.println("Statistics reset");
+        break;
+    }
+  }
+}
+
+// Check the client for a new command & run it
+void handleCommands() {
+  PROFILE_BEGIN(PROFILE_WIFI);
   WiFiDriver::CommandData cmd = wifi.handleClient();
+  PROFILE_END(PROFILE_WIFI);
+  if (bootWiFiMs == 0 && wifi.isUp()) {
+    bootWiFiMs = millis();
+  }
 
   // If we received a valid command, process it
   if (cmd.isValid) {
+    if (bootFirstCommandMs == 0) bootFirstCommandMs = millis();
+    power.notifyActivity();   // Full clock before the command runs
+    if (stream.isActive() && isMotionCommand(cmd.action)) {
+      stream.stop();
+    }
     switch(cmd.action) {
       case CMD_RUN:
         // // Movement commands (walking, turning)
@@ -150,9 +707,222 @@ void loop() {
         robot.dance3();
         wifi.sendData(callbackDance3Package, 5);
         break;
+
+      // Diagnostic commands
+      case CMD_TELEMETRY:
+        if (Print* stream = wifi.getStream()) {
+          telemetry.report(*stream);
+        }
+        break;
+      case CMD_PROFILE:
+        if (Print* stream = wifi.getStream()) {
+          profiler.report(*stream);
+        }
+        break;
+      case CMD_EVENT_LOG:
+        if (Print* stream = wifi.getStream()) {
+          eventLog.dump(*stream);
+        }
+        break;
+      case CMD_TRACE:
+        if (Print* stream = wifi.getStream()) {
+          trace.dump(*stream);
+        }
+        break;
+      case CMD_PLAY:
+        robot.play((uint8_t)cmd.device);
+        break;
+      case CMD_PARK:
+        power.park();
+        break;
+      case CMD_SHOW:
+        show.lead();
+        show.start((uint8_t)cmd.device, cmd.movementType ? cmd.movementType * 100UL : SHOW_DEFAULT_LEAD_MS);
+        break;
+      case CMD_TEMPO:
+        robot.setTempo((uint16_t)((cmd.movementType & 0xFF) << 8 | (cmd.device & 0xFF)));
+        break;
+      case CMD_POSE: {
+        uint8_t payload[STREAM_FRAME_SIZE];
+        stream.receive(payload, wifi.getPayload(payload, sizeof(payload)), millis());
+        break;
+      }
+      case CMD_RECORD:
+        if (cmd.device == 1) {
+          teach.start(cmd.movementType ? cmd.movementType : TEACH_DEFAULT_TOLERANCE_DEG);
+        }
+        else if (cmd.device == 2) {
+          teach.clear();
+        }
+        else {
+          teach.stop();
+        }
+        break;
+      case CMD_SAVE:
+        saveRecording(wifi.getStream());
+        break;
+      case CMD_JOG:
+        jogJoint((uint8_t)cmd.device, (int8_t)cmd.movementType);
+        break;
     }
   }
-  
-  // Update robot movements
+}
+
+// Send event log records to the Serial Monitor while nothing else is due
+void flushEventLog() {
+  if (logToSerial) {
+    eventLog.flush(Serial);
+  }
+}
+
+// Sample heap & stack usage
+void sampleMemory() {
+  memory.sample();
+}
+
+// Pick the power level for what the robot is doing
+void updatePower() {
+  power.update();
+}
+
+// Receive / send the show clock beacons
+void updateShow() {
+  show.update();
+}
+
+// Motion clock of the robot - the show clock (millis() until a master is heard)
+unsigned long showClock() {
+  return show.now();
+}
+
+// Load the choreography files & start Wi-Fi (runs once, after the boot pose is written)
+// The link comes up from handleCommands() once the network is joined or the channel scan is done
+void startServices() {
+  choreography.begin(robot);
+  snprintf(robotId, sizeof(robotId), "%06x", (unsigned int)ESP.getChipId());
+  snprintf(hostname, sizeof(hostname), "quadbot-%s", robotId);
+  wifi.advertise(hostname, robotId, ROBOT_CAPABILITIES);
+#ifdef WIFI_STA_SSID
+  wifi.beginStation(WIFI_STA_SSID, WIFI_STA_PASSWORD, ssid, password, WIFI_CHANNEL);
+#else
+  wifi.begin(ssid, password, WIFI_CHANNEL);
+#endif
+  checkTask(scheduler.addPeriodic("commands", handleCommands, 0, TaskScheduler::PRIORITY_HIGH, 5000), "commands");
+#if METRICS_PORT > 0
+  metrics.begin(METRICS_PORT);
+#endif
+#if SHOW_SYNC_PORT > 0
+  show.begin(robot, ESP.getChipId(), SHOW_SYNC_PORT);
+  checkTask(scheduler.addPeriodic("show", updateShow, 0, TaskScheduler::PRIORITY_HIGH, 1000), "show");
+#endif
+
+  Serial.print("Ready after ");
+  Serial.print(bootReadyMs);
+  Serial.print(" ms, ");
+  Serial.print(choreography.getLoaded());
+  Serial.println(" sequences loaded");
+}
+
+// Update robot movements
+// (the frames are timed on PROFILE_MOTION by the driver, also when the Ticker computes them)
+void updateMotion() {
+  stream.update();
   robot.update();
+  teach.update();
+
+  // The boot pose is on the servos, now bring up the rest. After a park the robot glides to
+  // ready first - the blocking service start would make the glide jump, so it waits for the end
+  if (bootReadyMs == 0 && robot.getState() == READY && robot.isPoseWritten() && !robot.isInterpolating()) {
+    bootReadyMs = millis();
+    checkTask(scheduler.addOneShot("services", startServices, 0, TaskScheduler::PRIORITY_LOW), "services");
+  }
+}
+
+
+
+// SETUP
+void setup() {
+  // Servos first - the robot holds its ready pose before anything slow runs.
+  // After a park the servos start at the saved pose & glide to ready
+  int parkedPose[8];
+  MovementState parkedState;
+  if (power.restorePosture(parkedPose, parkedState)) {
+    robot.begin(parkedPose);
+    robot.interpolateNext();
+  }
+  else {
+    robot.begin();
+  }
+  robot.setWriteStagger(SERVO_STAGGER_MS);
+  robot.setIdleDetach(SERVO_IDLE_DETACH_MS);
+  robot.setTempo(TEMPO_BPM);
+#if SHOW_SYNC_PORT > 0
+  robot.setClock(showClock);
+#endif
+  robot.ready();
+  power.begin(robot);
+  stream.begin(robot);
+  stream.onPlayed(onStreamPlayed);
+  teach.begin(robot);
+#if MOTION_TICK_HZ > 0
+  robot.beginTimedUpdates(MOTION_TICK_HZ);
+#endif
+
+  Serial.begin(115200);
+  LOG_INFO(EVT_BOOT, ESP.getResetInfoPtr()->reason);
+  Serial.println("\nACEBOTT QD020 Quadruped App Control");
+  if (power.wasResumed()) {
+    Serial.print("Resumed the parked ");
+    Serial.print(MovementDriver::getStateName(parkedState));
+    Serial.println(" pose");
+  }
+
+  // Register telemetry sections
+  telemetry.addSection("boot", reportBoot);
+  telemetry.addSection("motion", reportMotion);
+  telemetry.addSection("odom", reportOdometry);
+  telemetry.addSection("timing", reportStepTiming);
+  telemetry.addSection("choreo", reportChoreography);
+  telemetry.addSection("log", reportEventLog);
+  telemetry.addSection("memory", reportMemory);
+  telemetry.addSection("power", reportPower);
+  telemetry.addSection("wifi", reportWiFi);
+  telemetry.addSection("metrics", reportMetrics);
+  telemetry.addSection("show", reportShow);
+  telemetry.addSection("stream", reportStream);
+  telemetry.addSection("teach", reportTeach);
+#if LATENCY_PROFILER_ENABLED
+  telemetry.addSection("latency", reportLatency);
+#endif
+
+  // Register the /metrics collectors
+  metrics.addCollector(collectSystem);
+  metrics.addCollector(collectWiFi);
+  metrics.addCollector(collectMotion);
+  metrics.addCollector(collectShow);
+  metrics.addCollector(collectStream);
+#if LATENCY_PROFILER_ENABLED
+  metrics.addCollector(collectLatency);
+#endif
+
+  // Register tasks - motion first, it runs on every pass through loop()
+  // (the app commands are added by startServices() once Wi-Fi is up)
+  checkTask(scheduler.addPeriodic("motion", updateMotion, 0, TaskScheduler::PRIORITY_MOTION, 2000), "motion");
+  checkTask(scheduler.addPeriodic("serial", handleSerialCommands, 50, TaskScheduler::PRIORITY_LOW), "serial");
+  checkTask(scheduler.addPeriodic("log", flushEventLog, 0, TaskScheduler::PRIORITY_LOW, 1000), "log");
+  checkTask(scheduler.addPeriodic("memory", sampleMemory, 1000, TaskScheduler::PRIORITY_LOW), "memory");
+  checkTask(scheduler.addPeriodic("power", updatePower, 200, TaskScheduler::PRIORITY_LOW), "power");
+
+  // Take the first memory sample now, so the report has a baseline straight after boot
+  memory.onWarning(onMemoryWarning);
+  memory.sample();
+}
+
+// MAIN LOOP
+void loop() {
+  // Run every task that is due (motion first)
+  TRACE_POLL_SCOPE(TRACE_LOOP);
+  PROFILE_BEGIN(PROFILE_LOOP);
+  scheduler.run();
+  PROFILE_END(PROFILE_LOOP);
 }
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""
+decode_event_log.py - Turn Event_Log records from the robot back into readable text
+
+The firmware prints binary event records as hex lines ("#EV ...") mixed in with the
+normal Serial Monitor output. This script decodes those lines and passes every other
+line through unchanged (use --events-only to hide them).
+
+USAGE:
+  pio device monitor | python3 tools/decode_event_log.py
+  python3 tools/decode_event_log.py capture.txt
+  python3 tools/decode_event_log.py --events-only capture.txt
+
+NOTES:
+- Keep EVENTS in sync with the EventId enum in lib/Event_Log/src/Event_Log.h
+- Timestamps are micros() on the robot, the 32-bit wrap (~71 minutes) is unrolled
+"""
+
+import argparse
+import sys
+
+LEVELS = {1: "ERROR", 2: "WARN", 3: "INFO", 4: "DEBUG"}
+
+STATES = [
+    "standby", "ready", "forward", "backward", "turn_left", "turn_right",
+    "move_left", "move_right", "wave_hello", "dance1", "dance2", "dance3",
+    "lie_down", "fighting", "push_ups", "sleep", "idle", "custom",
+]
+CUSTOM_SEQUENCE_BASE = 32   # IDs of sequences registered at runtime (names are only known on the robot)
+POWER_LEVELS = ["active", "idle", "low"]
+WIFI_STATUS = ["idle", "no SSID", "scan done", "connected", "connect failed", "connection lost",
+               "wrong password", "disconnected"]
+STREAM_STOPS = {1: "timeout", 2: "command", 3: "restart"}
+LOAD_RESULTS = ["loaded", "open failed", "bad header", "bad checksum", "bad step", "no memory",
+                "not registered", "bad name", "write failed"]   # SequenceLoadResult
+
+
+def state_name(value):
+    if value >= CUSTOM_SEQUENCE_BASE:
+        return "seq%d" % value
+    return STATES[value] if value < len(STATES) else "state%d" % value
+
+
+def power_level(value):
+    return POWER_LEVELS[value] if value < len(POWER_LEVELS) else "level%d" % value
+
+
+def wifi_status(value):
+    return WIFI_STATUS[value] if value < len(WIFI_STATUS) else "status%d" % value
+
+
+def stream_stop(value):
+    return STREAM_STOPS.get(value, "reason%d" % value)
+
+
+def load_result(value):
+    return LOAD_RESULTS[value] if value < len(LOAD_RESULTS) else "result%d" % value
+
+
+# Event ID -> (name, formatter(a, b, c))
+EVENTS = {
+    1: ("BOOT", lambda a, b, c: "reset reason %d" % a),
+    2: ("WIFI_READY", lambda a, b, c: "channel %d, %d APs seen, scan took %d ms" % (a, b, c)),
+    3: ("CLIENT_CONNECTED", lambda a, b, c: ""),
+    4: ("CLIENT_DISCONNECTED", lambda a, b, c: "link lost" if a else ""),
+    5: ("CLIENT_TIMEOUT", lambda a, b, c: ""),
+    6: ("CMD_MOVEMENT", lambda a, b, c: "action 0x%02X, device 0x%02X, movement type 0x%02X" % (a, b, c)),
+    7: ("CMD_ACTION", lambda a, b, c: "action 0x%02X, device 0x%02X" % (a, b)),
+    8: ("FRAME_OVERFLOW", lambda a, b, c: "buffer index %d" % a),
+    9: ("SEQUENCE_START", lambda a, b, c: "%s (queued %s)" % (state_name(a), state_name(b))),
+    10: ("SEQUENCE_END", lambda a, b, c: state_name(a)),
+    11: ("STEP_LATE", lambda a, b, c: "%s step %d, %d ms late" % (state_name(a), b, c)),
+    12: ("COMMAND_DROPPED", lambda a, b, c: state_name(a)),
+    13: ("MEMORY_WARNING", lambda a, b, c: "flags 0x%02X, free heap %d, max block %d" % (a, b, c)),
+    14: ("STEP_READ_FAILED", lambda a, b, c: "%s step %d" % (state_name(a), b)),
+    15: ("POWER_LEVEL", lambda a, b, c: "%s (was %s)" % (power_level(a), power_level(b))),
+    16: ("WIFI_JOINED", lambda a, b, c: "channel %d, RSSI -%d dBm, join took %d ms" % (a, b, c)),
+    17: ("WIFI_JOIN_FAILED", lambda a, b, c: "%s after %d ms, starting the AP" % (wifi_status(a), b)),
+    18: ("SHOW_CLOCK_SET", lambda a, b, c: "master %04x, clock moved %s%d ms" % (a, "-" if c else "+", b)),
+    19: ("SHOW_START", lambda a, b, c: "%s, %s" % (state_name(a), "%d ms late" % c if c else "%d ms ahead" % b)),
+    20: ("TEMPO_SET", lambda a, b, c: "%d BPM, %s" % (a, "from beat %d" % b if b else "at once")),
+    21: ("STREAM_START", lambda a, b, c: "frame %d, interrupted %s" % (a, state_name(b))),
+    22: ("STREAM_STOP", lambda a, b, c: "%s, %d frames played, delay %d ms" % (stream_stop(a), b, c)),
+    23: ("TEACH_START", lambda a, b, c: "tolerance %d deg" % a),
+    24: ("TEACH_STOP", lambda a, b, c: "%d keyframes, %d ms%s" % (a, b, ", buffer full" if c else "")),
+    25: ("SEQUENCE_SAVED", lambda a, b, c: "%s, %d steps, %s" % (state_name(a) if a else "-", b, load_result(c))),
+    26: ("TASK_REJECTED", lambda a, b, c: "all %d task slots taken, a job won't run" % a),
+}
+
+
+class Decoder:
+    def __init__(self):
+        self.last_raw = None
+        self.wraps = 0
+
+    def timestamp(self, raw):
+        # Unroll the 32-bit micros() wrap (a reboot restarts from zero, which also looks like a wrap)
+        if self.last_raw is not None and raw < self.last_raw:
+            self.wraps += 1
+        self.last_raw = raw
+        return (self.wraps << 32) + raw
+
+    def decode(self, hex_record):
+        if len(hex_record) != 24:
+            return None
+        try:
+            raw_time = int(hex_record[0:8], 16)
+            event_id = int(hex_record[8:10], 16)
+            level = int(hex_record[10:12], 16)
+            a = int(hex_record[12:16], 16)
+            b = int(hex_record[16:20], 16)
+            c = int(hex_record[20:24], 16)
+        except ValueError:
+            return None
+
+        if event_id == 1:
+            # A new boot restarts the clock
+            self.last_raw = None
+            self.wraps = 0
+
+        seconds = self.timestamp(raw_time) / 1e6
+        name, formatter = EVENTS.get(event_id, ("EVENT_%d" % event_id, lambda a, b, c: "a=%d b=%d c=%d" % (a, b, c)))
+        details = formatter(a, b, c)
+        text = "[%12.6f] %-5s %s" % (seconds, LEVELS.get(level, "L%d" % level), name)
+        return text + (": " + details if details else "")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode robot event log records")
+    parser.add_argument("input", nargs="?", help="capture file (default: stdin)")
+    parser.add_argument("--events-only", action="store_true", help="hide normal Serial Monitor lines")
+    args = parser.parse_args()
+
+    source = open(args.input, errors="replace") if args.input else sys.stdin
+    decoder = Decoder()
+
+    for line in source:
+        line = line.rstrip("\r\n")
+        marker = line.find("#EV")
+
+        if marker >= 0 and line.startswith("#EVDROP ", marker):
+            print("[ ... ] WARN  %s records dropped (log buffer full)" % line[marker + 8:].strip())
+        elif marker >= 0 and line.startswith("#EV ", marker):
+            text = decoder.decode(line[marker + 4:].strip())
+            print(text if text else line)
+        elif not args.events_only:
+            print(line)
+        sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
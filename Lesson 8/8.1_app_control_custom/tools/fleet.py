@@ -0,0 +1,234 @@
+#!/usr/bin/env python3
+"""
+fleet.py - Find the robots on the network & send commands to all of them at once
+
+Robots built with WIFI_STA_SSID join an existing network & announce the control port as a
+_quadbot._tcp mDNS service (TXT records: id, model & caps). This script browses for the
+service with a plain mDNS query (standard library only, no zeroconf package needed), then
+opens the control port of every robot it found.
+
+USAGE:
+  python3 tools/fleet.py list
+  python3 tools/fleet.py send standby
+  python3 tools/fleet.py send forward --ids 3fa2c1,3fa2d8
+  python3 tools/fleet.py telemetry --fields motion.sequence,power.level,wifi.rssi_dbm
+  python3 tools/fleet.py telemetry --host 192.168.1.42      (skip the discovery)
+  python3 tools/fleet.py targets > quadbots.json             (Prometheus file_sd_configs)
+
+NOTES:
+- Keep COMMANDS in sync with the CMD_* defines in src/main.cpp
+- The robot serves one connection at a time, close the app before running a command
+- Robots running their own access point (the fallback) are only reachable after joining it
+"""
+
+import argparse
+import json
+import socket
+import struct
+import sys
+import time
+
+SERVICE = "_quadbot._tcp.local"
+MDNS_GROUP = ("224.0.0.251", 5353)
+TYPE_A, TYPE_PTR, TYPE_TXT, TYPE_SRV = 1, 12, 16, 33
+
+# Name -> (action, movement type) - movements are CMD_RUN (1) with a movement type
+COMMANDS = {
+    "forward": (1, 0x01), "backward": (1, 0x02), "move_left": (1, 0x03),
+    "move_right": (1, 0x04), "turn_left": (1, 0x05), "turn_right": (1, 0x06),
+    "standby": (3, 0), "sleep": (5, 0), "lie_down": (6, 0), "wave_hello": (7, 0),
+    "push_ups": (8, 0), "fighting": (9, 0), "dance1": (10, 0), "dance2": (11, 0),
+    "dance3": (12, 0), "park": (0x25, 0),
+}
+CMD_TELEMETRY = 0x20
+
+
+class Robot:
+    def __init__(self, host, port=100):
+        self.host = host        # IP address
+        self.port = port
+        self.name = ""          # mDNS host name
+        self.txt = {}           # id, model, caps
+
+    @property
+    def id(self):
+        return self.txt.get("id", self.host)
+
+
+def frame(action, device=0x01, movement_type=0):
+    # Same layout as the app: action at byte 9, device at byte 10, movement type at byte 12
+    return bytes([0xFF, 0x55, 0x0A, 0, 0, 0, 0, 0, 0, action, device, 0, movement_type])
+
+
+def encode_name(name):
+    out = b""
+    for label in name.split("."):
+        out += bytes([len(label)]) + label.encode()
+    return out + b"\0"
+
+
+def read_name(data, offset):
+    labels = []
+    jumped = False
+    end = offset
+    while True:
+        length = data[offset]
+        if length & 0xC0 == 0xC0:   # Compression pointer
+            if not jumped:
+                end = offset + 2
+            offset = ((length & 0x3F) << 8) | data[offset + 1]
+            jumped = True
+            continue
+        offset += 1
+        if length == 0:
+            break
+        labels.append(data[offset:offset + length].decode(errors="replace"))
+        offset += length
+    return ".".join(labels), (end if jumped else offset)
+
+
+def parse_records(data):
+    # Every record of the answer, authority & additional sections as (name, type, rdata, offset)
+    _, _, questions, answers, authority, additional = struct.unpack("!6H", data[:12])
+    offset = 12
+    for _ in range(questions):
+        _, offset = read_name(data, offset)
+        offset += 4
+    records = []
+    for _ in range(answers + authority + additional):
+        name, offset = read_name(data, offset)
+        rtype, _, _, length = struct.unpack("!HHIH", data[offset:offset + 10])
+        offset += 10
+        records.append((name, rtype, data[offset:offset + length], offset))
+        offset += length
+    return records
+
+
+def discover(timeout):
+    # One PTR query from an ephemeral port, the robots answer by unicast (legacy unicast query)
+    query = struct.pack("!6H", 0, 0, 1, 0, 0, 0) + encode_name(SERVICE) + struct.pack("!HH", TYPE_PTR, 1)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 255)
+    sock.settimeout(0.2)
+    sock.sendto(query, MDNS_GROUP)
+
+    robots = {}
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        try:
+            data, (sender, _) = sock.recvfrom(4096)
+        except socket.timeout:
+            continue
+        robot = Robot(sender)
+        addresses = {}
+        try:
+            for name, rtype, rdata, offset in parse_records(data):
+                if rtype == TYPE_SRV:
+                    robot.port = struct.unpack("!H", rdata[4:6])[0]
+                    robot.name, _ = read_name(data, offset + 6)
+                elif rtype == TYPE_TXT:
+                    i = 0
+                    while i < len(rdata):
+                        entry = rdata[i + 1:i + 1 + rdata[i]].decode(errors="replace")
+                        key, _, value = entry.partition("=")
+                        robot.txt[key] = value
+                        i += 1 + rdata[i]
+                elif rtype == TYPE_A and len(rdata) == 4:
+                    addresses[name] = socket.inet_ntoa(rdata)
+        except (IndexError, struct.error):
+            continue    # Not a well-formed answer
+        if not robot.txt:
+            continue    # Some other responder
+        robot.host = addresses.get(robot.name, sender)
+        robots[robot.id] = robot
+    sock.close()
+    return sorted(robots.values(), key=lambda r: r.id)
+
+
+def exchange(robot, payload, reply_end=None, timeout=3.0):
+    # Send a frame, return the text reply up to reply_end (or whatever arrives in 0.3 s)
+    with socket.create_connection((robot.host, robot.port), timeout=timeout) as conn:
+        conn.sendall(payload)
+        conn.settimeout(timeout if reply_end else 0.3)
+        reply = b""
+        try:
+            while not reply_end or reply_end not in reply:
+                chunk = conn.recv(1024)
+                if not chunk:
+                    break
+                reply += chunk
+        except socket.timeout:
+            pass
+    return reply.decode(errors="replace")
+
+
+def read_telemetry(robot):
+    fields = {}
+    for line in exchange(robot, frame(CMD_TELEMETRY), b"#END").splitlines():
+        key, sep, value = line.strip().partition("=")
+        if sep and not key.startswith("#"):
+            fields[key] = value
+    return fields
+
+
+def print_table(header, rows):
+    widths = [max(len(str(row[i])) for row in [header] + rows) for i in range(len(header))]
+    for row in [header] + rows:
+        print("  ".join(str(cell).ljust(width) for cell, width in zip(row, widths)).rstrip())
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Find & control every robot on the network")
+    parser.add_argument("command", choices=["list", "send", "telemetry", "targets"])
+    parser.add_argument("name", nargs="?", help="command to send: " + ", ".join(COMMANDS))
+    parser.add_argument("--ids", help="only these robot IDs (comma separated)")
+    parser.add_argument("--host", action="append", help="robot address, skips the discovery (repeatable)")
+    parser.add_argument("--fields", default="motion.sequence,power.level,wifi.rssi_dbm,boot.ready_ms",
+                        help="telemetry fields to show (comma separated)")
+    parser.add_argument("--timeout", type=float, default=2.0, help="discovery time in seconds")
+    parser.add_argument("--metrics-port", type=int, default=80, help="port of the /metrics endpoint (METRICS_PORT)")
+    args = parser.parse_args()
+
+    robots = [Robot(host) for host in args.host] if args.host else discover(args.timeout)
+    if args.ids:
+        wanted = set(args.ids.split(","))
+        robots = [robot for robot in robots if robot.id in wanted]
+    if not robots:
+        sys.exit("No robots found")
+
+    if args.command == "list":
+        print_table(["id", "host", "address", "port", "caps"],
+                    [[r.id, r.name, r.host, r.port, r.txt.get("caps", "")] for r in robots])
+
+    elif args.command == "targets":
+        # One target group per robot, the robot ID as a label that survives DHCP address changes
+        groups = [{"targets": ["%s:%d" % (r.host, args.metrics_port)], "labels": {"robot_id": r.id}}
+                  for r in robots if "metrics" in r.txt.get("caps", "metrics").split(",")]
+        json.dump(groups, sys.stdout, indent=2)
+        print()
+
+    elif args.command == "send":
+        if args.name not in COMMANDS:
+            parser.error("send needs one of: " + ", ".join(COMMANDS))
+        action, movement_type = COMMANDS[args.name]
+        for robot in robots:
+            try:
+                exchange(robot, frame(action, movement_type=movement_type))
+                print("%s: %s sent" % (robot.id, args.name))
+            except OSError as error:
+                print("%s: %s" % (robot.id, error))
+
+    else:
+        keys = args.fields.split(",")
+        rows = []
+        for robot in robots:
+            try:
+                fields = read_telemetry(robot)
+                rows.append([fields.get("wifi.id", robot.id)] + [fields.get(key, "-") for key in keys])
+            except OSError as error:
+                rows.append([robot.id] + [str(error)] + ["-"] * (len(keys) - 1))
+        print_table(["id"] + keys, rows)
+
+
+if __name__ == "__main__":
+    main()
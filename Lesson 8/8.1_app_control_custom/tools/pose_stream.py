@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+"""
+pose_stream.py - Drive the robot live: stream poses at 50 Hz & measure the end-to-end latency
+
+Sends one CMD_POSE frame (8 joint angles) per period over the control port. The robot plays
+the poses out after a small adaptive jitter buffer (lib/Pose_Stream) & echoes every frame it
+plays with the time it held it, so the script measures the latency from sending a pose to
+the servos getting it: (round trip - held) / 2 + held.
+
+USAGE:
+  python3 tools/pose_stream.py                                  (sway around the ready pose)
+  python3 tools/pose_stream.py --csv choreography/shuffle.csv --loop
+  mocap_bridge | python3 tools/pose_stream.py --stdin           (8 angles per line)
+  python3 tools/pose_stream.py --host 192.168.1.42 --drop 5 --jitter-ms 40
+  python3 tools/pose_stream.py --csv draft.csv --record stretch    (teach the robot the stream)
+
+NOTES:
+- Angles are in position array order: URP, URA, LRA, LRP, ULP, ULA, LLA, LLP (0-180)
+- CSV input is the qds_compiler.py format (8 angles + ms per row), the poses in between the
+  rows are interpolated on the PC
+- --stdin streams the last pose read, so the source can send at any rate (a slider UI only
+  sends on changes)
+- --drop & --jitter-ms hold back frames on purpose, to see the jitter buffer cope
+- --record NAME turns teach mode on before the first frame & saves the recording as a sequence
+  when the stream ends (see tools/teach.py), the keyframes the robot kept are printed
+- Keep the frame layout in sync with lib/Pose_Stream/src/Pose_Stream.h, the robot serves one
+  connection at a time (close the app first). Any movement command ends the stream
+"""
+
+import argparse
+import csv
+import math
+import random
+import select
+import socket
+import statistics
+import struct
+import sys
+import threading
+import time
+
+CMD_POSE = 0x28
+CMD_RECORD = 0x29
+CMD_SAVE = 0x2A
+READY = [100, 132, 50, 78, 75, 45, 120, 92]   # readyArray in Movement_Driver.cpp
+ECHO = bytes([0xFF, 0x55, 0x06, 0x01, CMD_POSE])
+
+
+def frame(sequence, sender_ms, angles):
+    # App layout (action at byte 9) with the pose as the payload from byte 11
+    payload = struct.pack("<HI8B", sequence, sender_ms, *angles)
+    body = bytes([0, 0, 0, 0, 0, 0, CMD_POSE, 0]) + payload
+    return bytes([0xFF, 0x55, len(body)]) + body
+
+
+def command(action, device, payload):
+    body = bytes([0, 0, 0, 0, 0, 0, action, device]) + payload
+    return bytes([0xFF, 0x55, len(body)]) + body
+
+
+def clamp(angles):
+    return [max(0, min(180, int(round(angle)))) for angle in angles]
+
+
+class Sway:
+    """Arms swing & the body rocks around the ready pose"""
+
+    def pose(self, t):
+        swing = 15 * math.sin(2 * math.pi * 0.5 * t)
+        rock = 10 * math.sin(2 * math.pi * 0.25 * t)
+        return clamp([READY[0] + rock, READY[1] + swing, READY[2] + swing, READY[3] - rock,
+                      READY[4] - rock, READY[5] - swing, READY[6] - swing, READY[7] + rock])
+
+
+class Keyframes:
+    """CSV rows (8 angles + ms), interpolated"""
+
+    def __init__(self, path, loop):
+        self.rows = []
+        with open(path, newline="") as file:
+            for row in csv.reader(file):
+                if not row or not row[0].strip() or row[0].strip().startswith("#"):
+                    continue
+                values = [float(value) for value in row[:9]]
+                self.rows.append((values[:8], max(1.0, values[8]) / 1000))
+        if not self.rows:
+            sys.exit("%s has no steps" % path)
+        self.length = sum(duration for _, duration in self.rows)
+        self.loop = loop
+
+    def pose(self, t):
+        if self.loop:
+            t %= self.length
+        elif t >= self.length:
+            return None
+        previous = self.rows[-1][0] if self.loop else self.rows[0][0]
+        for angles, duration in self.rows:
+            if t < duration:
+                return clamp([a + (b - a) * t / duration for a, b in zip(previous, angles)])
+            t -= duration
+            previous = angles
+        return clamp(previous)
+
+
+class StdinPoses:
+    """Latest line of 8 angles from stdin"""
+
+    def __init__(self):
+        self.angles = list(READY)
+        self.done = False
+
+    def pose(self, t):
+        while select.select([sys.stdin], [], [], 0)[0]:
+            line = sys.stdin.readline()
+            if not line:
+                self.done = True
+                break
+            values = line.replace(",", " ").split()
+            if len(values) == 8:
+                self.angles = clamp(float(value) for value in values)
+        return None if self.done else self.angles
+
+
+class Latency:
+    """Matches the robot's echoes to the frames sent"""
+
+    def __init__(self):
+        self.sent = {}
+        self.results = []
+        self.lock = threading.Lock()
+        self.running = True
+
+    def send(self, sequence):
+        with self.lock:
+            self.sent[sequence] = time.monotonic()
+
+    def reader(self, sock):
+        data = b""
+        while self.running:
+            try:
+                chunk = sock.recv(1024)
+            except socket.timeout:
+                continue
+            except OSError:
+                return
+            if not chunk:
+                return
+            data += chunk
+            while True:
+                start = data.find(ECHO)
+                if start < 0 or len(data) < start + 9:
+                    data = data[-8:]
+                    break
+                sequence, held_ms = struct.unpack_from("<HH", data, start + 5)
+                data = data[start + 9:]
+                with self.lock:
+                    sent = self.sent.pop(sequence, None)
+                if sent is not None:
+                    round_trip_ms = (time.monotonic() - sent) * 1000
+                    self.results.append(max(0.0, round_trip_ms - held_ms) / 2 + held_ms)
+
+    def summary(self, frames):
+        if not self.results:
+            return "%d frames sent, no echo yet" % frames
+        ordered = sorted(self.results)
+        return "%d frames sent, %d played, latency p50 %.0f ms, p99 %.0f ms, max %.0f ms" % (
+            frames, len(ordered), statistics.median(ordered), ordered[len(ordered) * 99 // 100], ordered[-1])
+
+
+def read_reply(sock, timeout=3.0, quiet=0.3):
+    reply = b""
+    sock.settimeout(timeout)
+    try:
+        while True:
+            chunk = sock.recv(1024)
+            if not chunk:
+                break
+            reply += chunk
+            sock.settimeout(quiet)
+    except socket.timeout:
+        pass
+    return reply.decode(errors="replace")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stream poses to the robot & measure the latency")
+    parser.add_argument("--host", default="192.168.4.1", help="robot address (the access point by default)")
+    parser.add_argument("--port", type=int, default=100, help="control port")
+    source = parser.add_mutually_exclusive_group()
+    source.add_argument("--csv", help="keyframes to stream (qds_compiler.py CSV)")
+    source.add_argument("--stdin", action="store_true", help="stream the last line of 8 angles read")
+    parser.add_argument("--loop", action="store_true", help="repeat the CSV keyframes")
+    parser.add_argument("--rate", type=float, default=50, help="frames per second")
+    parser.add_argument("--duration", type=float, default=0, help="stop after this many seconds (0 = never)")
+    parser.add_argument("--drop", type=float, default=0, help="percent of the frames not sent")
+    parser.add_argument("--jitter-ms", type=float, default=0, help="hold a frame back by up to this long")
+    parser.add_argument("--record", metavar="NAME", help="record the stream & save it as this sequence")
+    parser.add_argument("--tolerance", type=int, default=0, help="--record: merge poses within this many degrees")
+    args = parser.parse_args()
+
+    if args.csv:
+        poses = Keyframes(args.csv, args.loop)
+    elif args.stdin:
+        poses = StdinPoses()
+    else:
+        poses = Sway()
+
+    sock = socket.create_connection((args.host, args.port), timeout=5)
+    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    sock.settimeout(0.2)
+    latency = Latency()
+    reader = threading.Thread(target=latency.reader, args=(sock,), daemon=True)
+    reader.start()
+    if args.record:
+        sock.sendall(command(CMD_RECORD, 1, bytes([0, args.tolerance])))
+
+    period = 1 / args.rate
+    sequence = random.getrandbits(16)
+    frames = 0
+    start = time.monotonic()
+    next_send = start
+    next_report = start + 5
+    try:
+        while True:
+            now = time.monotonic()
+            if args.duration and now - start >= args.duration:
+                break
+            angles = poses.pose(now - start)
+            if angles is None:
+                break
+            sequence = (sequence + 1) & 0xFFFF
+            if random.uniform(0, 100) >= args.drop:
+                if args.jitter_ms:
+                    time.sleep(random.uniform(0, args.jitter_ms) / 1000)
+                latency.send(sequence)
+                sock.sendall(frame(sequence, int(now * 1000) & 0xFFFFFFFF, angles))
+                frames += 1
+            if now >= next_report:
+                print(latency.summary(frames), flush=True)
+                next_report += 5
+
+            next_send += period
+            time.sleep(max(0.0, next_send - time.monotonic()))
+    except KeyboardInterrupt:
+        pass
+
+    time.sleep(0.5)     # The last echoes
+    print(latency.summary(frames))
+    if args.record:
+        # The reader stops, so the text reply to the save isn't taken for echoes
+        latency.running = False
+        reader.join()
+        sock.sendall(command(CMD_SAVE, 1, args.record.encode()[:15]))
+        print(read_reply(sock), end="")
+    sock.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,354 @@
+#!/usr/bin/env python3
+"""
+qds_compiler.py - Compile a choreography into a .qds sequence file for Sequence_Library (and back)
+
+Each step is a row of 9 values in position array order, like the arrays in Movement_Driver.cpp:
+URP, URA, LRA, LRP, ULP, ULA, LLA, LLP, ms. The robot loads every .qds file in /seq on
+LittleFS at boot, so put the output in data/seq/ and run "pio run -t uploadfs".
+A dance can be authored in beats instead of ms (--beats), it then plays at the robot's tempo.
+
+USAGE:
+  python3 tools/qds_compiler.py choreography/shuffle.csv -o data/seq/shuffle.qds
+  python3 tools/qds_compiler.py lib/Movement_Driver/src/Movement_Driver.cpp --array dance2 --name dance2b
+  python3 tools/qds_compiler.py --decompile data/seq/shuffle.qds
+  python3 tools/qds_compiler.py --decompile data/seq/shuffle.qds --format c -o shuffle.h
+  python3 tools/qds_compiler.py choreography/groove.csv --beats     (durations like 1, 1/2, 0.75)
+
+NOTES:
+- CSV input: one step per line, blank lines & lines starting with '#' are skipped
+- C input: position arrays ({...} rows of 9 values, comments are ignored), --array picks one
+  when the file has several. Rows pasted without a declaration work too
+- The sequence name defaults to the input file (or array) name, at most 15 characters, and
+  must not be the name of a built-in sequence
+- Beats: the duration column of a CSV file is in beats with --beats, C arrays written with BEAT
+  (BEAT / 4, BEAT * 3 / 2 ...) like the built-in dances are always beat-timed. Durations are
+  stored as ticks (BEAT = 48 per beat), so a beat splits into halves, thirds, quarters ... 16ths
+- Version 2 (default) stores the angle & duration changes between steps as varints,
+  --v1 writes the fixed size format (10 bytes per step)
+- Keep the format in sync with lib/Sequence_Library/src/Sequence_Library.h
+"""
+
+import argparse
+import csv
+import os
+import re
+import struct
+import sys
+from fractions import Fraction
+
+MAGIC = b"QDS"
+JOINTS = 8
+MAX_NAME = 15
+V1_HEADER = 28
+FLAG_DELTA = 0x01
+FLAG_BEATS = 0x02
+BEAT = 48                   # Ticks per beat (BEAT in Movement_Driver.h)
+COLUMNS = ["URP", "URA", "LRA", "LRP", "ULP", "ULA", "LLA", "LLP", "MS"]
+BUILT_IN = {
+    "standby", "ready", "forward", "backward", "turn_left", "turn_right",
+    "move_left", "move_right", "wave_hello", "dance1", "dance2", "dance3",
+    "lie_down", "fighting", "push_ups", "sleep",
+}
+
+
+def fnv1a(data):
+    value = 2166136261
+    for byte in data:
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+# VARINTS
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        out.append(byte | (0x80 if value else 0))
+        if not value:
+            return bytes(out)
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+def read_varint(data, position):
+    value = 0
+    for shift in (0, 7, 14):
+        if position >= len(data):
+            raise ValueError("truncated varint at byte %d" % position)
+        byte = data[position]
+        position += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, position
+    raise ValueError("varint too long at byte %d" % position)
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+# BEATS
+def beats_to_ticks(beats, where):
+    ticks = Fraction(beats) * BEAT
+    if ticks.denominator != 1:
+        raise ValueError("%s: %s beats is not a whole number of 1/%d beats" % (where, beats, BEAT))
+    return int(ticks)
+
+
+def beat_expression(text, where):
+    """Ticks of a C duration like BEAT / 8 or BEAT * 5 / 4."""
+    if not re.fullmatch(r"[\dBEAT\s()*/+-]+", text):
+        raise ValueError("%s: can't read duration '%s'" % (where, text.strip()))
+    expression = re.sub(r"\d+", lambda match: "Fraction(%s)" % match.group(), text)
+    value = eval(expression, {"__builtins__": {}}, {"Fraction": Fraction, "BEAT": Fraction(BEAT)})
+    return beats_to_ticks(Fraction(value) / BEAT, where)
+
+
+def format_beats(ticks):
+    return str(Fraction(ticks, BEAT))
+
+
+# INPUT
+def read_csv(path, beats):
+    steps = []
+    with open(path, newline="") as f:
+        for number, row in enumerate(csv.reader(f), 1):
+            if not row or not "".join(row).strip() or row[0].strip().startswith("#"):
+                continue
+            values = [v.strip() for v in row if v.strip()]
+            if len(values) != JOINTS + 1:
+                raise ValueError("line %d: expected %d values, got %d" % (number, JOINTS + 1, len(values)))
+            duration = beats_to_ticks(values[JOINTS], "line %d" % number) if beats else int(values[JOINTS])
+            steps.append([int(v) for v in values[:JOINTS]] + [duration])
+    return steps
+
+
+def read_c_arrays(path, beats):
+    """Return {array name: (steps, beat-timed)} for every position array in a C/C++ file."""
+    with open(path) as f:
+        text = f.read()
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    text = re.sub(r"//[^\n]*", "", text)
+
+    def rows(body):
+        steps = []
+        beat_timed = beats or "BEAT" in body
+        for row in re.findall(r"\{([^{}]*)\}", body):
+            values = [v for v in row.split(",") if v.strip()]
+            if len(values) != JOINTS + 1:
+                raise ValueError("row {%s}: expected %d values" % (row.strip(), JOINTS + 1))
+            where = "row {%s}" % row.strip()
+            duration = beat_expression(values[JOINTS], where) if beat_timed else int(values[JOINTS], 0)
+            steps.append([int(v, 0) for v in values[:JOINTS]] + [duration])
+        return steps, beat_timed
+
+    arrays = {}
+    for match in re.finditer(r"(\w+)\s*\[[^\]]*\]\s*\[\s*9\s*\]\s*=\s*\{(.*?)\}\s*;", text, re.S):
+        arrays[match.group(1)] = rows(match.group(2))
+    if not arrays:
+        arrays[os.path.splitext(os.path.basename(path))[0]] = rows(text)
+    return arrays
+
+
+def read_input(args):
+    """Return (name, steps, beat-timed) of the input."""
+    stem = os.path.splitext(os.path.basename(args.input))[0]
+    if args.input.lower().endswith(".csv"):
+        return (stem, read_csv(args.input, args.beats), args.beats)
+
+    arrays = read_c_arrays(args.input, args.beats)
+    if args.array:
+        for key in (args.array, args.array + "Array"):
+            if key in arrays:
+                return (re.sub(r"Array$", "", key),) + arrays[key]
+        raise ValueError("no array '%s' (found: %s)" % (args.array, ", ".join(arrays)))
+    if len(arrays) > 1:
+        raise ValueError("several arrays, pick one with --array (%s)" % ", ".join(arrays))
+    key = next(iter(arrays))
+    return (re.sub(r"Array$", "", key),) + arrays[key]
+
+
+def check_steps(steps, beats):
+    if not steps:
+        raise ValueError("no steps")
+    if len(steps) > 0xFFFF:
+        raise ValueError("too many steps (%d)" % len(steps))
+    for number, step in enumerate(steps, 1):
+        if any(angle < 0 or angle > 180 for angle in step[:JOINTS]):
+            raise ValueError("step %d: angles must be 0-180" % number)
+        if step[JOINTS] <= 0 or step[JOINTS] > 0xFFFF:
+            raise ValueError("step %d: duration must be %s" %
+                             (number, "1/%d-%s beats" % (BEAT, format_beats(0xFFFF)) if beats else "1-65535 ms"))
+
+
+# ENCODING
+def pack_v1(name, steps, flags=0):
+    data = b"".join(struct.pack("<8BH", *step) for step in steps)
+    header = MAGIC + struct.pack("<BBBH16sI", 1, JOINTS, flags, len(steps), name.encode("ascii"), fnv1a(data))
+    return header + data
+
+
+def pack_v2(name, steps, flags=0):
+    data = bytearray()
+    previous = None
+    for step in steps:
+        if previous is None:
+            data += bytes(step[:JOINTS]) + varint(step[JOINTS])
+        else:
+            mask = 0
+            changes = bytearray()
+            for joint in range(JOINTS):
+                if step[joint] != previous[joint]:
+                    mask |= 1 << joint
+                    changes += varint(zigzag(step[joint] - previous[joint]))
+            data += bytes([mask]) + changes + varint(zigzag(step[JOINTS] - previous[JOINTS]))
+        previous = step
+
+    encoded_name = name.encode("ascii")
+    header = (MAGIC + bytes([2, JOINTS, FLAG_DELTA | flags, len(encoded_name)]) + encoded_name +
+              varint(len(steps)) + struct.pack("<I", fnv1a(data)))
+    return header + bytes(data)
+
+
+# DECODING
+def unpack(blob):
+    """Return (version, name, steps, beat-timed) of a .qds file."""
+    if len(blob) < 6 or blob[:3] != MAGIC:
+        raise ValueError("not a .qds file")
+    version, joints, flags = blob[3], blob[4], blob[5]
+    if joints != JOINTS:
+        raise ValueError("%d joints (expected %d)" % (joints, JOINTS))
+
+    if version == 1:
+        if len(blob) < V1_HEADER:
+            raise ValueError("truncated header")
+        count, raw_name, checksum = struct.unpack_from("<H16sI", blob, 6)
+        data = blob[V1_HEADER:]
+        if len(data) != count * 10:
+            raise ValueError("size doesn't match %d steps" % count)
+        if fnv1a(data) != checksum:
+            raise ValueError("bad checksum")
+        steps = [list(struct.unpack_from("<8BH", data, i * 10)) for i in range(count)]
+        return version, raw_name.split(b"\0")[0].decode("ascii"), steps, bool(flags & FLAG_BEATS)
+
+    if version != 2:
+        raise ValueError("unknown version %d" % version)
+    position = 6
+    name_length = blob[position]
+    name = blob[position + 1:position + 1 + name_length].decode("ascii")
+    position += 1 + name_length
+    count, position = read_varint(blob, position)
+    (checksum,) = struct.unpack_from("<I", blob, position)
+    data = blob[position + 4:]
+    if fnv1a(data) != checksum:
+        raise ValueError("bad checksum")
+
+    steps = []
+    position = 0
+    for index in range(count):
+        if index == 0 or not flags & FLAG_DELTA:
+            angles = list(data[position:position + JOINTS])
+            position += JOINTS
+            duration, position = read_varint(data, position)
+        else:
+            angles = list(steps[-1][:JOINTS])
+            mask = data[position]
+            position += 1
+            for joint in range(JOINTS):
+                if mask & (1 << joint):
+                    change, position = read_varint(data, position)
+                    angles[joint] += unzigzag(change)
+            change, position = read_varint(data, position)
+            duration = steps[-1][JOINTS] + unzigzag(change)
+        steps.append(angles + [duration])
+    if position != len(data):
+        raise ValueError("%d bytes left after the last step" % (len(data) - position))
+    return version, name, steps, bool(flags & FLAG_BEATS)
+
+
+def format_csv(name, steps, beats):
+    columns = COLUMNS[:JOINTS] + (["BEATS (compile with --beats)"] if beats else [COLUMNS[JOINTS]])
+    lines = ["# %s" % name, "# " + ", ".join(columns)]
+    for step in steps:
+        duration = format_beats(step[JOINTS]) if beats else "%3d" % step[JOINTS]
+        lines.append(", ".join(["%3d" % v for v in step[:JOINTS]] + [duration]))
+    return "\n".join(lines) + "\n"
+
+
+def c_beats(ticks):
+    beats = Fraction(ticks, BEAT)
+    text = "BEAT" if beats.numerator == 1 else "BEAT * %d" % beats.numerator
+    return text if beats.denominator == 1 else "%s / %d" % (text, beats.denominator)
+
+
+def format_c(name, steps, beats):
+    columns = COLUMNS[:JOINTS] + ["BEATS" if beats else COLUMNS[JOINTS]]
+    lines = ["const int %sArray[%d][9] = {" % (name, len(steps)),
+             "// " + "---".join(columns)]
+    for number, step in enumerate(steps, 1):
+        duration = c_beats(step[JOINTS]) if beats else "%3d" % step[JOINTS]
+        row = ",  ".join(["%3d" % v for v in step[:JOINTS]] + [duration])
+        lines.append("  {%s}%s // step %d" % (row, "," if number < len(steps) else " ", number))
+    lines.append("};")
+    return "\n".join(lines) + "\n"
+
+
+def decompile(args):
+    with open(args.input, "rb") as f:
+        version, name, steps, beats = unpack(f.read())
+    text = (format_c if args.format == "c" else format_csv)(args.name or name, steps, beats)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text)
+        print("%s: version %d, %d steps%s" % (args.output, version, len(steps), ", beats" if beats else ""),
+              file=sys.stderr)
+    else:
+        sys.stdout.write(text)
+
+
+def compile_input(args):
+    stem, steps, beats = read_input(args)
+    name = args.name or stem
+    if not name or len(name) > MAX_NAME or not name.isascii():
+        raise ValueError("name '%s' must be 1-%d ASCII characters (use --name)" % (name, MAX_NAME))
+    if name in BUILT_IN:
+        raise ValueError("'%s' is a built-in sequence (use --name)" % name)
+    check_steps(steps, beats)
+
+    flags = FLAG_BEATS if beats else 0
+    packed = pack_v1(name, steps, flags) if args.v1 else pack_v2(name, steps, flags)
+    output = args.output or os.path.splitext(args.input)[0] + ".qds"
+    with open(output, "wb") as f:
+        f.write(packed)
+    total = sum(s[JOINTS] for s in steps)
+    print("%s: %s, %d steps, %s, %d bytes (%d as int arrays)" %
+          (output, name, len(steps), "%s beats" % format_beats(total) if beats else "%d ms" % total,
+           len(packed), len(steps) * 9 * 4))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compile a choreography into a .qds sequence file (and back)")
+    parser.add_argument("input", help="CSV or C file to compile, or .qds file with --decompile")
+    parser.add_argument("-o", "--output", help="output file (default: input name with .qds / stdout)")
+    parser.add_argument("--name", help="sequence name (default: input file or array name)")
+    parser.add_argument("--array", help="C input: array to compile (e.g. dance2 or dance2Array)")
+    parser.add_argument("--beats", action="store_true", help="the duration column is in beats (1, 1/2, 0.75 ...)")
+    parser.add_argument("--v1", action="store_true", help="write the fixed size version 1 format")
+    parser.add_argument("-d", "--decompile", action="store_true", help="turn a .qds file back into steps")
+    parser.add_argument("--format", choices=["csv", "c"], default="csv", help="decompile output format")
+    args = parser.parse_args()
+
+    try:
+        if args.decompile:
+            decompile(args)
+        else:
+            compile_input(args)
+    except (OSError, ValueError, UnicodeDecodeError) as error:
+        sys.exit("qds_compiler: %s" % error)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""
+show_master.py - Be the show master from a PC: send the show clock & start sequences on every robot
+
+Robots on the network follow the show beacons of lib/Show_Sync (UDP port 4210). Any robot can
+be the master (CMD_SHOW from the app), this script does the same job from a PC, so no robot
+has to be picked as the leader & the playlist is in one place.
+
+USAGE:
+  python3 tools/show_master.py dance1 dance2 dance3
+  python3 tools/show_master.py dance1 --gap 6 --lead 1.0
+  python3 tools/show_master.py 32 --address 192.168.4.255      (a loaded sequence, by ID)
+
+NOTES:
+- Sequences are names of the built-in ones or numeric IDs (loaded sequences start at 32)
+- The PC doesn't know how long a sequence takes, the next one starts --gap seconds later
+- Keep the packet layout & timing in sync with lib/Show_Sync/src/Show_Sync.h
+- Only one master per show group - don't send CMD_SHOW to a robot while this runs
+"""
+
+import argparse
+import random
+import socket
+import struct
+import time
+
+MAGIC = 0x57485351          # "QSHW"
+VERSION = 1
+BEACON_S = 0.25             # SHOW_BEACON_MS
+START_BEACON_S = 0.05       # SHOW_START_BEACON_MS
+FOLLOWER_LOCK_S = 1.5       # Beacons before the first start, so every follower has locked
+
+# Built-in sequence IDs (MovementState order)
+SEQUENCES = ["standby", "ready", "forward", "backward", "turn_left", "turn_right", "move_left",
+             "move_right", "wave_hello", "dance1", "dance2", "dance3", "lie_down", "fighting",
+             "push_ups", "sleep"]
+
+
+class Master:
+    def __init__(self, address, port, group, sender_id):
+        self.target = (address, port)
+        self.group = group
+        self.id = sender_id
+        self.epoch = time.monotonic()
+        self.start_count = 0
+        self.start_time = 0
+        self.sequence = 0
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+
+    def now(self):
+        # Show clock in ms, wraps like millis()
+        return int((time.monotonic() - self.epoch) * 1000) & 0xFFFFFFFF
+
+    def beacon(self):
+        packet = struct.pack("<IBBHIIII", MAGIC, VERSION, self.sequence, self.group, self.id,
+                             self.now(), self.start_count, self.start_time)
+        self.sock.sendto(packet, self.target)
+
+    def start(self, sequence, lead_s):
+        self.start_count += 1
+        self.sequence = sequence
+        self.start_time = (self.now() + int(lead_s * 1000)) & 0xFFFFFFFF
+
+    def run_for(self, seconds):
+        # Beacon until the time is up, faster while a start is pending
+        end = time.monotonic() + seconds
+        while time.monotonic() < end:
+            self.beacon()
+            pending = self.start_count and ((self.start_time - self.now()) & 0xFFFFFFFF) < 0x80000000
+            time.sleep(START_BEACON_S if pending else BEACON_S)
+
+
+def sequence_id(name):
+    if name.isdigit():
+        return int(name)
+    if name not in SEQUENCES:
+        raise argparse.ArgumentTypeError("unknown sequence %s (use %s or an ID)" % (name, ", ".join(SEQUENCES)))
+    return SEQUENCES.index(name)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Send the show clock & start sequences on every robot")
+    parser.add_argument("sequences", nargs="+", type=sequence_id, help="sequence names or IDs, played in order")
+    parser.add_argument("--gap", type=float, default=8.0, help="seconds from one start to the next")
+    parser.add_argument("--lead", type=float, default=0.5, help="seconds between a start order & the start")
+    parser.add_argument("--address", default="255.255.255.255", help="broadcast address")
+    parser.add_argument("--port", type=int, default=4210, help="show port (SHOW_SYNC_PORT)")
+    parser.add_argument("--group", type=int, default=1, help="show group")
+    parser.add_argument("--id", type=lambda text: int(text, 0), default=random.getrandbits(32),
+                        help="sender ID (must differ from every robot's chip ID)")
+    args = parser.parse_args()
+
+    master = Master(args.address, args.port, args.group, args.id)
+    master.run_for(FOLLOWER_LOCK_S)
+    for sequence in args.sequences:
+        master.start(sequence, args.lead)
+        print("Start %s at show time %d ms" % (SEQUENCES[sequence] if sequence < len(SEQUENCES) else sequence,
+                                               master.start_time), flush=True)
+        master.run_for(args.gap)
+
+
+if __name__ == "__main__":
+    main()
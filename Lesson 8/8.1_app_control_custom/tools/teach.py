@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""
+teach.py - Teach the robot a new sequence: record, jog the joints, save it under a name
+
+The robot records the pose its servos are commanded to while teach mode is on (lib/Teach_Recorder):
+jog the joints a few degrees at a time from here, or stream poses with pose_stream.py --record.
+Saving writes the keyframes to LittleFS as /seq/<name>.qds, the sequence plays at once (CMD_PLAY
+with the ID in the reply) & is loaded again at the next boot. The keyframes are printed as
+position array rows, to paste into Movement_Driver.cpp or a qds_compiler.py CSV.
+
+USAGE:
+  python3 tools/teach.py shell                         (one connection, commands from the prompt)
+  python3 tools/teach.py record --tolerance 3
+  python3 tools/teach.py jog ULA -10
+  python3 tools/teach.py save stretch
+  python3 tools/teach.py stop | discard
+
+SHELL COMMANDS:
+  record [tolerance]   stop   discard   save NAME   JOINT DELTA (e.g. "ula -10")   play ID   quit
+
+NOTES:
+- Joints are named by their position array column: URP, URA, LRA, LRP, ULP, ULA, LLA, LLP
+- Keep the CMD_* values in sync with src/main.cpp, the robot serves one connection at a time
+  (close the app first)
+- A name is 1-15 letters, digits, '_' or '-', a built-in sequence name can't be used
+"""
+
+import argparse
+import shlex
+import socket
+import sys
+import time
+
+CMD_PLAY = 0x24
+CMD_RECORD = 0x29
+CMD_SAVE = 0x2A
+CMD_JOG = 0x2B
+RECORD_STOP, RECORD_START, RECORD_DISCARD = 0, 1, 2
+JOINTS = ["URP", "URA", "LRA", "LRP", "ULP", "ULA", "LLA", "LLP"]
+
+
+def frame(action, device=0x01, payload=b"\0\0"):
+    # App layout (action at byte 9, device at byte 10), the payload from byte 11 (byte 12 is the parameter)
+    body = bytes([0, 0, 0, 0, 0, 0, action, device]) + payload
+    return bytes([0xFF, 0x55, len(body)]) + body
+
+
+def read_reply(sock, timeout=3.0, quiet=0.3):
+    # Text sent back, until nothing more arrives for a moment
+    reply = b""
+    sock.settimeout(timeout)
+    try:
+        while True:
+            chunk = sock.recv(1024)
+            if not chunk:
+                break
+            reply += chunk
+            sock.settimeout(quiet)
+    except socket.timeout:
+        pass
+    return reply.decode(errors="replace")
+
+
+def joint_index(name):
+    name = name.upper()
+    if name.isdigit() and int(name) < len(JOINTS):
+        return int(name)
+    if name not in JOINTS:
+        raise ValueError("unknown joint %s (%s)" % (name, ", ".join(JOINTS)))
+    return JOINTS.index(name)
+
+
+def command_frame(words):
+    # Frame for one command & whether the robot replies
+    verb = words[0].lower()
+    if verb == "record":
+        tolerance = int(words[1]) if len(words) > 1 else 0
+        return frame(CMD_RECORD, RECORD_START, bytes([0, tolerance])), False
+    if verb == "stop":
+        return frame(CMD_RECORD, RECORD_STOP), False
+    if verb == "discard":
+        return frame(CMD_RECORD, RECORD_DISCARD), False
+    if verb == "save":
+        if len(words) < 2:
+            raise ValueError("save needs a name")
+        return frame(CMD_SAVE, 0x01, words[1].encode()[:15]), True
+    if verb == "play":
+        return frame(CMD_PLAY, int(words[1])), False
+    if verb == "jog":
+        words = words[1:]
+    if len(words) == 2:
+        delta = max(-128, min(127, int(words[1])))
+        return frame(CMD_JOG, joint_index(words[0]), bytes([0, delta & 0xFF])), False
+    raise ValueError("unknown command %s" % " ".join(words))
+
+
+def shell(sock):
+    print("Connected - record, stop, discard, save NAME, JOINT DELTA, play ID, quit")
+    while True:
+        try:
+            line = input("teach> ").strip()
+        except EOFError:
+            break
+        if not line:
+            continue
+        if line in ("quit", "exit"):
+            break
+        try:
+            data, replies = command_frame(shlex.split(line))
+        except (ValueError, IndexError) as error:
+            print(error)
+            continue
+        sock.sendall(data)
+        if replies:
+            print(read_reply(sock), end="")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Record, jog & save a taught sequence")
+    parser.add_argument("command", choices=["shell", "record", "stop", "discard", "save", "jog", "play"])
+    parser.add_argument("args", nargs="*", help="NAME for save, JOINT DELTA for jog, ID for play")
+    parser.add_argument("--tolerance", type=int, default=0, help="merge poses within this many degrees (0 = default)")
+    parser.add_argument("--host", default="192.168.4.1", help="robot address (the access point by default)")
+    parser.add_argument("--port", type=int, default=100, help="control port")
+    args = parser.parse_args()
+
+    sock = socket.create_connection((args.host, args.port), timeout=5)
+    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    try:
+        if args.command == "shell":
+            shell(sock)
+            return
+        words = [args.command] + args.args
+        if args.command == "record":
+            words = ["record", str(args.tolerance)]
+        try:
+            data, replies = command_frame(words)
+        except (ValueError, IndexError) as error:
+            sys.exit(str(error))
+        sock.sendall(data)
+        if replies:
+            print(read_reply(sock), end="")
+        else:
+            time.sleep(0.2)     # Let the robot read the frame before the connection closes
+    finally:
+        sock.close()
+
+
+if __name__ == "__main__":
+    main()
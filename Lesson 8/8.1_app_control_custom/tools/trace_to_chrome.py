@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""
+trace_to_chrome.py - Convert a Trace_Recorder dump into Chrome trace-viewer JSON
+
+Send 'd' in the Serial Monitor (or the CMD_TRACE action over Wi-Fi) and save the output.
+This script finds the "#TRACE" block in the capture and writes a JSON file that can be
+opened in chrome://tracing or https://ui.perfetto.dev as a timeline.
+
+USAGE:
+  python3 tools/trace_to_chrome.py capture.txt > trace.json
+  python3 tools/trace_to_chrome.py capture.txt -o trace.json
+  pio device monitor | python3 tools/trace_to_chrome.py -o trace.json
+
+NOTES:
+- Keep TRACES in sync with the TraceId enum in lib/Trace_Recorder/src/Trace_Recorder.h
+- Only the last dump in the capture is converted (use --all to convert every dump)
+- Timestamps are CPU cycles on the robot, the 32-bit wrap is unrolled with the gap records
+"""
+
+import argparse
+import json
+import sys
+
+STATES = [
+    "standby", "ready", "forward", "backward", "turn_left", "turn_right",
+    "move_left", "move_right", "wave_hello", "dance1", "dance2", "dance3",
+    "lie_down", "fighting", "push_ups", "sleep", "idle", "custom",
+]
+CUSTOM_SEQUENCE_BASE = 32   # IDs of sequences registered at runtime (names are only known on the robot)
+
+
+def state_name(value):
+    if value >= CUSTOM_SEQUENCE_BASE:
+        return "seq%d" % value
+    return STATES[value] if value < len(STATES) else "state%d" % value
+
+
+# Trace ID -> (name, category, argument formatter)
+TRACES = {
+    1: ("loop", "loop", None),
+    2: ("wifi.handleClient", "wifi", None),
+    3: ("motion frame", "motion", None),
+    4: ("servo write", "motion", lambda arg: {"state": state_name(arg)}),
+    5: ("client connected", "wifi", None),
+    6: ("command", "wifi", lambda arg: {"action": "0x%02X" % arg}),
+    7: ("sequence start", "motion", lambda arg: {"sequence": state_name(arg)}),
+    8: ("step", "motion", lambda arg: {"step": arg}),
+    9: ("step late", "motion", lambda arg: {"late_ms": arg}),
+}
+
+WRAP = 1 << 32
+
+
+def read_dumps(lines):
+    """Yield (mhz, [(cycles, phase, id, arg), ...]) for every dump in the capture."""
+    mhz, records = None, None
+    for line in lines:
+        line = line.rstrip("\r\n")
+        marker = line.find("#TR")
+        if marker < 0:
+            continue
+        line = line[marker:]
+
+        if line.startswith("#TRACE "):
+            fields = dict(item.split("=", 1) for item in line[7:].split() if "=" in item)
+            mhz, records = int(fields.get("mhz", "80")), []
+        elif line.startswith("#TREND") and records is not None:
+            yield mhz, records
+            mhz, records = None, None
+        elif line.startswith("#TR ") and records is not None:
+            hex_record = line[4:].strip()
+            if len(hex_record) != 16:
+                continue
+            try:
+                records.append((int(hex_record[0:8], 16), chr(int(hex_record[8:10], 16)),
+                                int(hex_record[10:12], 16), int(hex_record[12:16], 16)))
+            except ValueError:
+                continue
+
+
+def to_events(mhz, records):
+    """Turn the records into trace events with timestamps in microseconds."""
+    events = []
+    time, last_raw = 0, None
+
+    for raw, phase, trace_id, arg in records:
+        if last_raw is not None:
+            delta = (raw - last_raw) % WRAP
+            if phase == "G":
+                # Long quiet period - add the whole wraps the counter made meanwhile
+                expected = arg * mhz * 1000000
+                delta += round((expected - delta) / WRAP) * WRAP
+            elif delta >= WRAP // 2:
+                delta -= WRAP     # Poll span begins are written after the events inside them
+            time += delta
+        last_raw = raw
+
+        if phase == "G":
+            continue
+
+        name, category, formatter = TRACES.get(trace_id, ("trace%d" % trace_id, "other", None))
+        event = {"name": name, "cat": category, "ph": phase, "ts": time / mhz, "pid": 1, "tid": 1}
+        if phase == "i":
+            event["s"] = "t"
+        if formatter and phase != "E":
+            event["args"] = formatter(arg)
+        events.append(event)
+
+    # Sort by time (stable, so an end stays after a begin with the same timestamp)
+    events.sort(key=lambda event: event["ts"])
+    if events:
+        start = events[0]["ts"]
+        for event in events:
+            event["ts"] = round(event["ts"] - start, 3)
+
+    # Drop ends whose begin was overwritten & close spans still open at the end of the dump
+    matched, open_spans = [], []
+    for event in events:
+        if event["ph"] == "B":
+            open_spans.append(event["name"])
+        elif event["ph"] == "E":
+            if event["name"] not in open_spans:
+                continue
+            open_spans.remove(event["name"])
+        matched.append(event)
+    end = matched[-1]["ts"] if matched else 0
+    for name in reversed(open_spans):
+        matched.append({"name": name, "ph": "E", "ts": end, "pid": 1, "tid": 1})
+
+    return matched
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert a robot trace dump to Chrome trace JSON")
+    parser.add_argument("input", nargs="?", help="capture file (default: stdin)")
+    parser.add_argument("-o", "--output", help="output JSON file (default: stdout)")
+    parser.add_argument("--all", action="store_true", help="convert every dump, not just the last")
+    args = parser.parse_args()
+
+    source = open(args.input, errors="replace") if args.input else sys.stdin
+    dumps = list(read_dumps(source))
+    if not dumps:
+        sys.exit("No #TRACE dump found")
+
+    events = []
+    for pid, (mhz, records) in enumerate(dumps if args.all else dumps[-1:], start=1):
+        for event in to_events(mhz, records):
+            event["pid"] = pid
+            events.append(event)
+        events.append({"name": "process_name", "ph": "M", "pid": pid, "args": {"name": "robot dump %d" % pid}})
+        events.append({"name": "thread_name", "ph": "M", "pid": pid, "tid": 1, "args": {"name": "main"}})
+
+    output = open(args.output, "w") if args.output else sys.stdout
+    json.dump({"traceEvents": events, "displayTimeUnit": "ms"}, output, indent=1)
+    output.write("\n")
+
+
+if __name__ == "__main__":
+    main()
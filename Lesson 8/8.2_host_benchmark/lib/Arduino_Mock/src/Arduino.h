@@ -0,0 +1,149 @@
+/*
+ * Arduino.h - Minimal Arduino / ESP8266 core replacement for building the robot libraries on a PC
+ * 
+ * Only what the 8.1_app_control_custom libraries use is provided. Time doesn't pass on its own:
+ * millis(), micros() & ESP.getCycleCount() read a virtual clock that the benchmarks move forward
+ * with mockAdvanceMicros(), so every run sees exactly the same robot timing.
+ * 
+ * NOTES:
+ * - Serial output goes to stderr, so stdout only carries the benchmark results
+ * - The cycle counter runs at the 80MHz the robot uses by default
+ */
+
+
+#ifndef ARDUINO_MOCK_H
+#define ARDUINO_MOCK_H
+
+// INCLUDES
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+
+// DEFINES
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HEX 16
+#define DEC 10
+
+// NodeMCU pin names
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+#define LED_BUILTIN 2
+
+#define INPUT 0
+#define OUTPUT 1
+#define LOW 0
+#define HIGH 1
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+
+#define PI 3.1415926535897932384626433832795
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+
+#define constrain(x, low, high) ((x) < (low) ? (low) : ((x) > (high) ? (high) : (x)))
+
+// Like the ESP8266 core: std::min / std::max instead of macros (so <chrono> etc. still compile)
+using std::min;
+using std::max;
+
+// Virtual clock
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);                 // Moves the virtual clock forward
+void yield();
+void mockAdvanceMicros(unsigned long us);
+void mockSetMicros(unsigned long us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+long map(long value, long fromLow, long fromHigh, long toLow, long toHigh);
+
+// CLASSES
+class Print;
+
+class Printable {
+  public:
+    virtual ~Printable() {}
+    virtual size_t printTo(Print &p) const = 0;
+};
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    virtual int availableForWrite() { return 128; }
+    virtual void flush() {}
+
+    size_t print(const char *text) { return write((const uint8_t *)text, strlen(text)); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(int value, int base = DEC) { return print((long)value, base); }
+    size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+    size_t print(const Printable &value) { return value.printTo(*this); }
+
+    size_t println() { return print("\r\n"); }
+    template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+    template <typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() { return 0; }
+    virtual int read() { return -1; }
+    virtual int peek() { return -1; }
+};
+
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long baud) { (void)baud; }
+    void setTimeout(unsigned long ms) { (void)ms; }
+    size_t write(uint8_t c) override;
+    using Print::write;
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+// STRUCTS
+struct rst_info {
+  uint32_t reason;
+};
+
+// CLASSES
+class EspClass {
+  public:
+    uint32_t getCycleCount();                   // Virtual clock at 80 cycles per us
+    uint8_t getCpuFreqMHz() { return 80; }
+    uint32_t getFreeHeap() { return 40000; }
+    uint8_t getHeapFragmentation() { return 0; }
+    uint32_t getMaxFreeBlockSize() { return 40000; }
+    uint32_t getFreeContStack() { return 3000; }
+    uint32_t getChipId() { return 0x00C0FFEE; }
+    rst_info *getResetInfoPtr();
+    void restart() {}
+};
+
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * Arduino_Mock.cpp - Implementation of the host replacements for the Arduino / ESP8266 core
+ * 
+ * IMPLEMENTATION:
+ * - Virtual clock: a single microsecond counter behind millis(), micros() & the cycle counter
+ * - Print: number formatting & printf() on top of write()
+ * - Simulated app connection: a byte stream plus the number of bytes currently readable
+ */
+
+
+// INCLUDES
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <ESP8266mDNS.h>
+#include <stdarg.h>
+
+// Shared instances
+HardwareSerial Serial;
+EspClass ESP;
+ESP8266WiFiClass WiFi;
+MDNSResponder MDNS;
+
+// Virtual clock
+static unsigned long clockMicros = 0;
+
+unsigned long millis() { return clockMicros / 1000; }
+unsigned long micros() { return clockMicros; }
+void delay(unsigned long ms) { clockMicros += ms * 1000; }
+void yield() {}
+void mockAdvanceMicros(unsigned long us) { clockMicros += us; }
+void mockSetMicros(unsigned long us) { clockMicros = us; }
+
+void pinMode(uint8_t pin, uint8_t mode) { (void)pin; (void)mode; }
+void digitalWrite(uint8_t pin, uint8_t value) { (void)pin; (void)value; }
+
+long map(long value, long fromLow, long fromHigh, long toLow, long toHigh) {
+  return (value - fromLow) * (toHigh - toLow) / (fromHigh - fromLow) + toLow;
+}
+
+// Print
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t written = 0;
+  while (size--) written += write(*buffer++);
+  return written;
+}
+
+size_t Print::print(long value, int base) {
+  char text[24];
+  snprintf(text, sizeof(text), base == HEX ? "%lX" : "%ld", value);
+  return print(text);
+}
+
+size_t Print::print(unsigned long value, int base) {
+  char text[24];
+  snprintf(text, sizeof(text), base == HEX ? "%lX" : "%lu", value);
+  return print(text);
+}
+
+size_t Print::print(double value, int digits) {
+  char text[32];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  return print(text);
+}
+
+size_t Print::printf(const char *format, ...) {
+  char text[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  if (length < 0) return 0;
+  return write((const uint8_t *)text, (size_t)length < sizeof(text) ? length : sizeof(text) - 1);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  fputc(c, stderr);
+  return 1;
+}
+
+// ESP
+uint32_t EspClass::getCycleCount() {
+  return (uint32_t)(clockMicros * 80);
+}
+
+rst_info *EspClass::getResetInfoPtr() {
+  static rst_info info = {0};
+  return &info;
+}
+
+// Simulated app connection
+static const uint8_t *streamData = nullptr;
+static size_t streamSize = 0;
+static size_t streamPosition = 0;
+static size_t readableBytes = 0;
+static bool clientConnected = false;
+
+void mockConnect(const uint8_t *data, size_t size) {
+  streamData = data;
+  streamSize = size;
+  streamPosition = 0;
+  readableBytes = 0;
+  clientConnected = true;
+}
+
+void mockDeliver(size_t bytes) {
+  readableBytes += bytes;
+  if (readableBytes > streamSize - streamPosition) readableBytes = streamSize - streamPosition;
+}
+
+size_t mockRemaining() { return streamSize - streamPosition; }
+void mockDisconnect() { clientConnected = false; }
+
+int WiFiClient::available() { return clientConnected ? (int)readableBytes : 0; }
+
+int WiFiClient::read() {
+  if (!clientConnected || readableBytes == 0) return -1;
+  readableBytes--;
+  return streamData[streamPosition++];
+}
+
+bool WiFiClient::connected() { return clientConnected; }
+
+bool ESP8266WiFiClass::softAP(const char *ssid, const char *password, int channel, int hidden, int maxConnections) {
+  (void)ssid; (void)password; (void)channel; (void)hidden; (void)maxConnections;
+  return true;
+}
+
+uint8_t ESP8266WiFiClass::softAPgetStationNum() { return clientConnected ? 1 : 0; }
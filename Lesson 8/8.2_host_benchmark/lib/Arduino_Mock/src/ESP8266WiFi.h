@@ -0,0 +1,90 @@
+/*
+ * ESP8266WiFi.h - Wi-Fi replacement for host builds
+ * 
+ * There is a single simulated app connection. A benchmark hands it a byte stream with
+ * mockConnect() & decides how many bytes the next handleClient() sees with mockDeliver(),
+ * so both whole frames & frames split over many TCP segments can be replayed.
+ * The channel scan finds no access points & there is no network to join.
+ * UDP (WiFiUdp.h) uses real sockets on the PC, so several host builds can talk over localhost.
+ */
+
+
+#ifndef ESP8266WIFI_MOCK_H
+#define ESP8266WIFI_MOCK_H
+
+// INCLUDES
+#include <Arduino.h>
+
+// ENUMS
+enum WiFiMode_t { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA };
+enum wl_status_t { WL_IDLE_STATUS, WL_NO_SSID_AVAIL, WL_SCAN_COMPLETED, WL_CONNECTED, WL_CONNECT_FAILED,
+                   WL_CONNECTION_LOST, WL_WRONG_PASSWORD, WL_DISCONNECTED };
+
+// DEFINES
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED  (-2)
+
+// Simulated app connection
+void mockConnect(const uint8_t *data, size_t size);   // Connect a client that will send data
+void mockDeliver(size_t bytes);                       // Make the next bytes of the stream readable
+size_t mockRemaining();                               // Bytes not read yet
+void mockDisconnect();
+
+// CLASSES
+class IPAddress : public Printable {
+  public:
+    IPAddress() {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes{a, b, c, d} {}
+    uint8_t operator[](int index) const { return bytes[index]; }
+    size_t printTo(Print &p) const override { return p.printf("%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]); }
+
+  private:
+    uint8_t bytes[4] = {0, 0, 0, 0};
+};
+
+class WiFiClient : public Stream {
+  public:
+    size_t write(uint8_t c) override { (void)c; return 1; }
+    size_t write(const uint8_t *buffer, size_t size) override { (void)buffer; return size; }
+    int available() override;
+    int read() override;
+    bool connected();
+    void stop() {}
+    void setNoDelay(bool noDelay) { (void)noDelay; }
+    operator bool() { return connected(); }
+};
+
+class WiFiServer {
+  public:
+    WiFiServer(uint16_t port) { (void)port; }
+    void begin() {}
+    WiFiClient accept() { return WiFiClient(); }
+    WiFiClient available() { return WiFiClient(); }
+};
+
+class ESP8266WiFiClass {
+  public:
+    bool mode(WiFiMode_t mode) { (void)mode; return true; }
+    bool softAP(const char *ssid, const char *password, int channel = 1, int hidden = 0, int maxConnections = 4);
+    uint8_t softAPgetStationNum();
+    IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+    int8_t scanNetworks(bool async = false, bool showHidden = false) { (void)async; (void)showHidden; return 0; }
+    int8_t scanComplete() { return 0; }
+    void scanDelete() {}
+    int32_t channel(uint8_t i) { (void)i; return 0; }
+    int32_t RSSI(uint8_t i) { (void)i; return 0; }
+    wl_status_t begin(const char *ssid, const char *password) { (void)ssid; (void)password; return WL_DISCONNECTED; }
+    wl_status_t status() { return WL_DISCONNECTED; }
+    bool isConnected() { return false; }
+    bool disconnect(bool wifiOff = false) { (void)wifiOff; return true; }
+    void persistent(bool persistent) { (void)persistent; }
+    bool setAutoReconnect(bool autoReconnect) { (void)autoReconnect; return true; }
+    bool hostname(const char *name) { (void)name; return true; }
+    IPAddress localIP() { return IPAddress(); }
+    int32_t channel() { return 0; }
+    int32_t RSSI() { return 0; }
+};
+
+extern ESP8266WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,28 @@
+/*
+ * ESP8266mDNS.h - mDNS replacement for host builds
+ * 
+ * Nothing is announced, the calls only succeed.
+ */
+
+
+#ifndef ESP8266MDNS_MOCK_H
+#define ESP8266MDNS_MOCK_H
+
+// INCLUDES
+#include <Arduino.h>
+
+// CLASSES
+class MDNSResponder {
+  public:
+    bool begin(const char *hostname) { (void)hostname; return true; }
+    bool addService(const char *service, const char *protocol, uint16_t port) { (void)service; (void)protocol; (void)port; return true; }
+    bool addServiceTxt(const char *service, const char *protocol, const char *key, const char *value) {
+      (void)service; (void)protocol; (void)key; (void)value;
+      return true;
+    }
+    bool update() { return true; }
+};
+
+extern MDNSResponder MDNS;
+
+#endif
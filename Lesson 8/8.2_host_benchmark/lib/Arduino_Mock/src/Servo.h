@@ -0,0 +1,33 @@
+/*
+ * Servo.h - Servo library replacement for host builds
+ * 
+ * Keeps the last value written, so a benchmark can check the pose & the compiler
+ * can't drop the writes.
+ */
+
+
+#ifndef SERVO_MOCK_H
+#define SERVO_MOCK_H
+
+// INCLUDES
+#include <Arduino.h>
+
+// CLASSES
+class Servo {
+  public:
+    uint8_t attach(int pin) { this->pin = pin; return 0; }
+    uint8_t attach(int pin, int minUs, int maxUs) { (void)minUs; (void)maxUs; return attach(pin); }
+    uint8_t attach(int pin, int minUs, int maxUs, int value) { this->value = value; return attach(pin, minUs, maxUs); }
+    void detach() { pin = -1; }
+    bool attached() const { return pin >= 0; }
+
+    void write(int value) { this->value = value; }
+    void writeMicroseconds(int value) { this->value = value; }
+    int read() const { return value; }
+
+  private:
+    int pin = -1;
+    volatile int value = 0;
+};
+
+#endif
@@ -0,0 +1,25 @@
+/*
+ * Ticker.h - Ticker library replacement for host builds
+ * 
+ * The callbacks are never called, benchmarks drive update() themselves.
+ */
+
+
+#ifndef TICKER_MOCK_H
+#define TICKER_MOCK_H
+
+// INCLUDES
+#include <Arduino.h>
+
+// CLASSES
+class Ticker {
+  public:
+    template <typename T> void attach_ms(uint32_t ms, void (*callback)(T), T arg) { (void)ms; (void)callback; (void)arg; }
+    void attach_ms(uint32_t ms, void (*callback)()) { (void)ms; (void)callback; }
+    template <typename T> void once_ms(uint32_t ms, void (*callback)(T), T arg) { (void)ms; (void)callback; (void)arg; }
+    void once_ms(uint32_t ms, void (*callback)()) { (void)ms; (void)callback; }
+    void detach() {}
+    bool active() const { return false; }
+};
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * WiFiUdp.cpp - Implementation of the host UDP replacement on POSIX sockets
+ * 
+ * IMPLEMENTATION:
+ * - open(): Creates the non-blocking socket (broadcasts allowed) on first use
+ * - begin(): Binds the shared port on every interface
+ * - parsePacket(): Reads the next datagram into rxBuffer (the rest of the previous one is dropped)
+ * - beginPacket() / write() / endPacket(): Collect the datagram & send it with one sendto()
+ */
+
+
+// INCLUDES
+#include "WiFiUdp.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// HELPER METHODS
+bool WiFiUDP::open() {
+  if (fd >= 0) return true;
+
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) return false;
+
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+#ifdef SO_REUSEPORT
+  setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+#endif
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return true;
+}
+
+// PUBLIC METHODS
+uint8_t WiFiUDP::begin(uint16_t port) {
+  stop();
+  if (!open()) return 0;
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (bind(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+    stop();
+    return 0;
+  }
+  return 1;
+}
+
+void WiFiUDP::stop() {
+  if (fd >= 0) close(fd);
+  fd = -1;
+  packetSize = 0;
+  packetPosition = 0;
+}
+
+int WiFiUDP::parsePacket() {
+  packetSize = 0;
+  packetPosition = 0;
+  if (fd < 0) return 0;
+
+  sockaddr_in sender = {};
+  socklen_t senderSize = sizeof(sender);
+  ssize_t size = recvfrom(fd, rxBuffer, sizeof(rxBuffer), 0, (sockaddr*)&sender, &senderSize);
+  if (size <= 0) return 0;
+
+  uint32_t ip = ntohl(sender.sin_addr.s_addr);
+  remoteAddress = IPAddress(ip >> 24, ip >> 16, ip >> 8, ip);
+  remotePortNumber = ntohs(sender.sin_port);
+  packetSize = (int)size;
+  return packetSize;
+}
+
+int WiFiUDP::read(uint8_t* buffer, size_t size) {
+  int count = min((int)size, available());
+  memcpy(buffer, rxBuffer + packetPosition, count);
+  packetPosition += count;
+  return count;
+}
+
+int WiFiUDP::read() {
+  return available() > 0 ? rxBuffer[packetPosition++] : -1;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+  if (!open()) return 0;
+
+  txAddress = ip;
+  txPort = port;
+  txLength = 0;
+  return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t* buffer, size_t size) {
+  size_t count = min(size, sizeof(txBuffer) - txLength);
+  memcpy(txBuffer + txLength, buffer, count);
+  txLength += count;
+  return count;
+}
+
+int WiFiUDP::endPacket() {
+  if (fd < 0) return 0;
+
+  // Keep broadcasts on the loopback interface
+  bool broadcast = txAddress[0] == 255 && txAddress[1] == 255 && txAddress[2] == 255 && txAddress[3] == 255;
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = broadcast ? inet_addr("127.255.255.255") :
+    htonl((uint32_t)txAddress[0] << 24 | txAddress[1] << 16 | txAddress[2] << 8 | txAddress[3]);
+  address.sin_port = htons(txPort);
+
+  ssize_t sent = sendto(fd, txBuffer, txLength, 0, (sockaddr*)&address, sizeof(address));
+  txLength = 0;
+  return sent >= 0 ? 1 : 0;
+}
@@ -0,0 +1,60 @@
+/*
+ * WiFiUdp.h - UDP replacement for host builds
+ * 
+ * Unlike the simulated app connection this is a real, non-blocking UDP socket, so several
+ * host builds (one robot each) can exchange datagrams over localhost.
+ * 
+ * NOTES:
+ * - The port is bound with SO_REUSEADDR (& SO_REUSEPORT), every process on the PC that
+ *   listens on it gets a copy of a broadcast
+ * - The limited broadcast address 255.255.255.255 is sent to the loopback broadcast address
+ *   127.255.255.255 instead, so a simulated show never leaves the PC (Linux)
+ */
+
+
+#ifndef WIFIUDP_MOCK_H
+#define WIFIUDP_MOCK_H
+
+// INCLUDES
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+// CLASSES
+class WiFiUDP {
+  public:
+    ~WiFiUDP() { stop(); }
+
+    uint8_t begin(uint16_t port);       // 1 = bound
+    void stop();
+    int parsePacket();                  // Size of the next datagram, 0 if none is waiting
+    int available() const { return packetSize - packetPosition; }
+    int read(uint8_t* buffer, size_t size);
+    int read();
+    IPAddress remoteIP() const { return remoteAddress; }
+    uint16_t remotePort() const { return remotePortNumber; }
+
+    int beginPacket(IPAddress ip, uint16_t port);
+    size_t write(const uint8_t* buffer, size_t size);
+    size_t write(uint8_t value) { return write(&value, 1); }
+    int endPacket();                    // 1 = sent
+
+  private:
+    static const size_t MAX_PACKET = 1472;
+
+    int fd = -1;
+    uint8_t rxBuffer[MAX_PACKET];
+    int packetSize = 0;
+    int packetPosition = 0;
+    IPAddress remoteAddress;
+    uint16_t remotePortNumber = 0;
+
+    uint8_t txBuffer[MAX_PACKET];
+    size_t txLength = 0;
+    IPAddress txAddress;
+    uint16_t txPort = 0;
+
+    // Helper methods
+    bool open();
+};
+
+#endif
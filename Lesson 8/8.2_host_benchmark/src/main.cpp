@@ -0,0 +1,261 @@
+/*
+ * Host benchmarks for the motion engine & the app protocol parser of 8.1_app_control_custom.
+ *
+ * HOW IT WORKS:
+ * - The real Movement_Driver & WiFi_Driver sources are built for the PC against lib/Arduino_Mock
+ * - Robot time is virtual (see Arduino.h), the benchmarks only measure the PC time spent in
+ *   the library code, so the numbers are repeatable between runs & machines of the same kind
+ * - Every benchmark runs REPEATS times, the median & the fastest run are reported
+ * - Results are printed to stdout as JSON, compare two runs with tools/compare_benchmarks.py
+ *
+ * BENCHMARKS:
+ * - movement_update: robot.update() per call for each of the 16 sequences, with 1 ms of robot
+ *   time between calls (stepped & interpolated frames)
+ * - parser: WiFiDriver::feedByte() per byte on a clean & a noisy byte stream
+ * - handle_client: wifi.handleClient() per byte with whole frames & with frames split
+ *   over 1 to 8 byte segments
+ * - interpolation: MovementDriver::interpolatePose() per pose
+ *
+ * NOTES:
+ * - Host numbers show regressions & relative costs, they are not ESP8266 timings
+ *   (see the 8.3_cycle_benchmark project for those)
+ * - Usage: program [--repeats N] [--quick]
+ */
+
+
+// INCLUDES
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include "Movement_Driver.h"
+#include "WiFi_Driver.h"
+
+// DEFINES
+#define DEFAULT_REPEATS 5
+#define STREAM_FRAMES   20000   // Frames in the generated protocol streams
+
+// STRUCTS
+struct Result {
+  std::string suite;
+  std::string name;
+  std::string variant;
+  const char *unit;             // What one operation is
+  unsigned long ops;            // Operations per run
+  double nsPerOp;               // Median run
+  double nsPerOpMin;            // Fastest run
+  long frames;                  // Commands decoded per run (parser benchmarks only, else -1)
+};
+
+// GLOBAL VARIABLES
+int repeats = DEFAULT_REPEATS;
+int sizeDivider = 1;            // --quick makes every run 10x shorter
+std::vector<Result> results;
+volatile long sink = 0;         // Keeps the optimizer from removing benchmarked work
+
+// Sequences in MovementState order (STANDBY .. SLEEP)
+typedef void (MovementDriver::*MovementCommand)();
+const MovementCommand movementCommands[16] = {
+  &MovementDriver::standby,  &MovementDriver::ready,     &MovementDriver::forward,  &MovementDriver::backward,
+  &MovementDriver::turnLeft, &MovementDriver::turnRight, &MovementDriver::moveLeft, &MovementDriver::moveRight,
+  &MovementDriver::waveHello, &MovementDriver::dance1,   &MovementDriver::dance2,   &MovementDriver::dance3,
+  &MovementDriver::lieDown,  &MovementDriver::fighting,  &MovementDriver::pushUps,  &MovementDriver::sleep
+};
+
+
+// HELPER METHODS
+// Time one run of a benchmark body that performs `ops` operations
+template <typename Body>
+void runBenchmark(const char *suite, const std::string &name, const char *variant, const char *unit, Body body,
+                  const long *frames = nullptr) {
+  std::vector<double> runs;
+  unsigned long ops = 0;
+
+  for (int run = 0; run < repeats; run++) {
+    auto start = std::chrono::steady_clock::now();
+    ops = body();
+    auto stop = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+    runs.push_back(ops ? ns / ops : 0);
+  }
+
+  std::sort(runs.begin(), runs.end());
+  results.push_back({suite, name, variant, unit, ops, runs[runs.size() / 2], runs[0], frames ? *frames : -1});
+  fprintf(stderr, "%-16s %-12s %-12s %10.1f ns/%s\n", suite, name.c_str(), variant, runs[runs.size() / 2], unit);
+}
+
+// One app frame: 0xFF 0x55, length, then the action at byte 9, device at 10 & movement type at 12
+void appendFrame(std::vector<uint8_t> &stream, uint8_t action, uint8_t movementType) {
+  const uint8_t frame[13] = {0xFF, 0x55, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, action, 0x01, 0x00, movementType};
+  stream.insert(stream.end(), frame, frame + sizeof(frame));
+}
+
+// Back to back frames cycling through the movement & action commands
+std::vector<uint8_t> cleanStream(int frames) {
+  std::vector<uint8_t> stream;
+  for (int i = 0; i < frames; i++) {
+    if (i % 2 == 0) appendFrame(stream, 1, 1 + (i / 2) % 6);   // CMD_RUN + movement type
+    else appendFrame(stream, 3 + (i / 2) % 10, 0);             // Pose / dance actions
+  }
+  return stream;
+}
+
+// Frames separated by random bytes, with extra 0xFF bytes & broken preambles thrown in
+std::vector<uint8_t> noisyStream(int frames) {
+  std::vector<uint8_t> stream;
+  uint32_t seed = 12345;
+  auto random = [&seed]() { seed = seed * 1103515245 + 12345; return (seed >> 16) & 0x7FFF; };
+
+  for (int i = 0; i < frames; i++) {
+    int noise = random() % 16;
+    for (int n = 0; n < noise; n++) {
+      uint32_t pick = random() % 8;
+      stream.push_back(pick == 0 ? 0xFF : pick == 1 ? 0x55 : (uint8_t)random());
+    }
+    appendFrame(stream, 1, 1 + i % 6);
+  }
+  return stream;
+}
+
+
+// BENCHMARKS
+// robot.update() per call over complete runs of every sequence
+void benchmarkMovementUpdate() {
+  const unsigned long minimumCalls = 200000 / sizeDivider;
+
+  for (int interpolated = 0; interpolated < 2; interpolated++) {
+    for (int state = STANDBY; state <= SLEEP; state++) {
+      runBenchmark("movement_update", MovementDriver::getStateName((MovementState)state),
+                   interpolated ? "interpolated" : "stepped", "call", [&]() {
+        MovementDriver robot;
+        robot.begin();
+        robot.setInterpolation(interpolated);
+        mockSetMicros(0);
+
+        unsigned long calls = 0;
+        while (calls < minimumCalls) {
+          (robot.*movementCommands[state])();
+          do {
+            mockAdvanceMicros(1000);
+            robot.update();
+            calls++;
+          } while (robot.isBusy());
+        }
+        return calls;
+      });
+    }
+  }
+}
+
+// WiFiDriver::feedByte() per byte
+void benchmarkParser() {
+  const std::vector<uint8_t> streams[2] = {cleanStream(STREAM_FRAMES / sizeDivider), noisyStream(STREAM_FRAMES / sizeDivider)};
+  const char *names[2] = {"clean", "noisy"};
+
+  for (int i = 0; i < 2; i++) {
+    const std::vector<uint8_t> &stream = streams[i];
+    long frames = 0;
+    runBenchmark("parser", names[i], "feed_byte", "byte", [&]() {
+      WiFiDriver wifi;
+      WiFiDriver::CommandData cmd;
+      frames = 0;
+      for (uint8_t c : stream) {
+        if (wifi.feedByte(c, cmd)) {
+          frames++;
+          sink += cmd.action;
+        }
+      }
+      return (unsigned long)stream.size();
+    }, &frames);
+
+    // Noise can start a false frame (0xFF 0x55 + random length) that swallows the next real one
+    fprintf(stderr, "parser %s: decoded %ld of %d frames\n", names[i], frames, STREAM_FRAMES / sizeDivider);
+  }
+}
+
+// wifi.handleClient() per byte with different TCP segment sizes
+void benchmarkHandleClient() {
+  const std::vector<uint8_t> stream = cleanStream(STREAM_FRAMES / sizeDivider);
+  const int maxSegments[2] = {0, 8};    // 0 = everything readable at once
+  const char *names[2] = {"whole", "fragmented"};
+
+  for (int i = 0; i < 2; i++) {
+    long frames = 0;
+    runBenchmark("handle_client", names[i], "clean", "byte", [&]() {
+      WiFiDriver wifi;
+      frames = 0;
+      uint32_t seed = 1;
+      mockConnect(stream.data(), stream.size());
+      if (maxSegments[i] == 0) mockDeliver(stream.size());
+
+      while (mockRemaining() > 0) {
+        if (maxSegments[i] > 0) {
+          seed = seed * 1103515245 + 12345;
+          mockDeliver(1 + (seed >> 16) % maxSegments[i]);
+        }
+        WiFiDriver::CommandData cmd = wifi.handleClient();
+        if (cmd.isValid) {
+          frames++;
+          sink += cmd.action;
+        }
+      }
+      mockDisconnect();
+      return (unsigned long)stream.size();
+    }, &frames);
+  }
+}
+
+// MovementDriver::interpolatePose() per pose
+void benchmarkInterpolation() {
+  const unsigned long poses = 2000000 / sizeDivider;
+  int from[8], to[8], pose[8];
+  for (int i = 0; i < 8; i++) {
+    from[i] = 20 + i * 15;
+    to[i] = 160 - i * 15;
+  }
+
+  runBenchmark("interpolation", "pose", "linear", "pose", [&]() {
+    for (unsigned long i = 0; i < poses; i++) {
+      MovementDriver::interpolatePose(from, to, i % 250, 240, pose);
+      sink += pose[i & 7];
+    }
+    return poses;
+  });
+}
+
+
+// Print all results as one JSON document
+void printResults() {
+  printf("{\n  \"benchmark\": \"8.1_app_control_custom host\",\n  \"repeats\": %d,\n  \"results\": [\n", repeats);
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result &r = results[i];
+    printf("    {\"suite\": \"%s\", \"name\": \"%s\", \"variant\": \"%s\", \"unit\": \"%s\", "
+           "\"ops\": %lu, \"ns_per_op\": %.2f, \"ns_per_op_min\": %.2f",
+           r.suite.c_str(), r.name.c_str(), r.variant.c_str(), r.unit, r.ops, r.nsPerOp, r.nsPerOpMin);
+    if (r.frames >= 0) printf(", \"frames\": %ld", r.frames);
+    printf("}%s\n", i + 1 < results.size() ? "," : "");
+  }
+  printf("  ]\n}\n");
+}
+
+
+// MAIN
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) {
+      repeats = max(1, atoi(argv[++i]));
+    }
+    else if (strcmp(argv[i], "--quick") == 0) {
+      sizeDivider = 10;
+    }
+  }
+
+  benchmarkMovementUpdate();
+  benchmarkParser();
+  benchmarkHandleClient();
+  benchmarkInterpolation();
+  printResults();
+  return 0;
+}
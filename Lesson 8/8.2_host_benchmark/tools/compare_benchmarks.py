@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""
+compare_benchmarks.py - Compare two host benchmark result files & flag regressions
+
+USAGE:
+  pio run -e native -t exec > baseline.json        (on the known good commit)
+  pio run -e native -t exec > current.json         (on the change)
+  python3 tools/compare_benchmarks.py baseline.json current.json
+  python3 tools/compare_benchmarks.py baseline.json current.json --threshold 15
+
+NOTES:
+- Benchmarks are matched on suite, name & variant, ns_per_op_min is compared (the fastest run
+  is the least disturbed by other processes)
+- Exits with status 1 when any benchmark got slower than the threshold (default 10%)
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    # PlatformIO may print build lines before the JSON when run with -t exec
+    with open(path) as source:
+        text = source.read()
+    start = text.find("{")
+    if start < 0:
+        sys.exit("%s: no benchmark results found" % path)
+    results = json.loads(text[start:text.rfind("}") + 1])["results"]
+    return {(r["suite"], r["name"], r["variant"]): r for r in results}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two host benchmark runs")
+    parser.add_argument("baseline", help="results of the known good build")
+    parser.add_argument("current", help="results of the build to check")
+    parser.add_argument("--threshold", type=float, default=10.0, help="allowed slowdown in %% (default 10)")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+    regressions = 0
+
+    print("%-16s %-12s %-12s %12s %12s %8s" % ("SUITE", "NAME", "VARIANT", "BASE_NS", "NEW_NS", "CHANGE"))
+    for key in sorted(set(baseline) | set(current)):
+        if key not in baseline or key not in current:
+            print("%-16s %-12s %-12s %s" % (key + ("only in " + ("current" if key in current else "baseline"),)))
+            continue
+
+        old = baseline[key]["ns_per_op_min"]
+        new = current[key]["ns_per_op_min"]
+        change = (new - old) / old * 100.0 if old > 0 else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print("%-16s %-12s %-12s %12.2f %12.2f %+7.1f%%%s" % (key + (old, new, change, flag)))
+
+    if regressions:
+        print("\n%d benchmark(s) slower than %.0f%%" % (regressions, args.threshold))
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,273 @@
+/*
+ * Cycle count benchmarks of the servo, protocol & loop() code, measured on the robot itself.
+ *
+ * HOW IT WORKS:
+ * - Every benchmark is timed with ESP.getCycleCount() call by call, the fastest & the
+ *   average call are kept (Wi-Fi interrupts make single calls slower, the fastest shows
+ *   the cost of the code itself)
+ * - The cost of an empty benchmark call is measured first & taken off every result
+ * - The whole set runs at 80MHz & then again at 160MHz, the summary table shows both
+ *   so the CPU frequency modes can be compared
+ * - The "client" row needs the control app (or any TCP client) connected to QuadBot port 100,
+ *   the sketch waits CLIENT_WAIT_MS for one before each run & skips the row if none comes
+ *
+ * BENCHMARKS:
+ * - servo.write() & servo.writeMicroseconds() on one servo
+ * - robot.writePose() with all 8 joints changing & with nothing to change
+ * - WiFiDriver::feedByte() per byte of an app command frame
+ * - robot.update() with no step due
+ * - One loop() pass of the app (scheduler with the motion & commands tasks), without and
+ *   with a connected client
+ *
+ * NOTES:
+ * - The servos move between the centre point (90) & 91 degrees, fit the robot like in
+ *   lesson 8.0.1 or unplug the servo power before running this
+ * - Open the Serial Monitor (115200) to see the results, send any character to run again
+ *   (close the app first, or the "no client" row is measured with the client still connected)
+ */
+
+
+// INCLUDES
+#include <Arduino.h>
+#include <Servo.h>
+#include "Movement_Driver.h"
+#include "WiFi_Driver.h"
+#include "Task_Scheduler.h"
+
+extern "C" {
+#include <user_interface.h>   // system_update_cpu_freq()
+}
+
+// DEFINES
+#define ITERATIONS      1000      // Calls per benchmark
+#define CLIENT_WAIT_MS  30000     // How long to wait for a client before the "client" row
+#define BENCHMARK_COUNT 10
+
+// STRUCTS
+struct BenchmarkResult {
+  uint32_t minCycles;
+  uint32_t avgCycles;
+  bool skipped;
+};
+
+// GLOBAL VARIABLES
+const char* ssid = "QuadBot";
+const char* password = "12345678";
+
+MovementDriver robot;
+WiFiDriver wifi;
+TaskScheduler scheduler;
+Servo testServo;                  // Servo signal on the free D3 pin for the single servo rows (nothing connected)
+
+const int centrePose[8] = {90, 90, 90, 90, 90, 90, 90, 90};
+const int nudgedPose[8] = {91, 91, 91, 91, 91, 91, 91, 91};
+
+// One app command frame (CMD_STANDBY)
+const uint8_t commandFrame[13] = {0xFF, 0x55, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x01, 0x00, 0x00};
+
+const char* benchmarkNames[BENCHMARK_COUNT] = {
+  "empty call (subtracted)",
+  "servo.write",
+  "servo.writeMicroseconds",
+  "writePose (8 changed)",
+  "writePose (unchanged)",
+  "feedByte (per byte)",
+  "robot.update (idle)",
+  "loop pass (no client)",
+  "loop pass (client)",
+  "handleClient (client)"
+};
+
+BenchmarkResult results[2][BENCHMARK_COUNT];    // [80MHz, 160MHz][benchmark]
+uint32_t counter = 0;                           // Changes on every call (alternating values)
+volatile uint32_t sink = 0;                     // Keeps the compiler from removing work
+
+
+// TASKS (same as the app)
+void updateMotion() {
+  robot.update();
+}
+
+void handleCommands() {
+  WiFiDriver::CommandData cmd = wifi.handleClient();
+  if (cmd.isValid) sink += cmd.action;
+}
+
+
+// BENCHMARK BODIES
+void benchEmpty() {
+  counter++;
+}
+
+void benchServoWrite() {
+  testServo.write(90 + (++counter & 1));
+}
+
+void benchServoWriteMicroseconds() {
+  testServo.writeMicroseconds(1500 + 10 * (++counter & 1));
+}
+
+void benchWritePoseChanged() {
+  robot.writePose((++counter & 1) ? nudgedPose : centrePose);
+}
+
+void benchWritePoseUnchanged() {
+  robot.writePose(centrePose);
+}
+
+void benchFeedFrame() {
+  WiFiDriver::CommandData cmd;
+  for (size_t i = 0; i < sizeof(commandFrame); i++) {
+    if (wifi.feedByte(commandFrame[i], cmd)) sink += cmd.action;
+  }
+}
+
+void benchUpdate() {
+  robot.update();
+}
+
+void benchLoopPass() {
+  scheduler.run();
+}
+
+void benchHandleClient() {
+  handleCommands();
+}
+
+
+// HELPER METHODS
+// Time ITERATIONS calls of a benchmark body
+BenchmarkResult measure(void (*body)(), uint32_t overhead, uint32_t divider = 1) {
+  uint32_t minCycles = 0xFFFFFFFF;
+  uint64_t totalCycles = 0;
+
+  for (int i = 0; i < ITERATIONS; i++) {
+    uint32_t start = ESP.getCycleCount();
+    body();
+    uint32_t cycles = ESP.getCycleCount() - start;
+
+    if (cycles < minCycles) minCycles = cycles;
+    totalCycles += cycles;
+    if ((i & 63) == 0) yield();   // Let Wi-Fi run between batches (not inside a measurement)
+  }
+
+  BenchmarkResult result;
+  uint32_t avgCycles = totalCycles / ITERATIONS;
+  result.minCycles = (minCycles > overhead ? minCycles - overhead : 0) / divider;
+  result.avgCycles = (avgCycles > overhead ? avgCycles - overhead : 0) / divider;
+  result.skipped = false;
+  return result;
+}
+
+// Wait for the app to connect (returns false after CLIENT_WAIT_MS)
+bool waitForClient() {
+  Serial.print("Connect a client to ");
+  Serial.print(ssid);
+  Serial.println(" port 100 for the client benchmarks (e.g. the ACEBOTT app)...");
+
+  unsigned long start = millis();
+  while (millis() - start < CLIENT_WAIT_MS) {
+    wifi.handleClient();
+    if (wifi.isClientConnected()) return true;
+    delay(10);
+  }
+  Serial.println("No client - skipping the client benchmarks");
+  return false;
+}
+
+// Run every benchmark at one CPU frequency
+void runBenchmarks(BenchmarkResult (&set)[BENCHMARK_COUNT], uint8_t mhz) {
+  system_update_cpu_freq(mhz);
+  Serial.print("\nRunning at ");
+  Serial.print(ESP.getCpuFreqMHz());
+  Serial.println("MHz...");
+
+  BenchmarkResult empty = measure(benchEmpty, 0);
+  uint32_t overhead = empty.minCycles;
+  set[0] = empty;
+
+  set[1] = measure(benchServoWrite, overhead);
+  set[2] = measure(benchServoWriteMicroseconds, overhead);
+  set[3] = measure(benchWritePoseChanged, overhead);
+  set[4] = measure(benchWritePoseUnchanged, overhead);
+  set[5] = measure(benchFeedFrame, overhead, sizeof(commandFrame));
+  set[6] = measure(benchUpdate, overhead);
+
+  // The app's loop() without a client ...
+  set[7] = measure(benchLoopPass, overhead);
+
+  // ... and with one
+  if (waitForClient()) {
+    set[8] = measure(benchLoopPass, overhead);
+    set[9] = measure(benchHandleClient, overhead);
+  }
+  else {
+    set[8].skipped = true;
+    set[9].skipped = true;
+  }
+}
+
+// Print the 80MHz & 160MHz results side by side
+void printSummary() {
+  char line[100];
+  Serial.println("\n=======================================================================");
+  Serial.println("BENCHMARK                  80MHz MIN   AVG   (us)   160MHz MIN   AVG   (us)");
+  Serial.println("=======================================================================");
+
+  for (int i = 0; i < BENCHMARK_COUNT; i++) {
+    int length = snprintf(line, sizeof(line), "%-25s", benchmarkNames[i]);
+    for (int set = 0; set < 2; set++) {
+      const BenchmarkResult &result = results[set][i];
+      float mhz = set == 0 ? 80.0f : 160.0f;
+      if (result.skipped) {
+        length += snprintf(line + length, sizeof(line) - length, "  %8s %5s %6s ", "skipped", "", "");
+      }
+      else {
+        length += snprintf(line + length, sizeof(line) - length, "  %8lu %5lu %6.2f ",
+                           (unsigned long)result.minCycles, (unsigned long)result.avgCycles, result.minCycles / mhz);
+      }
+    }
+    Serial.println(line);
+  }
+  Serial.println("MIN & AVG in CPU cycles, (us) = fastest call in microseconds");
+}
+
+
+// SETUP
+void setup() {
+  Serial.begin(115200);
+  delay(100);
+
+  Serial.println("\n=================================================================");
+  Serial.println("ACEBOTT QD020 cycle count benchmarks");
+  Serial.println("=================================================================");
+
+  // Servos to the centre point, the motion engine stays idle (no sequence running)
+  robot.begin();
+  robot.writePose(centrePose);
+  testServo.attach(D3, 500, 2500);
+
+  // Wi-Fi AP & server like the app
+  wifi.begin(ssid, password);
+
+  // Same tasks as the app's loop()
+  scheduler.addPeriodic("motion", updateMotion, 0, TaskScheduler::PRIORITY_MOTION);
+  scheduler.addPeriodic("commands", handleCommands, 0, TaskScheduler::PRIORITY_HIGH);
+
+  runBenchmarks(results[0], SYS_CPU_80MHZ);
+  runBenchmarks(results[1], SYS_CPU_160MHZ);
+  system_update_cpu_freq(SYS_CPU_80MHZ);
+  printSummary();
+}
+
+// MAIN LOOP
+void loop() {
+  // Send any character to run the benchmarks again
+  if (Serial.available()) {
+    while (Serial.available()) Serial.read();
+    runBenchmarks(results[0], SYS_CPU_80MHZ);
+    runBenchmarks(results[1], SYS_CPU_160MHZ);
+    system_update_cpu_freq(SYS_CPU_80MHZ);
+    printSummary();
+  }
+}
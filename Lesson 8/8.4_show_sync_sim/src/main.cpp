@@ -0,0 +1,187 @@
+/*
+ * Show sync simulation - several robots on one PC sharing a show clock over UDP on localhost.
+ *
+ * HOW IT WORKS:
+ * - One process is one robot: the real Movement_Driver & Show_Sync sources of
+ *   8.1_app_control_custom, built for the PC against the Arduino_Mock library of
+ *   8.2_host_benchmark (its UDP is a real socket, every robot process gets the broadcasts)
+ * - The robot's millis() follows the PC's monotonic clock, moved by a boot offset & scaled by a
+ *   crystal error (--offset-ms, --drift-ppm), so every robot has a clock of its own like on
+ *   the real hardware
+ * - loop() sleeps 1 ms per pass & now and then stalls for up to --stall-ms, like Wi-Fi & flash
+ *   work on the robot, so beacons are picked up late the same way
+ * - The master (--master) plays the sequences of --play one after another on every robot, each
+ *   one once the previous has finished. Followers only listen to the beacons (or to
+ *   tools/show_master.py of 8.1_app_control_custom, the host acting as master)
+ * - Every step start is printed to stdout as a JSON line with the PC time it was scheduled for
+ *   (its deadline on the show clock, through this robot's clock) & the PC time loop() got to it,
+ *   and a summary of the show clock at the end. tools/run_show_sim.py starts a whole show &
+ *   compares the robots
+ *
+ * NOTES:
+ * - Usage: program --id N [--master] [--play dance1,dance2] [--offset-ms N] [--drift-ppm N]
+ *          [--stall-ms N] [--run-ms N] [--port N] [--seed N]
+ * - Linux only (the UDP replacement uses the loopback broadcast address)
+ */
+
+
+// INCLUDES
+#include <Arduino.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "Movement_Driver.h"
+#include "Show_Sync.h"
+
+// DEFINES
+#define FIRST_START_MS  1500    // Master: time for the followers to lock before the first start
+#define START_GAP_MS    500     // Master: pause between the end of a sequence & the next start
+
+// GLOBAL VARIABLES
+uint32_t robotId = 1;
+bool isMaster = false;
+std::vector<uint8_t> playlist;
+unsigned long offsetMs = 1000;  // Robot uptime when the simulation starts
+double driftPpm = 0;            // Crystal error (+ = the robot clock runs fast)
+unsigned long stallMs = 0;      // Longest loop() stall
+unsigned long runMs = 20000;    // Simulated time (PC clock)
+uint16_t port = SHOW_DEFAULT_PORT;
+
+uint64_t epochUs;               // PC time when the simulation started
+
+MovementDriver robot;
+ShowSync show;
+
+
+// HELPER METHODS
+uint64_t pcMicros() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+// Move the robot's clock to the PC time (boot offset & crystal error applied)
+void syncRobotClock() {
+  double elapsedUs = (double)(pcMicros() - epochUs);
+  mockSetMicros(offsetMs * 1000UL + (unsigned long)(elapsedUs * (1.0 + driftPpm / 1e6)));
+}
+
+// PC time of a robot millis() value (the inverse of syncRobotClock())
+uint64_t robotToPcMicros(unsigned long robotMs) {
+  double elapsedUs = ((double)robotMs - offsetMs) * 1000.0 / (1.0 + driftPpm / 1e6);
+  return epochUs + (int64_t)elapsedUs;
+}
+
+// Motion clock of the robot
+unsigned long showClock() {
+  return show.now();
+}
+
+bool parsePlaylist(const char *list) {
+  std::string names(list);
+  size_t begin = 0;
+  while (begin <= names.size()) {
+    size_t end = names.find(',', begin);
+    if (end == std::string::npos) end = names.size();
+    int id = robot.findSequence(names.substr(begin, end - begin).c_str());
+    if (id < 0) return false;
+    playlist.push_back((uint8_t)id);
+    begin = end + 1;
+  }
+  return true;
+}
+
+bool parseArguments(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--master") == 0) isMaster = true;
+    else if (strcmp(argv[i], "--id") == 0 && hasValue) robotId = strtoul(argv[++i], nullptr, 0);
+    else if (strcmp(argv[i], "--play") == 0 && hasValue) { if (!parsePlaylist(argv[++i])) return false; }
+    else if (strcmp(argv[i], "--offset-ms") == 0 && hasValue) offsetMs = strtoul(argv[++i], nullptr, 0);
+    else if (strcmp(argv[i], "--drift-ppm") == 0 && hasValue) driftPpm = atof(argv[++i]);
+    else if (strcmp(argv[i], "--stall-ms") == 0 && hasValue) stallMs = strtoul(argv[++i], nullptr, 0);
+    else if (strcmp(argv[i], "--run-ms") == 0 && hasValue) runMs = strtoul(argv[++i], nullptr, 0);
+    else if (strcmp(argv[i], "--port") == 0 && hasValue) port = strtoul(argv[++i], nullptr, 0);
+    else if (strcmp(argv[i], "--seed") == 0 && hasValue) srand(strtoul(argv[++i], nullptr, 0));
+    else return false;
+  }
+  return true;
+}
+
+// Master: start the next sequence of the playlist once the last one has finished
+void runPlaylist(size_t &next, unsigned long &nextStartMs) {
+  if (next >= playlist.size() || robot.isBusy() || robot.getState() == IDLE) return;
+  if ((long)(millis() - nextStartMs) < 0) return;
+
+  if (show.start(playlist[next])) {
+    next++;
+  }
+  nextStartMs = millis() + SHOW_DEFAULT_LEAD_MS + START_GAP_MS;
+}
+
+// Print a JSON line for every step that starts (the first frame that shows it)
+void reportSteps(unsigned long &lastStarts, MovementState &lastState, int &lastStep) {
+  MovementState state = robot.getState();
+  int step = robot.getCurrentStep();
+  if (state == IDLE || !robot.isBusy()) {
+    lastState = IDLE;
+    return;
+  }
+  if (state == lastState && step == lastStep && show.getStarts() == lastStarts) return;
+
+  unsigned long deadlineMs = robot.getStepStartTime() - show.getOffset();   // Show clock -> millis()
+  printf("{\"type\": \"step\", \"robot\": %u, \"start\": %lu, \"sequence\": \"%s\", \"step\": %d, "
+         "\"deadline_us\": %llu, \"pc_us\": %llu}\n", (unsigned int)robotId, show.getStarts(),
+         robot.getSequenceName(robot.getSequenceId()), step, (unsigned long long)robotToPcMicros(deadlineMs),
+         (unsigned long long)pcMicros());
+  fflush(stdout);
+  lastStarts = show.getStarts();
+  lastState = state;
+  lastStep = step;
+}
+
+
+// MAIN
+int main(int argc, char **argv) {
+  if (!parseArguments(argc, argv)) {
+    fprintf(stderr, "Usage: %s --id N [--master] [--play dance1,dance2] [--offset-ms N] [--drift-ppm N] "
+                    "[--stall-ms N] [--run-ms N] [--port N] [--seed N]\n", argv[0]);
+    return 2;
+  }
+
+  // Boot like the app: ready pose, then the show clock as motion clock
+  epochUs = pcMicros();
+  syncRobotClock();
+  robot.begin();
+  robot.setClock(showClock);
+  robot.ready();
+  show.begin(robot, robotId, port);
+  if (isMaster) show.lead();
+
+  size_t next = 0;
+  unsigned long nextStartMs = millis() + FIRST_START_MS;
+  unsigned long lastStarts = 0;
+  MovementState lastState = IDLE;
+  int lastStep = -1;
+
+  while (pcMicros() - epochUs < runMs * 1000ULL) {
+    syncRobotClock();
+    show.update();
+    robot.update();
+    if (isMaster) runPlaylist(next, nextStartMs);
+    reportSteps(lastStarts, lastState, lastStep);
+
+    usleep(1000);
+    if (stallMs > 0 && rand() % 100 == 0) {
+      usleep((rand() % stallMs) * 1000);
+    }
+  }
+
+  printf("{\"type\": \"summary\", \"robot\": %u, \"role\": \"%s\", \"locked\": %d, \"offset_ms\": %ld, "
+         "\"error_ms\": %ld, \"spread_ms\": %lu, \"beacons\": %lu, \"jumps\": %lu, \"starts\": %lu, "
+         "\"missed_starts\": %lu}\n", (unsigned int)robotId, ShowSync::getRoleName(show.getRole()),
+         show.isLocked() ? 1 : 0, show.getOffset(), show.getError(), show.getSpread(), show.getBeacons(),
+         show.getJumps(), show.getStarts(), show.getMissedStarts());
+  return 0;
+}
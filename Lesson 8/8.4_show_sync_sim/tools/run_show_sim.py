@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""
+run_show_sim.py - Run a simulated show on localhost & check the robots step together
+
+Starts one follower process per robot (random boot offset & crystal error) and a master
+(a robot process, or tools/show_master.py of 8.1_app_control_custom with --host-master),
+collects the step starts every robot prints & compares them per step.
+
+USAGE:
+  pio run -e native
+  python3 tools/run_show_sim.py
+  python3 tools/run_show_sim.py --robots 6 --drift-ppm 2000 --stall-ms 30
+  python3 tools/run_show_sim.py --host-master --play dance1,dance3
+
+OUTPUT:
+  The spread (latest - earliest robot) of every step start, per sequence, and the show clock
+  of every robot at the end. The exit code is 1 if the median spread is above --max-spread-ms,
+  so the script can run as a test.
+
+NOTES:
+- DEADLINE is when the step was due (its show time through the robot's own clock) - what the
+  show sync keeps together & what the check uses. SEEN is when the robot's loop() noticed it,
+  a simulated stall delays that on one robot only, so single steps can spread by --stall-ms
+- Linux only (the simulated robots broadcast on the loopback interface)
+"""
+
+import argparse
+import json
+import os
+import random
+import statistics
+import subprocess
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+PROGRAM = os.path.join(HERE, "..", ".pio", "build", "native", "program")
+SHOW_MASTER = os.path.join(HERE, "..", "..", "8.1_app_control_custom", "tools", "show_master.py")
+
+
+def spread_ms(times_us):
+    return (max(times_us) - min(times_us)) / 1000
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Run a simulated show & compare the step starts")
+    parser.add_argument("--program", default=PROGRAM, help="simulation binary (pio run -e native)")
+    parser.add_argument("--robots", type=int, default=4, help="robots, including a robot master")
+    parser.add_argument("--play", default="dance1,dance2,dance3", help="sequences to play")
+    parser.add_argument("--drift-ppm", type=float, default=500, help="largest crystal error of a robot")
+    parser.add_argument("--stall-ms", type=int, default=20, help="longest simulated loop() stall")
+    parser.add_argument("--port", type=int, default=4210, help="UDP port of the show")
+    parser.add_argument("--host-master", action="store_true", help="tools/show_master.py is the master")
+    parser.add_argument("--max-spread-ms", type=float, default=5.0, help="fail above this median spread")
+    parser.add_argument("--sequence-ms", type=int, default=5000,
+                        help="time per sequence (run time, the host master's gap between starts)")
+    parser.add_argument("--seed", type=int, default=1, help="random seed (offsets, drift, stalls)")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.program):
+        sys.exit("%s not found - build it with: pio run -e native" % args.program)
+
+    rng = random.Random(args.seed)
+    playlist = args.play.split(",")
+    run_ms = 3000 + args.sequence_ms * len(playlist)
+    followers = args.robots if args.host_master else args.robots - 1
+
+    processes = []
+    drifts = {1: 0.0}       # The master's clock is the reference
+    for robot in range(2, followers + 2):
+        drifts[robot] = rng.uniform(-args.drift_ppm, args.drift_ppm)
+        processes.append(subprocess.Popen(
+            [args.program, "--id", str(robot), "--offset-ms", str(rng.randint(1000, 600000)),
+             "--drift-ppm", "%.1f" % drifts[robot], "--stall-ms", str(args.stall_ms),
+             "--run-ms", str(run_ms + 500), "--port", str(args.port), "--seed", str(rng.getrandbits(31))],
+            stdout=subprocess.PIPE, text=True))
+    time.sleep(0.2)
+
+    if args.host_master:
+        master = subprocess.Popen(
+            [sys.executable, SHOW_MASTER] + playlist + ["--gap", str(args.sequence_ms / 1000), "--port", str(args.port),
+                                                        "--address", "127.255.255.255", "--id", "1"],
+            stdout=subprocess.DEVNULL)
+    else:
+        master = subprocess.Popen(
+            [args.program, "--id", "1", "--master", "--play", args.play, "--stall-ms", str(args.stall_ms),
+             "--run-ms", str(run_ms), "--port", str(args.port), "--seed", str(rng.getrandbits(31))],
+            stdout=subprocess.PIPE, text=True)
+        processes.append(master)
+
+    # Step starts per (start order, step) & the summaries
+    steps = {}
+    summaries = []
+    for process in processes:
+        output, _ = process.communicate()
+        for line in output.splitlines():
+            record = json.loads(line)
+            if record["type"] == "summary":
+                summaries.append(record)
+            elif record["start"] > 0:
+                key = (record["start"], record["sequence"], record["step"])
+                steps.setdefault(key, {})[record["robot"]] = (record["deadline_us"], record["pc_us"])
+    master.wait()
+
+    robots = len(processes)
+    print("                              DEADLINE SPREAD (MS)   SEEN SPREAD (MS)")
+    print("SEQUENCE    STEPS  ROBOTS       MEDIAN       MAX      MEDIAN     MAX")
+    spreads = []
+    for start in sorted({key[0] for key in steps}):
+        keys = sorted(key for key in steps if key[0] == start)
+        complete = [steps[key] for key in keys if len(steps[key]) == robots]
+        if not complete:
+            continue
+        deadline = [spread_ms([times[0] for times in step.values()]) for step in complete]
+        seen = [spread_ms([times[1] for times in step.values()]) for step in complete]
+        spreads += deadline
+        print("%-10s %6d %7d %12.1f %9.1f %11.1f %7.1f" % (
+            keys[0][1], len(complete), robots, statistics.median(deadline), max(deadline),
+            statistics.median(seen), max(seen)))
+
+    print()
+    print("ROBOT  ROLE      DRIFT_PPM  OFFSET_MS  ERROR_MS  BEACONS  JUMPS  STARTS  MISSED")
+    for summary in sorted(summaries, key=lambda s: s["robot"]):
+        print("%5d  %-8s %10.1f %10d %9d %8d %6d %7d %7d" % (
+            summary["robot"], summary["role"], drifts.get(summary["robot"], 0.0), summary["offset_ms"],
+            summary["error_ms"], summary["beacons"], summary["jumps"], summary["starts"], summary["missed_starts"]))
+
+    # For comparison: how far the free-running clocks would have drifted apart
+    drift_spread = (max(drifts.values()) - min(drifts.values())) * run_ms / 1e6
+    print()
+    print("Unsynchronised clocks would drift %.1f ms apart over %.0f s (boot offsets not counted)" %
+          (drift_spread, run_ms / 1000))
+
+    if not spreads:
+        sys.exit("No step was seen by every robot")
+    median = statistics.median(spreads)
+    print("Median deadline spread %.1f ms (limit %.1f ms)" % (median, args.max_spread_ms))
+    sys.exit(0 if median <= args.max_spread_ms else 1)
+
+
+if __name__ == "__main__":
+    main()